@@ -0,0 +1,99 @@
+#ifndef MATERIAL_HEAP_GLSL
+#define MATERIAL_HEAP_GLSL
+
+// ------------------------------------------------------------------
+// Shader-side declaration of the Vulkan material heap
+// (Material::heap_descriptor_set()). Define MATERIAL_HEAP_SET to the
+// set index the heap is bound to and pass Material::heap_index()
+// to the shader, e.g. through a push constant or instance data.
+// ------------------------------------------------------------------
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+#ifndef MATERIAL_HEAP_SET
+#define MATERIAL_HEAP_SET 1
+#endif
+
+struct MaterialData
+{
+    ivec4 texture_indices0; // x: albedo, y: normals, z: roughness, w: metallic
+    ivec4 texture_indices1; // x: emissive, z: roughness_channel, w: metallic_channel
+    vec4  albedo;
+    vec4  emissive;
+    vec4  roughness_metallic;
+};
+
+layout(set = MATERIAL_HEAP_SET, binding = 0, std430) readonly buffer MaterialHeap
+{
+    MaterialData materials[];
+};
+
+layout(set = MATERIAL_HEAP_SET, binding = 1) uniform sampler2D s_MaterialTextures[];
+
+// ------------------------------------------------------------------
+
+vec4 material_sample(int idx, vec2 uv)
+{
+    return texture(s_MaterialTextures[nonuniformEXT(idx)], uv);
+}
+
+// ------------------------------------------------------------------
+
+vec4 material_albedo(MaterialData material, vec2 uv)
+{
+    if (material.texture_indices0.x == -1)
+        return material.albedo;
+    else
+        return material_sample(material.texture_indices0.x, uv);
+}
+
+// ------------------------------------------------------------------
+
+float material_roughness(MaterialData material, vec2 uv)
+{
+    if (material.texture_indices0.z == -1)
+        return material.roughness_metallic.x;
+    else
+        return material_sample(material.texture_indices0.z, uv)[material.texture_indices1.z];
+}
+
+// ------------------------------------------------------------------
+
+float material_metallic(MaterialData material, vec2 uv)
+{
+    if (material.texture_indices0.w == -1)
+        return material.roughness_metallic.y;
+    else
+        return material_sample(material.texture_indices0.w, uv)[material.texture_indices1.w];
+}
+
+// ------------------------------------------------------------------
+
+vec3 material_emissive(MaterialData material, vec2 uv)
+{
+    if (material.texture_indices1.x == -1)
+        return material.emissive.rgb;
+    else
+        return material_sample(material.texture_indices1.x, uv).rgb;
+}
+
+// ------------------------------------------------------------------
+
+// Returns the tangent-space normal, or false if the material has no normal map.
+bool material_normal(MaterialData material, vec2 uv, out vec3 normal)
+{
+    if (material.texture_indices0.y == -1)
+    {
+        normal = vec3(0.0, 0.0, 1.0);
+        return false;
+    }
+    else
+    {
+        normal = material_sample(material.texture_indices0.y, uv).xyz * 2.0 - 1.0;
+        return true;
+    }
+}
+
+// ------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef MATERIAL_TABLE_GLSL
+#define MATERIAL_TABLE_GLSL
+
+// ------------------------------------------------------------------
+// Shader-side declaration of dw::MaterialTable. Define
+// MATERIAL_TABLE_BINDLESS when MaterialTable::bindless() is true and
+// MATERIAL_TABLE_BINDING to the SSBO binding passed to bind().
+//
+// The material index of a vertex is base_index(mesh) + position.w.
+// For multi-draw, pass the base index through the draw's baseInstance.
+// The material_*() functions sample with derivatives, so they are
+// for fragment shaders only.
+// ------------------------------------------------------------------
+
+#ifdef MATERIAL_TABLE_BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+
+#ifndef MATERIAL_TABLE_BINDING
+#define MATERIAL_TABLE_BINDING 0
+#endif
+
+#define MATERIAL_TABLE_MAX_TEXTURE_ARRAYS 16
+
+struct MaterialData
+{
+    uvec4 texture0; // xy: albedo, zw: normal
+    uvec4 texture1; // xy: roughness, zw: metallic
+    uvec4 texture2; // xy: emissive, z: roughness_channel, w: metallic_channel
+    vec4  albedo;
+    vec4  emissive;
+    vec4  roughness_metallic;
+};
+
+layout(std430, binding = MATERIAL_TABLE_BINDING) readonly buffer MaterialTable
+{
+    MaterialData materials[];
+};
+
+// ------------------------------------------------------------------
+
+#ifdef MATERIAL_TABLE_BINDLESS
+
+bool material_has_texture(uvec2 ref)
+{
+    return ref != uvec2(0);
+}
+
+vec4 material_sample(uvec2 ref, vec2 uv)
+{
+    return texture(sampler2D(ref), uv);
+}
+
+#else
+
+uniform sampler2DArray s_MaterialTextureArrays[MATERIAL_TABLE_MAX_TEXTURE_ARRAYS];
+
+bool material_has_texture(uvec2 ref)
+{
+    return ref.x != 0;
+}
+
+// Sampler arrays may only be indexed with dynamically uniform values, while
+// the array of a texture can change from one vertex to the next. Every case
+// indexes with a constant instead, and the gradients are taken up front as
+// neighbouring pixels may take different cases.
+#define MATERIAL_TABLE_SAMPLE_CASE(i) \
+    case i: return textureGrad(s_MaterialTextureArrays[i], coord, dx, dy)
+
+vec4 material_sample(uvec2 ref, vec2 uv)
+{
+    vec3 coord = vec3(uv, float(ref.y));
+    vec2 dx    = dFdx(uv);
+    vec2 dy    = dFdy(uv);
+
+    switch (int(ref.x) - 1)
+    {
+        MATERIAL_TABLE_SAMPLE_CASE(0);
+        MATERIAL_TABLE_SAMPLE_CASE(1);
+        MATERIAL_TABLE_SAMPLE_CASE(2);
+        MATERIAL_TABLE_SAMPLE_CASE(3);
+        MATERIAL_TABLE_SAMPLE_CASE(4);
+        MATERIAL_TABLE_SAMPLE_CASE(5);
+        MATERIAL_TABLE_SAMPLE_CASE(6);
+        MATERIAL_TABLE_SAMPLE_CASE(7);
+        MATERIAL_TABLE_SAMPLE_CASE(8);
+        MATERIAL_TABLE_SAMPLE_CASE(9);
+        MATERIAL_TABLE_SAMPLE_CASE(10);
+        MATERIAL_TABLE_SAMPLE_CASE(11);
+        MATERIAL_TABLE_SAMPLE_CASE(12);
+        MATERIAL_TABLE_SAMPLE_CASE(13);
+        MATERIAL_TABLE_SAMPLE_CASE(14);
+        MATERIAL_TABLE_SAMPLE_CASE(15);
+        default: return vec4(0.0);
+    }
+}
+
+#undef MATERIAL_TABLE_SAMPLE_CASE
+
+#endif
+
+// ------------------------------------------------------------------
+
+vec4 material_albedo(MaterialData material, vec2 uv)
+{
+    if (material_has_texture(material.texture0.xy))
+        return material_sample(material.texture0.xy, uv);
+    else
+        return material.albedo;
+}
+
+// ------------------------------------------------------------------
+
+float material_roughness(MaterialData material, vec2 uv)
+{
+    if (material_has_texture(material.texture1.xy))
+        return material_sample(material.texture1.xy, uv)[material.texture2.z];
+    else
+        return material.roughness_metallic.x;
+}
+
+// ------------------------------------------------------------------
+
+float material_metallic(MaterialData material, vec2 uv)
+{
+    if (material_has_texture(material.texture1.zw))
+        return material_sample(material.texture1.zw, uv)[material.texture2.w];
+    else
+        return material.roughness_metallic.y;
+}
+
+// ------------------------------------------------------------------
+
+vec3 material_emissive(MaterialData material, vec2 uv)
+{
+    if (material_has_texture(material.texture2.xy))
+        return material_sample(material.texture2.xy, uv).rgb;
+    else
+        return material.emissive.rgb;
+}
+
+// ------------------------------------------------------------------
+
+// Returns the tangent-space normal, or false if the material has no normal map.
+bool material_normal(MaterialData material, vec2 uv, out vec3 normal)
+{
+    if (material_has_texture(material.texture0.zw))
+    {
+        normal = material_sample(material.texture0.zw, uv).xyz * 2.0 - 1.0;
+        return true;
+    }
+    else
+    {
+        normal = vec3(0.0, 0.0, 1.0);
+        return false;
+    }
+}
+
+// ------------------------------------------------------------------
+
+#endif
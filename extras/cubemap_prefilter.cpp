@@ -2778,6 +2778,7 @@ void CubemapPrefiler::update(
         vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout->handle(), 0, 1, &m_ds[mip]->handle(), 0, nullptr);
 
         vkCmdDispatch(cmd_buf->handle(), mip_width / PREFILTER_WORK_GROUP_SIZE, mip_height / PREFILTER_WORK_GROUP_SIZE, 6);
+        profiler::increment(profiler::COUNTER_DISPATCHES);
     }
 
     dw::vk::utilities::set_image_layout(
@@ -2811,6 +2812,7 @@ void CubemapPrefiler::update(
         m_texture->bind_image(0, mip, 0, GL_WRITE_ONLY, GL_RGBA16F);
 
         glDispatchCompute(mip_width / PREFILTER_WORK_GROUP_SIZE, mip_height / PREFILTER_WORK_GROUP_SIZE, 6);
+        profiler::increment(profiler::COUNTER_DISPATCHES);
     }
 
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
@@ -4866,6 +4866,7 @@ void CubemapSHProjection::update(
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_projection_pipeline_layout->handle(), 0, 1, &m_projection_ds->handle(), 0, nullptr);
 
     vkCmdDispatch(cmd_buf->handle(), IRRADIANCE_CUBEMAP_SIZE / IRRADIANCE_WORK_GROUP_SIZE, IRRADIANCE_CUBEMAP_SIZE / IRRADIANCE_WORK_GROUP_SIZE, 6);
+    profiler::increment(profiler::COUNTER_DISPATCHES);
 
     dw::vk::utilities::set_image_layout(
         cmd_buf->handle(),
@@ -4887,6 +4888,7 @@ void CubemapSHProjection::update(
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_add_pipeline_layout->handle(), 0, 1, &m_add_ds->handle(), 0, nullptr);
 
     vkCmdDispatch(cmd_buf->handle(), 9, 1, 1);
+    profiler::increment(profiler::COUNTER_DISPATCHES);
 
     dw::vk::utilities::set_image_layout(
         cmd_buf->handle(),
@@ -4906,6 +4908,7 @@ void CubemapSHProjection::update(
     m_texture_intermediate->bind_image(0, 0, 0, GL_WRITE_ONLY, GL_RGBA32F);
 
     glDispatchCompute(IRRADIANCE_CUBEMAP_SIZE / IRRADIANCE_WORK_GROUP_SIZE, IRRADIANCE_CUBEMAP_SIZE / IRRADIANCE_WORK_GROUP_SIZE, 6);
+    profiler::increment(profiler::COUNTER_DISPATCHES);
 
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
@@ -4917,6 +4920,7 @@ void CubemapSHProjection::update(
         m_texture_intermediate->bind(1);
 
     glDispatchCompute(9, 1, 1);
+    profiler::increment(profiler::COUNTER_DISPATCHES);
 
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 #endif
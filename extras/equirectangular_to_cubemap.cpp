@@ -1305,7 +1305,7 @@ void EquirectangularToCubemap::convert(
         info.clearValueCount          = 1;
         info.pClearValues             = &clear_value;
 
-        vkCmdBeginRenderPass(cmd_buf->handle(), &info, VK_SUBPASS_CONTENTS_INLINE);
+        profiler::begin_render_pass(cmd_buf, info, VK_SUBPASS_CONTENTS_INLINE);
 
         VkViewport vp;
 
@@ -1334,8 +1334,10 @@ void EquirectangularToCubemap::convert(
         vkCmdBindVertexBuffers(cmd_buf->handle(), 0, 1, &buffer, &size);
 
         vkCmdDraw(cmd_buf->handle(), 36, 1, 0, 0);
+        profiler::increment(profiler::COUNTER_DRAW_CALLS);
+        profiler::increment(profiler::COUNTER_INDICES, 36);
 
-        vkCmdEndRenderPass(cmd_buf->handle());
+        profiler::end_render_pass(cmd_buf);
     }
 
     vkEndCommandBuffer(cmd_buf->handle());
@@ -2598,7 +2598,7 @@ void HosekWilkieSkyModel::update(
         info.clearValueCount          = 1;
         info.pClearValues             = &clear_value;
 
-        vkCmdBeginRenderPass(cmd_buf->handle(), &info, VK_SUBPASS_CONTENTS_INLINE);
+        profiler::begin_render_pass(cmd_buf, info, VK_SUBPASS_CONTENTS_INLINE);
 
         VkViewport vp;
 
@@ -2632,8 +2632,10 @@ void HosekWilkieSkyModel::update(
         vkCmdBindVertexBuffers(cmd_buf->handle(), 0, 1, &buffer, &size);
 
         vkCmdDraw(cmd_buf->handle(), 36, 1, 0, 0);
+        profiler::increment(profiler::COUNTER_DRAW_CALLS);
+        profiler::increment(profiler::COUNTER_INDICES, 36);
 
-        vkCmdEndRenderPass(cmd_buf->handle());
+        profiler::end_render_pass(cmd_buf);
     }
 #else
     m_update_program->use();
@@ -2667,6 +2669,8 @@ void HosekWilkieSkyModel::update(
         m_vao->bind();
 
         glDrawArrays(GL_TRIANGLES, 0, 36);
+        profiler::increment(profiler::COUNTER_DRAW_CALLS);
+        profiler::increment(profiler::COUNTER_INDICES, 36);
     }
 #endif
 }
@@ -2704,6 +2708,8 @@ void HosekWilkieSkyModel::render(
         m_cubemap->bind(0);
 
     glDrawArrays(GL_TRIANGLES, 0, 36);
+    profiler::increment(profiler::COUNTER_DRAW_CALLS);
+    profiler::increment(profiler::COUNTER_INDICES, 36);
 
     glDepthFunc(GL_LESS);
 #endif
@@ -0,0 +1,371 @@
+#include "material_table.h"
+#include <logger.h>
+#include <macros.h>
+#include <material.h>
+#include <algorithm>
+
+#define MAX_TEXTURE_ARRAYS 16
+
+#if !defined(DWSF_VULKAN)
+namespace dw
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Must match MaterialData in assets/shaders/material_table.glsl (std430).
+struct MaterialTable::MaterialData
+{
+    glm::uvec4 texture0; // xy: albedo, zw: normal
+    glm::uvec4 texture1; // xy: roughness, zw: metallic
+    glm::uvec4 texture2; // xy: emissive, z: roughness_channel, w: metallic_channel
+    glm::vec4  albedo;
+    glm::vec4  emissive;
+    glm::vec4  roughness_metallic;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct TextureArrayKey
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    GLenum   internal_format;
+
+    bool operator==(const TextureArrayKey& other) const
+    {
+        return width == other.width && height == other.height && mip_levels == other.mip_levels && internal_format == other.internal_format;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static glm::uvec2 resident_handle(gl::Texture2D::Ptr texture)
+{
+    GLuint64 handle = texture->texture_handle();
+
+    // Textures shared with another table are already resident.
+    if (handle == 0)
+        handle = texture->make_texture_handle_resident();
+
+    return glm::uvec2(uint32_t(handle & 0xFFFFFFFF), uint32_t(handle >> 32));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MaterialTable::Ptr MaterialTable::create(std::vector<std::weak_ptr<Mesh>> meshes, bool allow_bindless)
+{
+    return std::shared_ptr<MaterialTable>(new MaterialTable(meshes, allow_bindless));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MaterialTable::MaterialTable(std::vector<std::weak_ptr<Mesh>> meshes, bool allow_bindless) :
+    m_meshes(meshes)
+{
+#    if !defined(__EMSCRIPTEN__)
+    m_bindless = allow_bindless && GLAD_GL_ARB_bindless_texture;
+#    endif
+
+    if (!m_bindless)
+        DW_LOG_INFO("MaterialTable: ARB_bindless_texture unavailable, falling back to texture arrays.");
+
+    create_gpu_resources();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MaterialTable::~MaterialTable()
+{
+    m_material_data_buffer.reset();
+    m_texture_arrays.clear();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MaterialTable::bind(gl::Program::Ptr program, uint32_t ssbo_binding, uint32_t first_texture_unit)
+{
+    update();
+
+    if (m_material_data_buffer)
+        m_material_data_buffer->bind_base(GL_SHADER_STORAGE_BUFFER, ssbo_binding);
+
+    if (!m_bindless && m_texture_arrays.size() > 0)
+    {
+        int32_t units[MAX_TEXTURE_ARRAYS];
+
+        for (uint32_t i = 0; i < m_texture_arrays.size(); i++)
+        {
+            units[i] = first_texture_unit + i;
+            m_texture_arrays[i]->bind(units[i]);
+        }
+
+        program->set_uniform("s_MaterialTextureArrays", m_texture_arrays.size(), units);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int32_t MaterialTable::base_index(const uint32_t& mesh_id)
+{
+    if (m_mesh_base_index.find(mesh_id) != m_mesh_base_index.end())
+        return m_mesh_base_index[mesh_id];
+    else
+        return -1;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MaterialTable::update()
+{
+    std::vector<uint32_t> dirty_materials;
+
+    for (auto& table_texture : m_textures)
+    {
+        auto texture = table_texture.texture.lock();
+
+        if (!texture)
+        {
+            create_gpu_resources();
+            return;
+        }
+
+        if (texture->version() == table_texture.version)
+            continue;
+
+        if (m_bindless)
+        {
+            table_texture.reference = resident_handle(texture);
+            dirty_materials.insert(dirty_materials.end(), table_texture.materials.begin(), table_texture.materials.end());
+        }
+        else if (fits_texture_array(texture, table_texture.reference))
+            copy_to_texture_array(texture, table_texture.reference);
+        else
+        {
+            create_gpu_resources();
+            return;
+        }
+
+        table_texture.version = texture->version();
+    }
+
+    // Only the entries of textures that got a new handle are written again.
+    std::sort(dirty_materials.begin(), dirty_materials.end());
+    dirty_materials.erase(std::unique(dirty_materials.begin(), dirty_materials.end()), dirty_materials.end());
+
+    for (auto& idx : dirty_materials)
+    {
+        auto material = m_materials[idx].lock();
+
+        if (!material)
+        {
+            create_gpu_resources();
+            return;
+        }
+
+        MaterialData data = material_data(material);
+        m_material_data_buffer->write_data(sizeof(MaterialData) * idx, sizeof(MaterialData), &data);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MaterialTable::create_gpu_resources()
+{
+    std::vector<gl::Texture2D::Ptr> textures;
+
+    m_material_data_buffer.reset();
+    m_texture_arrays.clear();
+    m_textures.clear();
+    m_texture_indices.clear();
+    m_materials.clear();
+    m_mesh_base_index.clear();
+
+    // Gather the unique textures referenced by all materials.
+    for (auto& weak_mesh : m_meshes)
+    {
+        auto mesh = weak_mesh.lock();
+
+        if (!mesh)
+            continue;
+
+        for (auto& mat : mesh->materials())
+        {
+            gl::Texture2D::Ptr mat_textures[] = { mat->albedo_texture(), mat->normal_texture(), mat->roughness_texture(), mat->metallic_texture(), mat->emissive_texture() };
+
+            for (auto& texture : mat_textures)
+            {
+                if (texture && m_texture_indices.find(texture.get()) == m_texture_indices.end())
+                {
+                    m_texture_indices[texture.get()] = m_textures.size();
+                    m_textures.push_back({ texture, texture->version(), glm::uvec2(0), {} });
+                    textures.push_back(texture);
+                }
+            }
+        }
+    }
+
+    if (m_bindless)
+    {
+        for (uint32_t i = 0; i < textures.size(); i++)
+            m_textures[i].reference = resident_handle(textures[i]);
+    }
+    else
+        create_texture_arrays(textures);
+
+    // Pack material data. Each mesh gets a contiguous range so that Vertex::position.w can be used as an offset into it.
+    std::vector<MaterialData> material_datas;
+
+    for (auto& weak_mesh : m_meshes)
+    {
+        auto mesh = weak_mesh.lock();
+
+        if (!mesh || m_mesh_base_index.find(mesh->id()) != m_mesh_base_index.end())
+            continue;
+
+        m_mesh_base_index[mesh->id()] = material_datas.size();
+
+        for (auto& mat : mesh->materials())
+        {
+            gl::Texture2D::Ptr mat_textures[] = { mat->albedo_texture(), mat->normal_texture(), mat->roughness_texture(), mat->metallic_texture(), mat->emissive_texture() };
+
+            for (auto& texture : mat_textures)
+            {
+                if (!texture)
+                    continue;
+
+                std::vector<uint32_t>& materials = m_textures[m_texture_indices[texture.get()]].materials;
+
+                if (materials.empty() || materials.back() != material_datas.size())
+                    materials.push_back(material_datas.size());
+            }
+
+            m_materials.push_back(mat);
+            material_datas.push_back(material_data(mat));
+        }
+    }
+
+    m_material_count = material_datas.size();
+
+    if (material_datas.size() > 0)
+    {
+        m_material_data_buffer = gl::Buffer::create(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_STORAGE_BIT, sizeof(MaterialData) * material_datas.size(), material_datas.data());
+        m_material_data_buffer->set_name("Material Table");
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MaterialTable::create_texture_arrays(const std::vector<gl::Texture2D::Ptr>& textures)
+{
+    // Textures can only share an array if their dimensions, mip chain and format match.
+    std::vector<TextureArrayKey>                 keys;
+    std::vector<std::vector<gl::Texture2D::Ptr>> buckets;
+
+    for (auto& texture : textures)
+    {
+        TextureArrayKey key = { texture->width(), texture->height(), texture->mip_levels(), texture->internal_format() };
+
+        uint32_t bucket_idx = std::find(keys.begin(), keys.end(), key) - keys.begin();
+
+        if (bucket_idx == keys.size())
+        {
+            if (keys.size() == MAX_TEXTURE_ARRAYS)
+            {
+                DW_LOG_ERROR("MaterialTable: Exceeded {} texture arrays, texture will fall back to constant material values.", MAX_TEXTURE_ARRAYS);
+                continue;
+            }
+
+            keys.push_back(key);
+            buckets.push_back({});
+        }
+
+        buckets[bucket_idx].push_back(texture);
+    }
+
+    for (uint32_t i = 0; i < buckets.size(); i++)
+    {
+        const TextureArrayKey& key = keys[i];
+
+        // Texture2D only creates an array target for more than one layer.
+        uint32_t array_size = std::max(uint32_t(buckets[i].size()), 2u);
+
+        gl::Texture2D::Ptr texture_array = gl::Texture2D::create(key.width, key.height, array_size, key.mip_levels, 1, key.internal_format, buckets[i][0]->format(), buckets[i][0]->type());
+        texture_array->set_name("Material Table Texture Array " + std::to_string(i));
+
+        m_texture_arrays.push_back(texture_array);
+
+        for (uint32_t layer = 0; layer < buckets[i].size(); layer++)
+        {
+            gl::Texture2D::Ptr texture   = buckets[i][layer];
+            glm::uvec2         reference = glm::uvec2(i + 1, layer);
+
+            copy_to_texture_array(texture, reference);
+
+            m_textures[m_texture_indices[texture.get()]].reference = reference;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool MaterialTable::fits_texture_array(gl::Texture2D::Ptr texture, const glm::uvec2& reference)
+{
+    // Textures that did not get an array have to wait for a rebuild, they may fit one now.
+    if (reference.x == 0)
+        return false;
+
+    gl::Texture2D::Ptr texture_array = m_texture_arrays[reference.x - 1];
+
+    return texture->width() == texture_array->width() && texture->height() == texture_array->height() && texture->mip_levels() == texture_array->mip_levels() && texture->internal_format() == texture_array->internal_format();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MaterialTable::copy_to_texture_array(gl::Texture2D::Ptr texture, const glm::uvec2& reference)
+{
+    gl::Texture2D::Ptr texture_array = m_texture_arrays[reference.x - 1];
+
+    for (uint32_t mip = 0; mip < texture->mip_levels(); mip++)
+    {
+        int width, height;
+        texture->extents(mip, width, height);
+
+        glCopyImageSubData(texture->id(), GL_TEXTURE_2D, mip, 0, 0, 0, texture_array->id(), GL_TEXTURE_2D_ARRAY, mip, 0, 0, reference.y, width, height, 1);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MaterialTable::MaterialData MaterialTable::material_data(Material::Ptr material)
+{
+    MaterialData material_data;
+
+    glm::uvec2 albedo    = texture_reference(material->albedo_texture());
+    glm::uvec2 normal    = texture_reference(material->normal_texture());
+    glm::uvec2 roughness = texture_reference(material->roughness_texture());
+    glm::uvec2 metallic  = texture_reference(material->metallic_texture());
+    glm::uvec2 emissive  = texture_reference(material->emissive_texture());
+
+    material_data.texture0           = glm::uvec4(albedo, normal);
+    material_data.texture1           = glm::uvec4(roughness, metallic);
+    material_data.texture2           = glm::uvec4(emissive, uint32_t(glm::max(material->roughness_channel(), 0)), uint32_t(glm::max(material->metallic_channel(), 0)));
+    material_data.albedo             = material->albedo_value();
+    material_data.emissive           = glm::vec4(material->emissive_value(), 0.0f);
+    material_data.roughness_metallic = glm::vec4(material->roughness_value(), material->metallic_value(), 0.0f, 0.0f);
+
+    return material_data;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+glm::uvec2 MaterialTable::texture_reference(gl::Texture2D::Ptr texture)
+{
+    if (texture && m_texture_indices.find(texture.get()) != m_texture_indices.end())
+        return m_textures[m_texture_indices[texture.get()]].reference;
+    else
+        return glm::uvec2(0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace dw
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <mesh.h>
+
+#if !defined(DWSF_VULKAN)
+
+namespace dw
+{
+// GPU-resident table of every material used by a set of meshes. Material parameters are packed into a single SSBO and textures
+// are referenced through ARB_bindless_texture handles, or through texture arrays when bindless textures are unavailable. Shaders
+// look up a material with base_index(mesh) + Vertex::position.w, see assets/shaders/material_table.glsl.
+class MaterialTable
+{
+public:
+    using Ptr = std::shared_ptr<MaterialTable>;
+
+    static MaterialTable::Ptr create(std::vector<std::weak_ptr<Mesh>> meshes, bool allow_bindless = true);
+
+    ~MaterialTable();
+
+    // Binds the material SSBO and, for the texture array fallback, the texture arrays starting at the given texture unit. Calls
+    // update() first.
+    void    bind(gl::Program::Ptr program, uint32_t ssbo_binding, uint32_t first_texture_unit = 0);
+    int32_t base_index(const uint32_t& mesh_id);
+
+    // Catches up with textures whose storage has been replaced since the last update, e.g. when the TextureStreamer swaps in
+    // more mips. Bindless entries of those textures get the new handle, texture array layers are copied again. The table is
+    // only rebuilt if a texture no longer fits its array or has been destroyed.
+    void update();
+
+    inline bool            bindless() { return m_bindless; }
+    inline uint32_t        material_count() { return m_material_count; }
+    inline uint32_t        texture_array_count() { return m_texture_arrays.size(); }
+    inline gl::Buffer::Ptr material_data_buffer() { return m_material_data_buffer; }
+
+private:
+    struct MaterialData;
+
+    struct TableTexture
+    {
+        std::weak_ptr<gl::Texture2D> texture;
+        uint32_t                     version;   // Version of the texture when its reference was last written.
+        glm::uvec2                   reference; // Bindless handle, or texture array index + 1 and layer.
+        std::vector<uint32_t>        materials; // Table entries that reference the texture.
+    };
+
+    MaterialTable(std::vector<std::weak_ptr<Mesh>> meshes, bool allow_bindless);
+    void         create_gpu_resources();
+    void         create_texture_arrays(const std::vector<gl::Texture2D::Ptr>& textures);
+    bool         fits_texture_array(gl::Texture2D::Ptr texture, const glm::uvec2& reference);
+    void         copy_to_texture_array(gl::Texture2D::Ptr texture, const glm::uvec2& reference);
+    MaterialData material_data(std::shared_ptr<Material> material);
+    glm::uvec2   texture_reference(gl::Texture2D::Ptr texture);
+
+private:
+    bool                                         m_bindless       = false;
+    uint32_t                                     m_material_count = 0;
+    std::vector<std::weak_ptr<Mesh>>             m_meshes;
+    std::vector<std::weak_ptr<Material>>         m_materials; // Material of every table entry.
+    gl::Buffer::Ptr                              m_material_data_buffer;
+    std::vector<gl::Texture2D::Ptr>              m_texture_arrays;
+    std::vector<TableTexture>                    m_textures;
+    std::unordered_map<gl::Texture2D*, uint32_t> m_texture_indices; // Keyed by object as swapping storage changes the GL name.
+    std::unordered_map<uint32_t, uint32_t>       m_mesh_base_index;
+};
+} // namespace dw
+
+#endif
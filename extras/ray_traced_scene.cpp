@@ -1,5 +1,6 @@
 #include "ray_traced_scene.h"
 #include <macros.h>
+#include <logger.h>
 #if defined(DWSF_VULKAN)
 #    include <vk_mem_alloc.h>
 #endif
@@ -8,7 +9,6 @@
 #include <profiler.h>
 #include <assimp/scene.h>
 
-#define MAX_MATERIAL_COUNT 1024
 #define MAX_INSTANCES 1024
 
 #if defined(DWSF_VULKAN)
@@ -25,17 +25,6 @@ struct InstanceData
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-struct MaterialData
-{
-    glm::ivec4 texture_indices0 = glm::ivec4(-1); // x: albedo, y: normals, z: roughness, w: metallic
-    glm::ivec4 texture_indices1 = glm::ivec4(-1); // x: emissive, z: roughness_channel, w: metallic_channel
-    glm::vec4  albedo;
-    glm::vec4  emissive;
-    glm::vec4  roughness_metallic;
-};
-
-// -----------------------------------------------------------------------------------------------------------------------------------
-
 static uint32_t g_last_scene_idx = 0;
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -96,10 +85,6 @@ RayTracedScene::RayTracedScene(vk::Backend::Ptr backend, std::vector<Instance> i
     m_tlas_scratch_buffer = vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, m_tlas->build_sizes().buildScratchSize, VMA_MEMORY_USAGE_GPU_ONLY, 0);
     m_tlas_scratch_buffer->set_name("TLAS Scratch Buffer");
 
-    // Create material data buffer
-    m_material_data_buffer = vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(MaterialData) * MAX_MATERIAL_COUNT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
-    m_material_data_buffer->set_name("Material Data Buffer");
-
     // Create instance data buffer
     m_instance_data_buffer = vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(InstanceData) * MAX_INSTANCES, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
     m_instance_data_buffer->set_name("Instance Data Buffer");
@@ -108,13 +93,13 @@ RayTracedScene::RayTracedScene(vk::Backend::Ptr backend, std::vector<Instance> i
 
     dp_desc.set_max_sets(1)
         .add_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10)
-        .add_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2048)
         .add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * MAX_INSTANCES)
         .add_pool_size(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 10);
 
     m_descriptor_pool = vk::DescriptorPool::create(backend, dp_desc);
     m_descriptor_pool->set_name("Scene Descriptor Pool");
 
+    // Material data and textures are not part of the scene set, shaders read them from Material::heap_descriptor_set().
     vk::DescriptorSetLayout::Desc scene_ds_layout_desc;
 
     std::vector<VkDescriptorBindingFlags> descriptor_binding_flags = {
@@ -122,8 +107,6 @@ RayTracedScene::RayTracedScene(vk::Backend::Ptr backend, std::vector<Instance> i
         VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
         VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
         VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
-        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
-        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
         VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
     };
 
@@ -131,12 +114,10 @@ RayTracedScene::RayTracedScene(vk::Backend::Ptr backend, std::vector<Instance> i
     DW_ZERO_MEMORY(set_layout_binding_flags);
 
     set_layout_binding_flags.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
-    set_layout_binding_flags.bindingCount  = 7;
+    set_layout_binding_flags.bindingCount  = 5;
     set_layout_binding_flags.pBindingFlags = descriptor_binding_flags.data();
 
     scene_ds_layout_desc.set_next_ptr(&set_layout_binding_flags);
-    // Material Data
-    scene_ds_layout_desc.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
     // Instance Data
     scene_ds_layout_desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
     // Acceleration Structures
@@ -147,8 +128,6 @@ RayTracedScene::RayTracedScene(vk::Backend::Ptr backend, std::vector<Instance> i
     scene_ds_layout_desc.add_binding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_INSTANCES, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
     // Material Indices Buffers
     scene_ds_layout_desc.add_binding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_INSTANCES, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
-    // Textures
-    scene_ds_layout_desc.add_binding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2048, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
 
     m_ds_layout = vk::DescriptorSetLayout::create(backend, scene_ds_layout_desc);
     m_ds_layout->set_name("Scene Descriptor Set Layout");
@@ -156,6 +135,9 @@ RayTracedScene::RayTracedScene(vk::Backend::Ptr backend, std::vector<Instance> i
     m_ds = vk::DescriptorSet::create(backend, m_ds_layout, m_descriptor_pool);
     m_ds->set_name("Scene Descriptor Set");
 
+    if (!Material::heap_descriptor_set_layout())
+        DW_LOG_ERROR("RayTracedScene: Material heap unavailable, material indices will be -1.");
+
     create_gpu_resources();
 
     // Compute scene bounds
@@ -193,7 +175,6 @@ RayTracedScene::~RayTracedScene()
     m_ds.reset();
     m_ds_layout.reset();
     m_descriptor_pool.reset();
-    m_material_data_buffer.reset();
     m_instance_data_buffer.reset();
     m_material_indices_buffers.clear();
     m_tlas_instance_buffer_host.reset();
@@ -301,12 +282,10 @@ void RayTracedScene::create_gpu_resources()
 
     std::unordered_set<uint32_t> processed_meshes;
     std::unordered_set<uint32_t> processed_materials;
-    std::vector<MaterialData>    material_datas;
 
     std::vector<VkDescriptorBufferInfo> vbo_descriptors;
     std::vector<VkDescriptorBufferInfo> ibo_descriptors;
     std::vector<VkDescriptorBufferInfo> material_indices_descriptors;
-    std::vector<VkDescriptorImageInfo>  image_descriptors;
 
     m_material_indices_buffers.reserve(m_instances.size());
 
@@ -363,84 +342,9 @@ void RayTracedScene::create_gpu_resources()
                 if (processed_materials.find(mat->id()) == processed_materials.end())
                 {
                     processed_materials.insert(mat->id());
-                    m_local_to_global_mat_idx[mat->id()] = material_datas.size();
-
-                    MaterialData material_data;
-
-                    material_data.albedo = mat->albedo_value();
-                    // Covert from sRGB to Linear
-                    material_data.albedo             = glm::vec4(glm::pow(glm::vec3(material_data.albedo[0], material_data.albedo[1], material_data.albedo[2]), glm::vec3(2.2f)), material_data.albedo.a);
-                    material_data.roughness_metallic = glm::vec4(mat->roughness_value(), mat->metallic_value(), 0.0f, 0.0f);
-                    material_data.emissive           = glm::vec4(mat->emissive_value(), 0.0f);
-
-                    if (mat->albedo_image_view())
-                    {
-                        VkDescriptorImageInfo image_info;
-
-                        image_info.sampler     = Material::common_sampler()->handle();
-                        image_info.imageView   = mat->albedo_image_view()->handle();
-                        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-                        material_data.texture_indices0.x = image_descriptors.size();
-
-                        image_descriptors.push_back(image_info);
-                    }
-
-                    if (mat->normal_image_view())
-                    {
-                        VkDescriptorImageInfo image_info;
-
-                        image_info.sampler     = Material::common_sampler()->handle();
-                        image_info.imageView   = mat->normal_image_view()->handle();
-                        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-                        material_data.texture_indices0.y = image_descriptors.size();
-
-                        image_descriptors.push_back(image_info);
-                    }
-
-                    if (mat->roughness_image_view())
-                    {
-                        VkDescriptorImageInfo image_info;
-
-                        image_info.sampler     = Material::common_sampler()->handle();
-                        image_info.imageView   = mat->roughness_image_view()->handle();
-                        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-                        material_data.texture_indices0.z = image_descriptors.size();
-                        material_data.texture_indices1.z = mat->roughness_channel();
-
-                        image_descriptors.push_back(image_info);
-                    }
-
-                    if (mat->metallic_image_view())
-                    {
-                        VkDescriptorImageInfo image_info;
-
-                        image_info.sampler     = Material::common_sampler()->handle();
-                        image_info.imageView   = mat->metallic_image_view()->handle();
-                        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-                        material_data.texture_indices0.w = image_descriptors.size();
-                        material_data.texture_indices1.w = mat->metallic_channel();
-
-                        image_descriptors.push_back(image_info);
-                    }
-
-                    if (mat->emissive_image_view())
-                    {
-                        VkDescriptorImageInfo image_info;
-
-                        image_info.sampler     = Material::common_sampler()->handle();
-                        image_info.imageView   = mat->emissive_image_view()->handle();
-                        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-                        material_data.texture_indices1.x = image_descriptors.size();
-
-                        image_descriptors.push_back(image_info);
-                    }
-
-                    material_datas.push_back(material_data);
+                    // Materials are indexed by their slot in the shared material heap.
+                    m_local_to_global_mat_idx[mat->id()] = mat->heap_index();
                 }
 
                 glm::uvec2 pair               = glm::uvec2(submesh.base_index / 3, m_local_to_global_mat_idx[mat->id()]);
@@ -449,33 +353,10 @@ void RayTracedScene::create_gpu_resources()
         }
     }
 
-    memcpy(m_material_data_buffer->mapped_ptr(), material_datas.data(), sizeof(MaterialData) * material_datas.size());
-
     std::vector<VkWriteDescriptorSet> write_datas;
 
     VkWriteDescriptorSet write_data;
 
-    // ------------------------------------------------------------------------------------------
-    // Material Data
-    // ------------------------------------------------------------------------------------------
-
-    DW_ZERO_MEMORY(write_data);
-
-    VkDescriptorBufferInfo material_buffer_info;
-
-    material_buffer_info.buffer = m_material_data_buffer->handle();
-    material_buffer_info.offset = 0;
-    material_buffer_info.range  = VK_WHOLE_SIZE;
-
-    write_data.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    write_data.descriptorCount = 1;
-    write_data.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    write_data.pBufferInfo     = &material_buffer_info;
-    write_data.dstBinding      = 0;
-    write_data.dstSet          = m_ds->handle();
-
-    write_datas.push_back(write_data);
-
     // ------------------------------------------------------------------------------------------
     // Instance Data
     // ------------------------------------------------------------------------------------------
@@ -575,24 +456,6 @@ void RayTracedScene::create_gpu_resources()
         write_datas.push_back(write_data);
     }
 
-    // ------------------------------------------------------------------------------------------
-    // Images
-    // ------------------------------------------------------------------------------------------
-
-    if (image_descriptors.size() > 0)
-    {
-        DW_ZERO_MEMORY(write_data);
-
-        write_data.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write_data.descriptorCount = image_descriptors.size();
-        write_data.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        write_data.pImageInfo      = image_descriptors.data();
-        write_data.dstBinding      = 6;
-        write_data.dstSet          = m_ds->handle();
-
-        write_datas.push_back(write_data);
-    }
-
     if (write_datas.size() > 0)
         vkUpdateDescriptorSets(backend->device(), write_datas.size(), write_datas.data(), 0, nullptr);
 }
@@ -47,7 +47,6 @@ private:
     vk::DescriptorPool::Ptr                m_descriptor_pool;
     vk::DescriptorSetLayout::Ptr           m_ds_layout;
     vk::DescriptorSet::Ptr                 m_ds;
-    vk::Buffer::Ptr                        m_material_data_buffer;
     vk::Buffer::Ptr                        m_instance_data_buffer;
     std::vector<vk::Buffer::Ptr>           m_material_indices_buffers;
     std::vector<Instance>                  m_instances;
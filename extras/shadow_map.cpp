@@ -1,6 +1,7 @@
 #include "shadow_map.h"
 #include <gtc/matrix_transform.hpp>
 #include <macros.h>
+#include <profiler.h>
 #include <imgui.h>
 
 #if defined(DWSF_VULKAN)
@@ -120,7 +121,7 @@ void ShadowMap::begin_render(
     info.clearValueCount          = 1;
     info.pClearValues             = &clear_value;
 
-    vkCmdBeginRenderPass(cmd_buf->handle(), &info, VK_SUBPASS_CONTENTS_INLINE);
+    profiler::begin_render_pass(cmd_buf, info, VK_SUBPASS_CONTENTS_INLINE);
 
     VkViewport vp;
 
@@ -165,7 +166,7 @@ void ShadowMap::end_render(
 )
 {
 #if defined(DWSF_VULKAN)
-    vkCmdEndRenderPass(cmd_buf->handle());
+    profiler::end_render_pass(cmd_buf);
 #else
     glEnable(GL_CULL_FACE);
 #endif
@@ -3,6 +3,7 @@
 #include <debug_draw.h>
 #include <stdint.h>
 #include <array>
+#include <memory>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -29,17 +30,51 @@
 #define MAX_KEYS 1024
 #define MAX_MOUSE_BUTTONS 5
 
+// Frames kept for the frame pacing statistics.
+#define FRAME_PACING_HISTORY 240
+
+// Render packets in pipelined mode, one being prepared while the other renders.
+#define PIPELINE_DEPTH 2
+
+// Frames the GL driver may queue in pipelined mode. Under Vulkan the backend bounds them to Backend::kMaxFramesInFlight.
+#define PIPELINE_GL_FRAMES_IN_FLIGHT 2
+
+// Delta passed to update() while benchmarking, in milliseconds, so that every run does the same work.
+#define BENCHMARK_FRAME_DELTA (1000.0 / 60.0)
+
 namespace dw
 {
+class Camera;
+class DemoPlayer;
+
 struct AppSettings
 {
-    bool        maximized  = false;
-    bool        fullscreen = false;  
-    bool        vsync      = false;
-    bool        srgb       = false;
-    int         width      = 400;
-    int         height     = 300;
-    std::string title      = "dwSampleFramwork";
+    bool        maximized   = false;
+    bool        fullscreen  = false;  
+    bool        vsync       = false;
+    bool        srgb        = false;
+    int         width       = 400;
+    int         height      = 300;
+    std::string title       = "dwSampleFramwork";
+    double      max_fps     = 0.0; // Frame rate limit, 0 for none.
+    bool        low_latency = false;
+    bool        headless    = false; // Renders into the back buffer of an invisible window.
+
+    // Milliseconds between simulate() calls, 0 to disable. At most max_simulation_steps run per frame, time beyond that is
+    // dropped so that a slow frame can not snowball into ever more steps.
+    double      fixed_timestep       = 0.0;
+    uint32_t    max_simulation_steps = 5;
+
+    // Overlaps the simulation of the next frame with the rendering of the current one: prepare() and render() are called
+    // instead of update(), see below. Doubles the throughput of frames split evenly between both, at one frame of latency.
+    bool        pipelined = false;
+
+    // Runs benchmark_warmup frames, then benchmark_frames frames or one pass of the demo given to set_benchmark_demo(), writes
+    // the frame time and profiler statistics to benchmark_report (JSON, or CSV if the path ends in .csv) and exits.
+    bool        benchmark        = false;
+    uint32_t    benchmark_frames = 1000;
+    uint32_t    benchmark_warmup = 60;
+    std::string benchmark_report = "benchmark.json";
 
 #if defined(DWSF_VULKAN)
     std::vector<const char*> device_extensions; 
@@ -50,6 +85,35 @@ struct AppSettings
 #endif
 };
 
+// Frame times over the last FRAME_PACING_HISTORY frames, in milliseconds.
+struct FramePacingStats
+{
+    uint32_t frames;
+    uint32_t late; // Frames that took more than 10% longer than the target frame time.
+    double   mean;
+    double   std_dev;
+    double   min;
+    double   max;
+    double   p50;
+    double   p95;
+    double   p99;
+};
+
+// Everything render() needs to draw a frame in pipelined mode. Derive from it to add the scene data, such as the camera and
+// the visible objects.
+struct RenderPacket
+{
+    virtual ~RenderPacket() = default;
+
+    uint64_t frame = 0;
+    double   delta = 0.0;
+    double   alpha = 0.0; // Interpolation alpha of the fixed timestep simulation.
+};
+
+#if defined(DWSF_VULKAN)
+static_assert(PIPELINE_DEPTH <= vk::Backend::kMaxFramesInFlight, "A render packet could outlive the per frame resources it was prepared for.");
+#endif
+
 class Application
 {
 public:
@@ -95,11 +159,52 @@ protected:
     void request_exit() const;
     bool exit_requested() const;
 
+    // Frame rate limiter, 0 to disable. Frames are paced to a fixed cadence with Timer::sleep_until(), which keeps frame times
+    // steady without burning a core. Has no effect under Emscripten, where the browser paces the frames.
+    void   set_target_fps(double fps);
+    double target_fps() const;
+
+    // With a frame rate limit, waits at the start of the frame instead of after it. Input is then polled as late as possible,
+    // at the predicted start time that lets the frame finish right on its deadline.
+    void set_low_latency(bool enabled);
+    bool low_latency() const;
+
+    FramePacingStats frame_pacing_stats() const;
+
+#if defined(DWSF_IMGUI)
+    void frame_pacing_ui();
+#endif
+
+    // In benchmark mode, plays the demo from the start once the warmup is over, updating it and the camera before every
+    // update() until it has gone through its path once. Call from init().
+    void set_benchmark_demo(DemoPlayer* demo, Camera* camera);
+    bool benchmarking() const;
+
+    // Fixed timestep simulation, see AppSettings::fixed_timestep.
+    void     set_fixed_timestep(double timestep, uint32_t max_steps);
+    double   fixed_timestep() const;
+    uint32_t simulation_steps() const; // Steps taken this frame.
+
+    // How far this frame lies between the last and the next simulation step, in [0, 1), for interpolating simulated state in
+    // update(). In pipelined mode use RenderPacket::alpha instead.
+    double simulation_alpha() const;
+
     // Life cycle hooks. Override these!
     virtual bool init(int argc, const char* argv[]);
     virtual void update(double delta);
     virtual void shutdown();
 
+    // Runs every fixed_timestep milliseconds of frame time, before update(). dt is always the fixed timestep.
+    virtual void simulate(double dt);
+
+    // Pipelined mode. prepare() runs on a job worker and fills the packet of the next frame, after simulate(). It must not touch
+    // the graphics API or ImGui. render() runs on the main thread at the same time, it draws the packet prepared during the
+    // previous frame and must not touch anything prepare() writes. create_render_packet() is called PIPELINE_DEPTH times up
+    // front, the packets are then reused in turn.
+    virtual std::unique_ptr<RenderPacket> create_render_packet();
+    virtual void                          prepare(RenderPacket& packet);
+    virtual void                          render(const RenderPacket& packet);
+
 #if defined(DWSF_VULKAN)
 #    if defined(DWSF_IMGUI)
     void render_gui(vk::CommandBuffer::Ptr cmd_buf);
@@ -112,6 +217,18 @@ private:
     void begin_frame();
     void end_frame();
 
+    // Advances the frame deadline and waits for it, less lead time.
+    void pace_frame(uint64_t lead_time);
+
+    // Runs the benchmark demo and the fixed timestep simulation, returns the interpolation alpha.
+    double update_simulation(double delta);
+    void   update_pipelined(double delta);
+    void   prepare_render_packet(RenderPacket& packet, double delta);
+
+    void start_benchmark();
+    void benchmark_frame();
+    void write_benchmark_report();
+
     // Internal lifecycle methods
     bool init_base(int argc, const char* argv[]);
     void update_base(double delta);
@@ -120,6 +237,9 @@ private:
     // Load config from file method
     void load_initial_settings_from_file(AppSettings& settings);
 
+    // --headless, --benchmark, --benchmark-frames=N, --benchmark-warmup=N and --benchmark-report=path override the settings.
+    void parse_command_line(int argc, const char* argv[], AppSettings& settings);
+
 protected:
     uint32_t                            m_width;
     uint32_t                            m_height;
@@ -139,6 +259,45 @@ protected:
     Timer                               m_timer;
     DebugDraw                           m_debug_draw;
 
+    // Frame pacing, in nanoseconds on the Timer clock.
+    uint64_t                                m_frame_period     = 0;
+    uint64_t                                m_frame_deadline   = 0;
+    uint64_t                                m_work_start       = 0;
+    double                                  m_predicted_work   = 0.0;
+    bool                                    m_low_latency      = false;
+    std::array<float, FRAME_PACING_HISTORY> m_frame_times;
+    uint32_t                                m_frame_time_count = 0;
+
+    // Benchmark mode.
+    bool               m_headless            = false;
+    bool               m_benchmark           = false;
+    uint32_t           m_benchmark_frames    = 0;
+    uint32_t           m_benchmark_warmup    = 0;
+    uint32_t           m_benchmark_frame     = 0;
+    uint64_t           m_benchmark_start     = 0;
+    double             m_benchmark_demo_time = 0.0;
+    std::string        m_benchmark_report;
+    std::vector<float> m_benchmark_times;
+    DemoPlayer*        m_benchmark_demo   = nullptr;
+    Camera*            m_benchmark_camera = nullptr;
+
+    // Fixed timestep simulation.
+    double   m_fixed_timestep       = 0.0;
+    double   m_simulation_time      = 0.0; // Frame time not yet simulated.
+    uint32_t m_max_simulation_steps = 5;
+    uint32_t m_simulation_steps     = 0;
+    double   m_simulation_alpha     = 0.0;
+
+    // Pipelined mode.
+    bool                          m_pipelined         = false;
+    uint32_t                      m_render_packet_idx = 0;
+    uint64_t                      m_prepared_frames   = 0;
+    std::unique_ptr<RenderPacket> m_render_packets[PIPELINE_DEPTH];
+#if !defined(DWSF_VULKAN)
+    gl::Fence m_frame_fences[PIPELINE_GL_FRAMES_IN_FLIGHT];
+    uint32_t  m_frame_fence_idx = 0;
+#endif
+
 #if defined(DWSF_VULKAN)
     bool                            m_should_recreate_swap_chain = false;
     vk::Backend::Ptr                m_vk_backend;
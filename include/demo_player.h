@@ -2,6 +2,7 @@
 
 #include <camera.h>
 #include <debug_draw.h>
+#include <string>
 #include <vector>
 
 namespace dw
@@ -62,7 +63,7 @@ public:
     DemoPlayer();
     DemoPlayer(const std::vector<glm::vec3>& position_frames, const std::vector<glm::vec3>& forward_frames, const std::vector<glm::vec3>& right_frames);
     ~DemoPlayer();
-    bool      load_from_file();
+    bool      load_from_file(const std::string& path = "camera_path.bin");
     void      edit_ui(Camera* camera);
     void      debug_visualization(DebugDraw& debug_draw);
     float     speed();
@@ -70,6 +71,7 @@ public:
     void      play();
     void      stop();
     bool      is_playing();
+    float     duration(); // Seconds to go through the path once.
     void      update(float dt, Camera* camera);
     glm::vec3 position();
     glm::vec3 forward();
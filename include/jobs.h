@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+namespace dw
+{
+namespace jobs
+{
+struct Job;
+struct Scheduler;
+
+// Number of jobs that have been submitted against it and not finished yet. Jobs can be made to wait for a counter to reach
+// zero with run_after(), and wait() works on other jobs until it does. A counter must outlive the jobs submitted against it
+// and wait() must have returned before it is destroyed.
+class Counter
+{
+public:
+    Counter() = default;
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    inline uint32_t pending() const { return m_pending.load(std::memory_order_acquire); }
+    inline bool     done() const { return pending() == 0; }
+
+private:
+    friend struct Scheduler;
+
+    std::atomic<uint32_t> m_pending = { 0 };
+    std::mutex            m_mutex; // Guards the continuations and the decrement to zero.
+    std::vector<Job*>     m_continuations;
+};
+
+using Function = std::function<void()>;
+
+// Starts worker_count worker threads, 0 for one less than the number of hardware threads. The calling thread becomes the
+// main thread. Without workers, or before initialize(), jobs run right away on the thread that submits them.
+extern void     initialize(uint32_t worker_count = 0);
+extern void     shutdown();
+extern uint32_t worker_count();
+
+// 0 on the main thread, 1 to worker_count() on the workers and UINT32_MAX on any other thread. Handy for indexing per
+// thread scratch memory.
+extern uint32_t thread_index();
+
+// Queues a job on the calling worker's deque, idle workers steal from the other end. counter, if any, is incremented now and
+// decremented once the job has finished. Named jobs show up as CPU samples in the profiler, the name must be a string that
+// lives as long as the program.
+extern void run(Function func, Counter* counter = nullptr, const char* name = nullptr);
+
+// Queues the job once dependency reaches zero.
+extern void run_after(Counter& dependency, Function func, Counter* counter = nullptr, const char* name = nullptr);
+
+// Queues a job that only runs on the main thread, from run_main_thread_jobs() or from wait() on the main thread. For work
+// that needs the graphics context, such as uploads of data decoded by other jobs.
+extern void run_on_main_thread(Function func, Counter* counter = nullptr, const char* name = nullptr);
+
+// Called by the Application at the start of every frame.
+extern void run_main_thread_jobs();
+
+// Runs other jobs until the counter reaches zero. A worker waiting on main thread jobs waits until the main thread gets
+// to them.
+extern void wait(Counter& counter);
+
+// Calls func(first, last) on chunks of [begin, end) of at most grain items in parallel, the calling thread included, and
+// returns once all of them are done. A grain of 0 picks one that gives every thread a few chunks to balance the load.
+template <typename F>
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, F&& func, const char* name = nullptr)
+{
+    if (end <= begin)
+        return;
+
+    uint32_t count = end - begin;
+
+    if (grain == 0)
+        grain = std::max(1u, count / ((worker_count() + 1) * 4));
+
+    if (count <= grain || worker_count() == 0)
+    {
+        func(begin, end);
+        return;
+    }
+
+    Counter counter;
+
+    for (uint32_t first = begin, last; first < end; first = last)
+    {
+        last = first + std::min(grain, end - first);
+
+        run([&func, first, last]() { func(first, last); }, &counter, name);
+    }
+
+    wait(counter);
+}
+} // namespace jobs
+} // namespace dw
@@ -1,12 +1,52 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <iosfwd>
+#include <cstdint>
+#include <type_traits>
 
-// Macros for quick access. File and line are added through the respective macros.
-#define DW_LOG_INFO(x) dw::logger::log(x, std::string(__FILE__), __LINE__, dw::logger::LEVEL_INFO)
-#define DW_LOG_WARNING(x) dw::logger::log(x, std::string(__FILE__), __LINE__, dw::logger::LEVEL_WARNING)
-#define DW_LOG_ERROR(x) dw::logger::log(x, std::string(__FILE__), __LINE__, dw::logger::LEVEL_ERR)
-#define DW_LOG_FATAL(x) dw::logger::log(x, std::string(__FILE__), __LINE__, dw::logger::LEVEL_FATAL)
+// Lowest level that is compiled in, set through LOG_MIN_LEVEL in CMake. Macros below it expand to nothing, so their
+// arguments are not evaluated either: 0 = info, 1 = warning, 2 = error, 3 = fatal.
+#if !defined(DWSF_LOG_MIN_LEVEL)
+#    define DWSF_LOG_MIN_LEVEL 0
+#endif
+
+// Macros for quick access. File and line are added through the respective macros. The message is a format string where
+// every {} is replaced by the next argument, formatting happens on the logger thread. A format spec such as {:.2f} or
+// {:08x} is passed on to printf for numbers. Messages without arguments are written as they are.
+#define DW_LOG_IMPL(level, ...)                                                                             \
+    do                                                                                                      \
+    {                                                                                                       \
+        static constexpr const char* __dw_log_file = dw::logger::file_name(__FILE__);                       \
+        dw::logger::log(level, __dw_log_file, __LINE__, __VA_ARGS__);                                       \
+    } while (0)
+
+#if DWSF_LOG_MIN_LEVEL <= 0
+#    define DW_LOG_INFO(...) DW_LOG_IMPL(dw::logger::LEVEL_INFO, __VA_ARGS__)
+#else
+#    define DW_LOG_INFO(...) ((void)0)
+#endif
+
+#if DWSF_LOG_MIN_LEVEL <= 1
+#    define DW_LOG_WARNING(...) DW_LOG_IMPL(dw::logger::LEVEL_WARNING, __VA_ARGS__)
+#else
+#    define DW_LOG_WARNING(...) ((void)0)
+#endif
+
+#if DWSF_LOG_MIN_LEVEL <= 2
+#    define DW_LOG_ERROR(...) DW_LOG_IMPL(dw::logger::LEVEL_ERR, __VA_ARGS__)
+#else
+#    define DW_LOG_ERROR(...) ((void)0)
+#endif
+
+#if DWSF_LOG_MIN_LEVEL <= 3
+#    define DW_LOG_FATAL(...) DW_LOG_IMPL(dw::logger::LEVEL_FATAL, __VA_ARGS__)
+#else
+#    define DW_LOG_FATAL(...) ((void)0)
+#endif
+
+#define LOG_MAX_ARGUMENTS 8
 
 namespace dw
 {
@@ -30,36 +70,187 @@ enum LogVerbosity
     VERBOSITY_ALL       = 0x0f
 };
 
-// Custom stream callback type. Use to implement your own logging stream such as through a network etc.
+// Log argument, captured by the calling thread and formatted by the logger thread. Strings are copied into the queue.
+struct Argument
+{
+    enum Type : uint8_t
+    {
+        TYPE_BOOL,
+        TYPE_CHAR,
+        TYPE_INT,
+        TYPE_UINT,
+        TYPE_DOUBLE,
+        TYPE_STRING,
+        TYPE_POINTER
+    };
+
+    Type type;
+
+    union
+    {
+        bool        b;
+        char        c;
+        int64_t     i;
+        uint64_t    u;
+        double      d;
+        const void* p;
+        struct
+        {
+            const char* data;
+            size_t      size;
+        } str;
+    };
+};
+
+template <typename T>
+inline Argument make_argument(const T& value)
+{
+    Argument arg;
+
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        arg.type = Argument::TYPE_BOOL;
+        arg.b    = value;
+    }
+    else if constexpr (std::is_same_v<T, char>)
+    {
+        arg.type = Argument::TYPE_CHAR;
+        arg.c    = value;
+    }
+    else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+    {
+        arg.type = Argument::TYPE_INT;
+        arg.i    = value;
+    }
+    else if constexpr (std::is_integral_v<T>)
+    {
+        arg.type = Argument::TYPE_UINT;
+        arg.u    = value;
+    }
+    else if constexpr (std::is_enum_v<T>)
+    {
+        arg.type = Argument::TYPE_INT;
+        arg.i    = int64_t(value);
+    }
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        arg.type = Argument::TYPE_DOUBLE;
+        arg.d    = value;
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+    {
+        std::string_view str;
+
+        if constexpr (std::is_pointer_v<T>)
+            str = value ? std::string_view(value) : std::string_view("(null)");
+        else
+            str = value;
+
+        arg.type     = Argument::TYPE_STRING;
+        arg.str.data = str.data();
+        arg.str.size = str.size();
+    }
+    else
+    {
+        static_assert(std::is_pointer_v<T>, "Unsupported log argument type.");
+
+        arg.type = Argument::TYPE_POINTER;
+        arg.p    = value;
+    }
+
+    return arg;
+}
+
+// Part of a path after the last separator, evaluated at compile time by the macros.
+constexpr const char* file_name(const char* path)
+{
+    const char* name = path;
+
+    for (const char* c = path; *c; c++)
+    {
+        if (*c == '/' || *c == '\\')
+            name = c + 1;
+    }
+
+    return name;
+}
+
+// Custom stream callback type. Use to implement your own logging stream such as through a network etc. Called on the logger
+// thread once initialize() has been called.
 typedef void (*CustomStreamCallback)(std::string, LogLevel);
 
+// Starts the logger thread. Messages are then copied into a fixed queue and formatted and written on that thread, so logging
+// never waits on the streams. When the queue is full, info and warning messages are dropped and counted while errors wait
+// for room. Fatal messages return once they have been written and the streams flushed.
 extern void initialize();
+// Writes out everything still queued and stops the logger thread, later messages are written synchronously.
+extern void shutdown();
 extern void set_verbosity(int flags);
 
 // Open streams.
 extern void open_file_stream();
 extern void open_console_stream();
 extern void open_custom_stream(CustomStreamCallback callback);
+// Binary stream for long runs. Messages are written as a site ID plus the raw argument values into a memory-mapped file,
+// which keeps them a fraction of the size of the text log and skips formatting when no text stream is open. Files are
+// named path.0 to path.N, once one reaches file_size the next is started and the oldest overwritten. The mapped pages
+// survive a crash of the process. Read them back with decode_binary_log() or the dwlog_decode tool.
+extern bool open_binary_stream(const std::string& path = "log.bin", size_t file_size = 16 * 1024 * 1024, uint32_t file_count = 4);
 
 // Close streams.
 extern void close_file_stream();
 extern void close_console_stream();
 extern void close_custom_stream();
+extern void close_binary_stream();
+
+// The last messages are also kept in a fixed in-memory ring, copied there by the logging thread without locks or
+// allocations. Once install_crash_handler() has been called, the ring is written to path when a fatal message is logged
+// and when the process crashes, so the recent history survives without flushing the streams after every line.
+extern void install_crash_handler(const std::string& path = "crash_log.txt");
+extern void dump_crash_log();
+
+// Writes the messages of every file of a binary log to output as text, oldest first.
+extern bool decode_binary_log(const std::string& path, std::ostream& output);
 
 // Debug mode. These will flush the stream immediately after each log.
 extern void enable_debug_mode();
 extern void disable_debug_mode();
 
-// Main log method. File, line and level are required in addition to log message.
+// Main log method. File must outlive the call, such as the basename of __FILE__ the macros pass in. A null file leaves out
+// file and line.
+extern void log_arguments(LogLevel level, const char* file, int line, std::string_view format, const Argument* arguments, uint32_t argument_count);
+
+template <typename... Args>
+inline void log(LogLevel level, const char* file, int line, std::string_view format, const Args&... args)
+{
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGUMENTS, "Too many log arguments.");
+
+    if constexpr (sizeof...(Args) == 0)
+        log_arguments(level, file, line, format, nullptr, 0);
+    else
+    {
+        const Argument arguments[] = { make_argument(args)... };
+        log_arguments(level, file, line, format, arguments, sizeof...(Args));
+    }
+}
+
+// Kept for callers with a dynamic file name.
 extern void log(std::string text, std::string file, int line, LogLevel level);
 
 // Simplified API.
-extern void log_info(std::string text);
-extern void log_error(std::string text);
-extern void log_warning(std::string text);
-extern void log_fatal(std::string text);
+template <typename... Args>
+inline void log_info(std::string_view format, const Args&... args) { log(LEVEL_INFO, nullptr, 0, format, args...); }
+
+template <typename... Args>
+inline void log_error(std::string_view format, const Args&... args) { log(LEVEL_ERR, nullptr, 0, format, args...); }
+
+template <typename... Args>
+inline void log_warning(std::string_view format, const Args&... args) { log(LEVEL_WARNING, nullptr, 0, format, args...); }
+
+template <typename... Args>
+inline void log_fatal(std::string_view format, const Args&... args) { log(LEVEL_FATAL, nullptr, 0, format, args...); }
 
-// Explicitly flush all streams.
+// Explicitly flush all streams. Blocks until every message logged before the call has been written.
 extern void flush();
 } // namespace logger
 } // namespace dw
@@ -9,6 +9,8 @@
 
 namespace dw
 {
+class TextureStreamer;
+
 class Material
 {
 public:
@@ -24,7 +26,11 @@ public:
         const int32_t&                  normal_idx,
         const glm::ivec2&               roughness_idx,
         const glm::ivec2&               metallic_idx,
-        const int32_t&                  emissive_idx);
+        const int32_t&                  emissive_idx,
+        const glm::vec4&                albedo_value    = glm::vec4(1.0f),
+        const float&                    roughness_value = 1.0f,
+        const float&                    metallic_value  = 0.0f,
+        const glm::vec3&                emissive_value  = glm::vec3(0.0f));
 
     // Custom factory method for creating a material from provided data.
     static Material::Ptr create(glm::vec4 albedo    = glm::vec4(1.0f),
@@ -32,11 +38,24 @@ public:
                                 float     metalness = 0.0f,
                                 glm::vec3 emissive  = glm::vec3(0.0f));
 
-    static bool is_loaded(const std::string& name);
+    // Content hash of the full parameter block. Materials loaded with the same key are shared.
+    static uint64_t hash(const std::vector<std::string>& textures,
+                         const int32_t&                  albedo_idx,
+                         const int32_t&                  normal_idx,
+                         const glm::ivec2&               roughness_idx,
+                         const glm::ivec2&               metallic_idx,
+                         const int32_t&                  emissive_idx,
+                         const glm::vec4&                albedo_value,
+                         const float&                    roughness_value,
+                         const float&                    metallic_value,
+                         const glm::vec3&                emissive_value);
+
+    static bool is_loaded(const uint64_t& key);
 
     ~Material();
 
     inline uint32_t  id() { return m_id; }
+    inline uint64_t  key() { return m_key; }
     inline glm::vec4 albedo_value() { return m_albedo_color; }
     inline float     roughness_value() { return m_roughness; }
     inline float     metallic_value() { return m_metallic; }
@@ -51,10 +70,15 @@ public:
     inline int32_t roughness_channel() { return m_roughness_channel; }
     inline int32_t metallic_channel() { return m_metallic_channel; }
 
-    inline void set_albedo_value(const glm::vec4& value) { m_albedo_color = value; }
-    inline void set_roughness_value(const float& value) { m_roughness = value; }
-    inline void set_metallic_value(const float& value) { m_metallic = value; }
-    inline void set_emissive_value(const glm::vec3& value) { m_emissive_color = value; }
+    // Materials returned by load() are shared by every load with the same parameters. Changing one through the setters changes
+    // it for all of them and takes it out of the cache, so that later loads get the parameters they asked for. Use clone() to
+    // change a copy of your own instead.
+    Material::Ptr clone();
+
+    void        set_albedo_value(const glm::vec4& value);
+    void        set_roughness_value(const float& value);
+    void        set_metallic_value(const float& value);
+    void        set_emissive_value(const glm::vec3& value);
     inline void set_alpha_test(const bool& value) { m_alpha_test = value; }
 
     // Texture factory methods.
@@ -76,6 +100,18 @@ public:
     inline vk::DescriptorSet::Ptr              descriptor_set() { return m_descriptor_set; }
     static inline vk::Sampler::Ptr             common_sampler() { return m_common_sampler; }
     static inline vk::DescriptorSetLayout::Ptr descriptor_set_layout() { return m_common_ds_layout; }
+
+    // Bindless material heap shared by all materials. Binding 0 holds the material parameters indexed by heap_index(), binding 1
+    // an update-after-bind texture array indexed by heap_texture_index() in albedo, normal, roughness, metallic, emissive order.
+    // Only created if the device supports descriptor indexing, heap_index() is -1 and the getters return null otherwise.
+    inline int32_t                      heap_index() { return m_heap_idx; }
+    inline int32_t                      heap_texture_index(uint32_t i) { return m_heap_texture_indices[i]; }
+    static vk::DescriptorSetLayout::Ptr heap_descriptor_set_layout();
+    static vk::DescriptorSet::Ptr       heap_descriptor_set(); // For the current frame in flight.
+
+    // Brings the material data of the current frame in flight up to date with changes made while it was in use. Called by the
+    // Application once the frame has been acquired.
+    static void update_heap();
 #else
     // Rendering related getters.
     inline gl::Texture2D::Ptr       albedo_texture() { return m_albedo_idx != -1 ? m_textures[m_albedo_idx] : nullptr; }
@@ -84,14 +120,34 @@ public:
     inline gl::Texture2D::Ptr       metallic_texture() { return m_metallic_idx != -1 ? m_textures[m_metallic_idx] : nullptr; }
     inline gl::Texture2D::Ptr       emissive_texture() { return m_emissive_idx != -1 ? m_textures[m_emissive_idx] : nullptr; }
 
+    // Textures of materials loaded while a streamer is set are streamed in instead of loaded synchronously.
+    static inline void set_texture_streamer(std::shared_ptr<TextureStreamer> streamer) { m_texture_streamer = streamer; }
+
 #endif
 
 private:
+    void remove_from_cache();
+
+    // Canonical byte form of a load() parameter block, hash() is computed over it.
+    static std::string parameter_block(const std::vector<std::string>& textures,
+                                       const int32_t&                  albedo_idx,
+                                       const int32_t&                  normal_idx,
+                                       const glm::ivec2&               roughness_idx,
+                                       const glm::ivec2&               metallic_idx,
+                                       const int32_t&                  emissive_idx,
+                                       const glm::vec4&                albedo_value,
+                                       const float&                    roughness_value,
+                                       const float&                    metallic_value,
+                                       const glm::vec3&                emissive_value);
+
 #if defined(DWSF_VULKAN)
     static vk::Image::Ptr     load_image(vk::Backend::Ptr backend, const std::string& path, bool srgb = false);
     static vk::ImageView::Ptr load_image_view(vk::Backend::Ptr backend, const std::string& path, vk::Image::Ptr image);
 
     vk::DescriptorSet::Ptr create_descriptor_set(vk::Backend::Ptr backend);
+    void                   allocate_heap_slots();
+    void                   free_heap_slots();
+    void                   write_heap_data();
 #else
     static gl::Texture2D::Ptr       load_texture(const std::string& path, bool srgb = false);
 #endif
@@ -111,8 +167,14 @@ private:
     Material();
 
 private:
-    // Material cache.
-    static std::unordered_map<std::string, std::weak_ptr<Material>> m_cache;
+    // Material cache. Keyed by the content hash of the parameter block, which is kept to tell apart blocks with the same hash.
+    struct CacheEntry
+    {
+        std::string             parameters;
+        std::weak_ptr<Material> material;
+    };
+
+    static std::unordered_map<uint64_t, CacheEntry> m_cache;
 
     int32_t   m_albedo_idx        = -1;
     int32_t   m_normal_idx        = -1;
@@ -127,7 +189,8 @@ private:
     float     m_metallic          = 0.0f;
     bool      m_alpha_test        = false;
 
-    uint32_t m_id = 0;
+    uint32_t m_id  = 0;
+    uint64_t m_key = 0;
 
     // Texture list. In the same order as the Assimp texture enums.
 #if defined(DWSF_VULKAN)
@@ -135,6 +198,8 @@ private:
     std::vector<vk::ImageView::Ptr> m_image_views;
 
     vk::DescriptorSet::Ptr m_descriptor_set;
+    int32_t                m_heap_idx                = -1;
+    int32_t                m_heap_texture_indices[5] = { -1, -1, -1, -1, -1 };
 
     // Texture cache.
     static std::unordered_map<std::string, std::weak_ptr<vk::Image>>     m_image_cache;
@@ -148,6 +213,7 @@ private:
 
     // Texture cache.
     static std::unordered_map<std::string, std::weak_ptr<gl::Texture2D>> m_texture_cache;
+    static std::shared_ptr<TextureStreamer>                               m_texture_streamer;
 #endif
 };
 } // namespace dw
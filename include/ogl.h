@@ -36,11 +36,7 @@
                         case GL_INVALID_FRAMEBUFFER_OPERATION: error = "INVALID_FRAMEBUFFER_OPERATION"; break; \
                     }                                                                                          \
                                                                                                                \
-                    std::string formatted_error = "OPENGL: ";                                                  \
-                    formatted_error             = formatted_error + error;                                     \
-                    formatted_error             = formatted_error + ", LINE:";                                 \
-                    formatted_error             = formatted_error + std::to_string(__LINE__);                  \
-                    DW_LOG_ERROR(formatted_error);                                                             \
+                    DW_LOG_ERROR("OPENGL: {}, LINE:{}", error, __LINE__);                                      \
                     err = glGetError();                                                                        \
                 }                                                                                              \
             }
@@ -54,8 +50,17 @@
 
 namespace dw
 {
+namespace profiler
+{
+enum MemoryCategory : uint32_t;
+} // namespace profiler
+
 namespace gl
 {
+// Bytes per texel, or per 4x4 block for block compressed formats, as the driver is assumed to store them. For memory
+// accounting only.
+extern size_t texel_size_from_internal_format(GLenum fmt, bool& block_compressed);
+
 class Object
 {
 public:
@@ -108,26 +113,36 @@ public:
     bool     is_compressed(int mip_level);
     int      compressed_size(int mip_level);
     GLuint64 make_texture_handle_resident();
+    GLuint64 texture_handle();
     void     make_texture_handle_non_resident();
     GLuint64 make_image_handle_resident(GLenum access, GLint level, GLboolean layered, GLint layer);
     void     make_image_handle_non_resident();
 
+    // Moves the storage to another memory category, e.g. once it is used as a render target.
+    void                            set_memory_category(profiler::MemoryCategory category);
+    inline profiler::MemoryCategory memory_category() { return m_memory_category; }
+    inline uint64_t                 memory_size() { return m_memory_size; }
+
     void set_name(const std::string& name);
 
 protected:
     Texture();
+    void track_storage(uint32_t width, uint32_t height, uint32_t depth, uint32_t layers, uint32_t samples);
+    void release_storage();
 
 protected:
-    GLuint   m_gl_tex = UINT32_MAX;
-    GLenum   m_target;
-    GLenum   m_internal_format;
-    GLenum   m_format;
-    GLenum   m_type;
-    uint32_t m_version = 0;
-    uint32_t m_array_size;
-    uint32_t m_mip_levels;
-    GLuint64 m_texture_handle = 0;
-    GLuint64 m_image_handle   = 0;
+    GLuint                   m_gl_tex = UINT32_MAX;
+    GLenum                   m_target;
+    GLenum                   m_internal_format;
+    GLenum                   m_format;
+    GLenum                   m_type;
+    uint32_t                 m_version = 0;
+    uint32_t                 m_array_size;
+    uint32_t                 m_mip_levels;
+    GLuint64                 m_texture_handle = 0;
+    GLuint64                 m_image_handle   = 0;
+    uint64_t                 m_memory_size    = 0;
+    profiler::MemoryCategory m_memory_category;
 };
 
 class Texture1D : public Texture
@@ -172,6 +187,7 @@ public:
     void     read_data(int mip_level, std::vector<uint8_t>& buffer);
     void     extents(int mip_level, int& width, int& height);
     void     resize(uint32_t w, uint32_t h);
+    void     swap_storage(Texture2D::Ptr other);
     uint32_t width();
     uint32_t height();
     uint32_t num_samples();
@@ -488,9 +504,10 @@ private:
     Buffer(GLenum type, GLenum flags, size_t size, void* data);
 
 protected:
-    GLenum m_type;
-    GLuint m_gl_buffer;
-    size_t m_size;
+    GLenum                   m_type;
+    GLuint                   m_gl_buffer;
+    size_t                   m_size;
+    profiler::MemoryCategory m_memory_category;
 };
 
 struct VertexAttrib
@@ -3,27 +3,132 @@
 #include <ogl.h>
 #include <memory>
 #include <string>
+#include <vector>
+#include <atomic>
 
 #if defined(DWSF_VULKAN)
 #    include "vk.h"
 #endif
 
+#define DW_PROFILER_CONCAT_IMPL(a, b) a##b
+#define DW_PROFILER_CONCAT(a, b) DW_PROFILER_CONCAT_IMPL(a, b)
+
+// The name is interned once per call site, so it must be the same every time the line runs. Use begin_sample()/end_sample()
+// with an std::string for names that change.
 #if defined(DWSF_VULKAN)
-#    define DW_SCOPED_SAMPLE(name, cmd_buf) dw::profiler::ScopedProfile __FILE__##__LINE__(name, cmd_buf)
+#    define DW_SCOPED_SAMPLE(name, cmd_buf)                                                 \
+        static const dw::profiler::Marker DW_PROFILER_CONCAT(__dw_marker_, __LINE__)(name); \
+        dw::profiler::ScopedProfile       DW_PROFILER_CONCAT(__dw_scoped_sample_, __LINE__)(DW_PROFILER_CONCAT(__dw_marker_, __LINE__), cmd_buf)
 #else
-#    define DW_SCOPED_SAMPLE(name) dw::profiler::ScopedProfile __FILE__##__LINE__(name)
+#    define DW_SCOPED_SAMPLE(name)                                                          \
+        static const dw::profiler::Marker DW_PROFILER_CONCAT(__dw_marker_, __LINE__)(name); \
+        dw::profiler::ScopedProfile       DW_PROFILER_CONCAT(__dw_scoped_sample_, __LINE__)(DW_PROFILER_CONCAT(__dw_marker_, __LINE__))
 #endif
 
 namespace dw
 {
 namespace profiler
 {
+// Interned sample name. The name is registered once when the marker is constructed, samples then only carry the ID and a
+// pointer to the registry's copy of the name.
+struct Marker
+{
+    explicit Marker(const std::string& name);
+
+    uint32_t    id;
+    const char* name;
+};
+
+enum TimeSource
+{
+    TIME_SOURCE_CPU,
+    TIME_SOURCE_GPU
+};
+
+// Time a scope took per frame over the last frames, in milliseconds. Scopes recorded several times in a frame add up.
+struct Statistics
+{
+    uint32_t frames;
+    uint32_t spikes; // Frames in the window that took more than twice the mean.
+    float    min;
+    float    mean;
+    float    max;
+    float    std_dev;
+    float    p50;
+    float    p95;
+    float    p99;
+};
+
+// Rendering counters, incremented by the gl:: and vk:: wrappers and reset every frame. Draws, dispatches and binds issued
+// outside the wrappers can be counted with increment() as well.
+enum Counter
+{
+    COUNTER_DRAW_CALLS,
+    COUNTER_DISPATCHES,
+    COUNTER_INDICES,
+    COUNTER_PIPELINE_BINDS,
+    COUNTER_VERTEX_ARRAY_BINDS,
+    COUNTER_TEXTURE_BINDS,
+    COUNTER_BUFFER_MAPS,
+    COUNTER_BUFFERS_CREATED,
+    COUNTER_UPLOAD_BYTES,
+    COUNTER_ALLOCATIONS,
+    COUNTER_ALLOCATED_BYTES,
+    COUNTER_COUNT
+};
+
+extern std::atomic<uint64_t> g_counters[COUNTER_COUNT];
+
+inline void increment(Counter counter, uint64_t value = 1) { g_counters[counter].fetch_add(value, std::memory_order_relaxed); }
+
+// GPU memory held by the gl:: and vk:: resources, tallied when they are created and destroyed. The wrappers pick the category
+// from the resource type and usage, wrap the creation in a ScopedMemoryCategory to override it.
+enum MemoryCategory : uint32_t
+{
+    MEMORY_CATEGORY_MESHES,
+    MEMORY_CATEGORY_TEXTURES,
+    MEMORY_CATEGORY_RENDER_TARGETS,
+    MEMORY_CATEGORY_STAGING,
+    MEMORY_CATEGORY_DEBUG_DRAW,
+    MEMORY_CATEGORY_OTHER,
+    MEMORY_CATEGORY_COUNT
+};
+
+struct MemoryUsage
+{
+    uint64_t bytes;
+    uint64_t peak_bytes;
+    uint64_t allocations;
+};
+
+struct ScopedMemoryCategory
+{
+    explicit ScopedMemoryCategory(MemoryCategory category);
+    ~ScopedMemoryCategory();
+
+    MemoryCategory m_previous;
+};
+
+// Call site that allocated most often during an allocation capture.
+struct AllocationSite
+{
+    uint64_t                 count;
+    uint64_t                 bytes;
+    std::vector<std::string> stack; // Innermost frame first.
+};
+
 struct ScopedProfile
 {
-    ScopedProfile(std::string name
+    ScopedProfile(const Marker& marker
 #if defined(DWSF_VULKAN)
                   ,
-                  vk::CommandBuffer::Ptr cmd_buf
+                  const vk::CommandBuffer::Ptr& cmd_buf
+#endif
+    );
+    ScopedProfile(const std::string& name
+#if defined(DWSF_VULKAN)
+                  ,
+                  const vk::CommandBuffer::Ptr& cmd_buf
 #endif
     );
     ~ScopedProfile();
@@ -31,7 +136,7 @@ struct ScopedProfile
 #if defined(DWSF_VULKAN)
     vk::CommandBuffer::Ptr m_cmd_buf;
 #endif
-    std::string m_name;
+    Marker m_marker;
 };
 
 extern void initialize(
@@ -40,24 +145,96 @@ extern void initialize(
 #endif
 );
 extern void shutdown();
-extern void begin_sample(std::string name
+extern void begin_sample(const Marker& marker
+#if defined(DWSF_VULKAN)
+                         ,
+                         const vk::CommandBuffer::Ptr& cmd_buf
+#endif
+);
+extern void end_sample(const Marker& marker
+#if defined(DWSF_VULKAN)
+                       ,
+                       const vk::CommandBuffer::Ptr& cmd_buf
+#endif
+);
+// Interns the name on every call, prefer a Marker on hot paths.
+extern void begin_sample(const std::string& name
 #if defined(DWSF_VULKAN)
                          ,
-                         vk::CommandBuffer::Ptr cmd_buf
+                         const vk::CommandBuffer::Ptr& cmd_buf
 #endif
 );
-extern void end_sample(std::string name
+extern void end_sample(const std::string& name
 #if defined(DWSF_VULKAN)
                        ,
-                       vk::CommandBuffer::Ptr cmd_buf
+                       const vk::CommandBuffer::Ptr& cmd_buf
 #endif
 );
+// CPU only sample on any thread, the main thread included. For work that may run on whichever thread picks it up, such as jobs.
+// Does nothing while the profiler is not initialized.
+extern void begin_cpu_sample(const Marker& marker);
+extern void end_cpu_sample();
 extern void begin_frame();
 extern void end_frame();
 
+// Name shown for the calling thread. Samples recorded outside the thread that initialized the profiler are CPU only and go
+// into lock-free per-thread buffers that are merged at end_frame().
+extern void set_thread_name(const std::string& name);
+
+// Records CPU samples of every thread and GPU samples for the next frame_count frames and writes them to path in the Chrome
+// Trace Event format (chrome://tracing, ui.perfetto.dev), along with frame markers and a frame time counter. Main thread only,
+// the file is written once the GPU time stamps of the last captured frame have been read back.
+extern void capture(uint32_t frame_count, const std::string& path);
+extern bool is_capturing();
+
+// Rolling statistics, safe to query from any thread. Returns false if the scope has not been recorded yet.
+extern bool statistics(const Marker& marker, TimeSource source, Statistics& stats);
+extern bool statistics(const std::string& name, TimeSource source, Statistics& stats);
+extern void reset_statistics();
+
+// Names of all scopes that have statistics, in the order they were first recorded.
+extern void scopes(std::vector<std::string>& names);
+
+// Collects input assembly, vertex, clipping, fragment and compute invocation counts for every main thread scope from the next
+// frame on, shown next to the GPU times. Under Vulkan, a query can not span a render pass boundary, so render passes recorded
+// within a scope must be begun and ended through begin_render_pass() and end_render_pass(), and must have a single subpass.
+extern void set_pipeline_statistics(bool enabled);
+extern bool pipeline_statistics();
+
+#if defined(DWSF_VULKAN)
+// vkCmdBeginRenderPass() and vkCmdEndRenderPass() that split the pipeline statistics queries of the open scopes at the render
+// pass boundaries.
+extern void begin_render_pass(const vk::CommandBuffer::Ptr& cmd_buf, const VkRenderPassBeginInfo& info, VkSubpassContents contents);
+extern void end_render_pass(const vk::CommandBuffer::Ptr& cmd_buf);
+#endif
+
+// Value of a counter in the last completed frame.
+extern uint64_t    counter(Counter counter);
+extern const char* counter_name(Counter counter);
+
+// Category set by the innermost ScopedMemoryCategory of the calling thread, or fallback outside of one.
+extern MemoryCategory memory_category(MemoryCategory fallback);
+extern void           track_allocation(MemoryCategory category, uint64_t size);
+extern void           track_free(MemoryCategory category, uint64_t size);
+extern MemoryUsage    memory_usage(MemoryCategory category);
+extern const char*    memory_category_name(MemoryCategory category);
+
+// Heap allocation tracking, available when the framework is built with ENABLE_ALLOCATION_TRACKING, which replaces the global
+// operator new. Allocations and allocated bytes are then counted per frame (COUNTER_ALLOCATIONS, COUNTER_ALLOCATED_BYTES) and
+// per main thread scope. A capture records the call stack of every allocation made on any thread during the next frame_count
+// frames, the sites that allocated most often are kept once it ends. Main thread only.
+extern bool allocation_tracking();
+extern void capture_allocations(uint32_t frame_count);
+extern bool is_capturing_allocations();
+extern void allocation_sites(std::vector<AllocationSite>& sites);
+
+// Name registry.
+extern uint32_t    intern(const std::string& name);
+extern const char* marker_name(uint32_t id);
+
 #if defined(DWSF_IMGUI)
 extern void ui();
 #endif
 
 }; // namespace profiler
-} // namespace dw
\ No newline at end of file
+} // namespace dw
@@ -0,0 +1,99 @@
+#pragma once
+
+#if !defined(DWSF_VULKAN)
+
+#include <ogl.h>
+#include <glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace dw
+{
+class Mesh;
+
+// Streams the mip chain of 2D textures on demand. load() returns a 1x1 placeholder immediately, the image is decoded on a
+// background thread and its low mip tail uploaded as soon as it is ready. Higher mips are then made resident as texel
+// density feedback requests them, within a VRAM budget where the top mips of the least recently used textures are evicted
+// first. Residency changes reallocate the GL storage in place, so cached bindless handles must be refreshed when
+// Texture::version() changes.
+class TextureStreamer
+{
+public:
+    using Ptr = std::shared_ptr<TextureStreamer>;
+
+    static TextureStreamer::Ptr create(size_t budget, uint32_t mip_tail_size = 64, size_t upload_budget = 8 * 1024 * 1024);
+
+    ~TextureStreamer();
+
+    gl::Texture2D::Ptr load(const std::string& path, bool srgb = false);
+
+    // Feedback for the current frame. The mesh variant estimates the required mip of every material texture from the
+    // projected texel density of each submesh.
+    void add_feedback(std::shared_ptr<Mesh> mesh, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, uint32_t viewport_height);
+    void add_feedback(gl::Texture2D::Ptr texture, uint32_t mip);
+
+    // Uploads decoded textures, streams in requested mips and evicts over budget. Call once per frame on the GL thread.
+    void update();
+    void ui();
+
+    inline void   set_budget(size_t budget) { m_budget = budget; }
+    inline size_t budget() { return m_budget; }
+    inline size_t resident_size() { return m_resident_size; }
+
+private:
+    struct StreamedTexture
+    {
+        std::weak_ptr<gl::Texture2D>      texture;
+        gl::Texture2D*                    key = nullptr;
+        std::string                       path;
+        bool                              srgb   = false;
+        bool                              failed = false; // Written by the loader thread before the record is handed back.
+        bool                              ready  = false; // Main thread only, set once the decoded mips have been received.
+        std::vector<std::vector<uint8_t>> mips;
+        uint32_t                          width          = 0;
+        uint32_t                          height         = 0;
+        uint32_t                          channels       = 0;
+        uint32_t                          mip_count      = 0;
+        uint32_t                          tail_mip       = 0;
+        int32_t                           resident_mip   = -1; // -1 while only the placeholder is resident.
+        uint32_t                          requested_mip  = UINT32_MAX;
+        uint64_t                          last_requested = 0;
+        size_t                            resident_size  = 0;
+    };
+
+    TextureStreamer(size_t budget, uint32_t mip_tail_size, size_t upload_budget);
+    void   loader_thread();
+    void   decode(StreamedTexture* record);
+    void   make_resident(StreamedTexture* record, uint32_t top_mip);
+    bool   evict(size_t size, uint64_t frame);
+    size_t mip_chain_size(StreamedTexture* record, uint32_t top_mip);
+    float  uv_density(std::shared_ptr<Mesh> mesh, uint32_t submesh_idx);
+
+private:
+    size_t   m_budget;
+    size_t   m_upload_budget;
+    size_t   m_resident_size = 0;
+    uint32_t m_mip_tail_size;
+    uint64_t m_frame = 0;
+
+    std::vector<std::shared_ptr<StreamedTexture>>                 m_textures;
+    std::unordered_map<gl::Texture2D*, StreamedTexture*>          m_texture_map;
+    std::unordered_map<std::string, std::weak_ptr<gl::Texture2D>> m_cache;
+    std::unordered_map<uint64_t, float>                           m_uv_density_cache;
+
+    std::thread                                                   m_thread;
+    std::mutex                                                    m_mutex;
+    std::condition_variable                                       m_cv;
+    bool                                                          m_quit = false;
+    std::deque<std::shared_ptr<StreamedTexture>>                  m_pending;
+    std::deque<std::shared_ptr<StreamedTexture>>                  m_decoded;
+};
+} // namespace dw
+
+#endif
@@ -1,34 +1,88 @@
 #pragma once
 
-#if defined(WIN32)
-#    include <windows.h>
-#else
-#    include <sys/time.h>
-#endif
+#include <atomic>
+#include <cstdint>
+#include <vector>
 
+// Monotonic nanosecond clock (std::chrono::steady_clock). Shared by the timer, the stopwatches and the CPU times of the
+// profiler, so all of them can be compared directly.
 class Timer
 {
 public:
     Timer();
     ~Timer();
 
-    void   start();
-    void   stop();
-    double elapsed_time();
-    double elapsed_time_sec();
-    double elapsed_time_milisec();
-    double elapsed_time_microsec();
+    // Nanoseconds since an arbitrary fixed point.
+    static uint64_t now();
+
+    // Waits until now() reaches time. Sleeps in 1 ms steps while the remaining time is longer than a sleep has been observed
+    // to take and spins for the rest, so it is precise to a few microseconds while leaving the core idle for most of a long
+    // wait. On Windows the first call raises the system timer resolution to 1 ms for the rest of the process.
+    static void sleep_until(uint64_t time);
+
+    void     start();
+    void     stop();
+    double   elapsed_time();
+    double   elapsed_time_sec();
+    double   elapsed_time_milisec();
+    double   elapsed_time_microsec();
+    uint64_t elapsed_time_nanosec();
+
+private:
+    uint64_t _start_time;
+    uint64_t _end_time;
+    bool     _stopped;
+};
+
+// Accumulates the time spent in a scope across calls and threads, without locks. Meant for scopes too short or too
+// frequent for the profiler. Create them through DW_SCOPED_STOPWATCH, they are registered for the lifetime of the process.
+class Stopwatch
+{
+public:
+    struct Statistics
+    {
+        const char* name;
+        uint64_t    count;
+        uint64_t    total;
+        uint64_t    min;
+        uint64_t    max; // All in nanoseconds.
+    };
+
+    explicit Stopwatch(const char* name);
+
+    void add(uint64_t duration);
+    void reset();
+
+    Statistics statistics() const;
+
+    static void all(std::vector<Statistics>& statistics);
+    static void reset_all();
+
+private:
+    const char*           m_name;
+    std::atomic<uint64_t> m_count = { 0 };
+    std::atomic<uint64_t> m_total = { 0 };
+    std::atomic<uint64_t> m_min   = { UINT64_MAX };
+    std::atomic<uint64_t> m_max   = { 0 };
+    Stopwatch*            m_next  = nullptr;
+};
+
+class ScopedStopwatch
+{
+public:
+    explicit ScopedStopwatch(Stopwatch& stopwatch) :
+        m_stopwatch(stopwatch), m_start(Timer::now()) {}
+    ~ScopedStopwatch() { m_stopwatch.add(Timer::now() - m_start); }
 
 private:
-    double _start_time_microsec;
-    double _end_time_microsec;
-    int    _stopped;
-#ifdef WIN32
-    LARGE_INTEGER _frequency;
-    LARGE_INTEGER _start_count;
-    LARGE_INTEGER _end_count;
-#else
-    timeval _start_count;
-    timeval _end_count;
-#endif
+    Stopwatch& m_stopwatch;
+    uint64_t   m_start;
 };
+
+#define DW_STOPWATCH_CONCAT_IMPL(a, b) a##b
+#define DW_STOPWATCH_CONCAT(a, b) DW_STOPWATCH_CONCAT_IMPL(a, b)
+
+// The name is registered once per call site, so it must be a string that lives as long as the program.
+#define DW_SCOPED_STOPWATCH(name)                                                      \
+    static Stopwatch DW_STOPWATCH_CONCAT(__dw_stopwatch_, __LINE__)(name);             \
+    ScopedStopwatch  DW_STOPWATCH_CONCAT(__dw_scoped_stopwatch_, __LINE__)(DW_STOPWATCH_CONCAT(__dw_stopwatch_, __LINE__))
@@ -6,6 +6,7 @@
 #include <cassert>
 #include <algorithm>
 #include <stdio.h>
+#include <stdint.h>
 #include <ogl.h>
 
 namespace dw
@@ -40,6 +41,17 @@ extern std::string current_working_directory();
 // Changes the current working directory.
 extern void change_current_working_directory(std::string path);
 
+// Converts 32-bit floats to IEEE half floats with round-to-nearest-even. Vectorized with SSE2 where available.
+extern void float_to_half(const float* src, uint16_t* dst, size_t count);
+
+// Decodes a Radiance RGBE (.hdr) image straight to RGBA16F. Returns false for files it does not handle (e.g. XYZE or
+// rotated images), which should then go through stb_image instead.
+extern bool load_rgbe_half(const std::string& path, bool flip_vertical, int& width, int& height, std::vector<uint16_t>& out);
+
+// Loads a .hdr image as RGBA16F with load_rgbe_half(), falling back to stb_image for anything it does not handle. Safe to call
+// from several threads at once.
+extern bool load_hdr_half(const std::string& path, bool flip_vertical, int& width, int& height, std::vector<uint16_t>& out);
+
 #if !defined(DWSF_VULKAN)
 // Create compute program
 extern bool create_compute_program(const std::string& path, gl::Shader::Ptr& shader, gl::Program::Ptr& program, std::vector<std::string> defines = std::vector<std::string>());
@@ -17,6 +17,11 @@ enum VmaMemoryUsage;
 
 namespace dw
 {
+namespace profiler
+{
+enum MemoryCategory : uint32_t;
+} // namespace profiler
+
 namespace vk
 {
 class Object;
@@ -125,18 +130,23 @@ public:
     void             process_deletion_queue();
     void             queue_object_deletion(std::shared_ptr<Object> object);
 
-    inline VkPhysicalDeviceRayTracingPipelinePropertiesKHR    ray_tracing_pipeline_properties() { return m_ray_tracing_pipeline_properties; }
-    inline VkPhysicalDeviceAccelerationStructurePropertiesKHR acceleration_structure_properties() { return m_acceleration_structure_properties; }
-    inline VkFormat                                           swap_chain_image_format() { return m_swap_chain_image_format; }
-    inline VkFormat                                           swap_chain_depth_format() { return m_swap_chain_depth_format; }
-    inline VkExtent2D                                         swap_chain_extents() { return m_swap_chain_extent; }
-    inline uint32_t                                           current_frame_idx() { return m_current_frame; }
-    inline uint32_t                                           swapchain_size() { return m_swap_chain_images.size(); }
-    inline const QueueInfos&                                  queue_infos() { return m_selected_queues; }
-    inline std::shared_ptr<Sampler>                           bilinear_sampler() { return m_bilinear_sampler; }
-    inline std::shared_ptr<Sampler>                           trilinear_sampler() { return m_trilinear_sampler; }
-    inline std::shared_ptr<Sampler>                           nearest_sampler() { return m_nearest_sampler; }
-    inline std::shared_ptr<ImageView>                         default_cubemap() { return m_default_cubemap_image_view; }
+    inline VkPhysicalDeviceRayTracingPipelinePropertiesKHR     ray_tracing_pipeline_properties() { return m_ray_tracing_pipeline_properties; }
+    inline VkPhysicalDeviceAccelerationStructurePropertiesKHR  acceleration_structure_properties() { return m_acceleration_structure_properties; }
+    inline VkFormat                                            swap_chain_image_format() { return m_swap_chain_image_format; }
+    inline VkFormat                                            swap_chain_depth_format() { return m_swap_chain_depth_format; }
+    inline VkExtent2D                                          swap_chain_extents() { return m_swap_chain_extent; }
+    inline uint32_t                                            current_frame_idx() { return m_current_frame; }
+    inline const VkPhysicalDeviceProperties&                   device_properties() { return m_device_properties; }
+    inline const VkPhysicalDeviceFeatures&                     device_features() { return m_device_features; }
+    inline const VkPhysicalDeviceVulkan12Features&             device_features12() { return m_device_features12; }
+    inline const VkPhysicalDeviceDescriptorIndexingProperties& descriptor_indexing_properties() { return m_descriptor_indexing_properties; }
+    inline bool                                                ray_tracing_enabled() { return m_ray_tracing_enabled; }
+    inline uint32_t                                            swapchain_size() { return m_swap_chain_images.size(); }
+    inline const QueueInfos&                                   queue_infos() { return m_selected_queues; }
+    inline std::shared_ptr<Sampler>                            bilinear_sampler() { return m_bilinear_sampler; }
+    inline std::shared_ptr<Sampler>                            trilinear_sampler() { return m_trilinear_sampler; }
+    inline std::shared_ptr<Sampler>                            nearest_sampler() { return m_nearest_sampler; }
+    inline std::shared_ptr<ImageView>                          default_cubemap() { return m_default_cubemap_image_view; }
 
 private:
     Backend(GLFWwindow* window, bool vsync, bool srgb_swapchain, bool enable_validation_layers, bool require_ray_tracing, std::vector<const char*> additional_device_extensions);
@@ -201,6 +211,9 @@ private:
     std::shared_ptr<Image>                                   m_swap_chain_depth      = nullptr;
     std::shared_ptr<ImageView>                               m_swap_chain_depth_view = nullptr;
     VkPhysicalDeviceProperties                               m_device_properties;
+    VkPhysicalDeviceFeatures                                 m_device_features;
+    VkPhysicalDeviceVulkan12Features                         m_device_features12;
+    VkPhysicalDeviceDescriptorIndexingProperties             m_descriptor_indexing_properties;
     bool                                                     m_ray_tracing_enabled = false;
     bool                                                     m_vsync               = false;
     bool                                                     m_srgb_swapchain      = false;
@@ -253,23 +266,25 @@ private:
     Image(Backend::Ptr backend, VkImage image, VkImageType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, VkFormat format, VmaMemoryUsage memory_usage, VkImageUsageFlags usage, VkSampleCountFlagBits sample_count);
 
 private:
-    uint32_t              m_width;
-    uint32_t              m_height;
-    uint32_t              m_depth;
-    uint32_t              m_mip_levels;
-    uint32_t              m_array_size;
-    VkFormat              m_format;
-    VkImageUsageFlags     m_usage;
-    VmaMemoryUsage        m_memory_usage;
-    VkSampleCountFlagBits m_sample_count;
-    VkImageType           m_type;
-    VkImageCreateFlags    m_flags = 0;
-    VkImageTiling         m_tiling;
-    VkImage               m_vk_image         = nullptr;
-    VkDeviceMemory        m_vk_device_memory = nullptr;
-    VmaAllocator_T*       m_vma_allocator    = nullptr;
-    VmaAllocation_T*      m_vma_allocation   = nullptr;
-    void*                 m_mapped_ptr       = nullptr;
+    uint32_t                 m_width;
+    uint32_t                 m_height;
+    uint32_t                 m_depth;
+    uint32_t                 m_mip_levels;
+    uint32_t                 m_array_size;
+    VkFormat                 m_format;
+    VkImageUsageFlags        m_usage;
+    VmaMemoryUsage           m_memory_usage;
+    VkSampleCountFlagBits    m_sample_count;
+    VkImageType              m_type;
+    VkImageCreateFlags       m_flags = 0;
+    VkImageTiling            m_tiling;
+    VkImage                  m_vk_image         = nullptr;
+    VkDeviceMemory           m_vk_device_memory = nullptr;
+    VmaAllocator_T*          m_vma_allocator    = nullptr;
+    VmaAllocation_T*         m_vma_allocation   = nullptr;
+    void*                    m_mapped_ptr       = nullptr;
+    uint64_t                 m_memory_size      = 0;
+    profiler::MemoryCategory m_memory_category;
 };
 
 class ImageView : public Object
@@ -354,16 +369,18 @@ private:
     Buffer(Backend::Ptr backend, VkBufferUsageFlags usage, size_t size, size_t alignment, VmaMemoryUsage memory_usage, VkFlags create_flags, void* data);
 
 private:
-    size_t                m_size;
-    void*                 m_mapped_ptr       = nullptr;
-    VkBuffer              m_vk_buffer        = nullptr;
-    VkDeviceMemory        m_vk_device_memory = nullptr;
-    VkDeviceAddress       m_device_address   = 0;
-    VmaAllocator_T*       m_vma_allocator    = nullptr;
-    VmaAllocation_T*      m_vma_allocation   = nullptr;
-    VmaMemoryUsage        m_vma_memory_usage;
-    VkMemoryPropertyFlags m_vk_memory_property;
-    VkBufferUsageFlags    m_vk_usage_flags;
+    size_t                   m_size;
+    void*                    m_mapped_ptr       = nullptr;
+    VkBuffer                 m_vk_buffer        = nullptr;
+    VkDeviceMemory           m_vk_device_memory = nullptr;
+    VkDeviceAddress          m_device_address   = 0;
+    VmaAllocator_T*          m_vma_allocator    = nullptr;
+    VmaAllocation_T*         m_vma_allocation   = nullptr;
+    VmaMemoryUsage           m_vma_memory_usage;
+    VkMemoryPropertyFlags    m_vk_memory_property;
+    VkBufferUsageFlags       m_vk_usage_flags;
+    uint64_t                 m_memory_size      = 0;
+    profiler::MemoryCategory m_memory_category;
 };
 
 class CommandPool : public Object
@@ -838,9 +855,11 @@ public:
     {
         std::vector<VkDescriptorSetLayoutBinding> bindings;
         VkSampler                                 binding_samplers[32][8];
-        void*                                     pnext_ptr = nullptr;
+        void*                                     pnext_ptr    = nullptr;
+        VkDescriptorSetLayoutCreateFlags          create_flags = 0;
 
         Desc& set_next_ptr(void* pnext);
+        Desc& set_create_flags(VkDescriptorSetLayoutCreateFlags flags);
         Desc& add_binding(uint32_t binding, VkDescriptorType descriptor_type, uint32_t descriptor_count, VkShaderStageFlags stage_flags);
         Desc& add_binding(uint32_t binding, VkDescriptorType descriptor_type, uint32_t descriptor_count, VkShaderStageFlags stage_flags, Sampler::Ptr samplers[]);
     };
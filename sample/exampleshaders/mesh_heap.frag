@@ -0,0 +1,40 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define MATERIAL_HEAP_SET 1
+#include <material_heap.glsl>
+
+layout (location = 0) in vec3 FS_IN_FragPos;
+layout (location = 1) in vec2 FS_IN_Texcoord;
+layout (location = 2) in vec3 FS_IN_Normal;
+
+layout (location = 0) out vec3 FS_OUT_Color;
+
+layout (push_constant) uniform PushConstants
+{
+    int material_index;
+} u_PushConstants;
+
+void main()
+{
+    MaterialData material = materials[u_PushConstants.material_index];
+
+    vec3 light_pos = vec3(-200.0, 200.0, 0.0);
+
+	vec3 n = normalize(FS_IN_Normal);
+	vec3 l = normalize(light_pos - FS_IN_FragPos);
+
+	float lambert = max(0.0f, dot(n, l));
+
+    vec3 diffuse = material_albedo(material, FS_IN_Texcoord).xyz;
+	vec3 ambient = diffuse * 0.03;
+
+	vec3 color = diffuse * lambert + ambient;
+
+	// HDR tonemapping
+    color = color / (color + vec3(1.0));
+    // gamma correct
+    color = pow(color, vec3(1.0 / 2.2));
+
+    FS_OUT_Color = color;
+}
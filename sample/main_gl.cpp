@@ -255,6 +255,8 @@ private:
             // Issue draw call.
             glDrawElementsBaseVertex(
                 GL_TRIANGLES, submesh.index_count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * submesh.base_index), submesh.base_vertex);
+            dw::profiler::increment(dw::profiler::COUNTER_DRAW_CALLS);
+            dw::profiler::increment(dw::profiler::COUNTER_INDICES, submesh.index_count);
         }
     }
 
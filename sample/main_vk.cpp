@@ -181,12 +181,21 @@ private:
 
     void create_pipeline_state()
     {
+        // Index the material heap with a push constant if every material got a slot in it, otherwise bind a descriptor set per material.
+        m_use_material_heap = dw::Material::heap_descriptor_set_layout() != nullptr;
+
+        for (auto& mat : m_mesh->materials())
+        {
+            if (mat->heap_index() == -1)
+                m_use_material_heap = false;
+        }
+
         // ---------------------------------------------------------------------------
         // Create shader modules
         // ---------------------------------------------------------------------------
 
         dw::vk::ShaderModule::Ptr vs = dw::vk::ShaderModule::create_from_file(m_vk_backend, "shaders/mesh.vert.spv");
-        dw::vk::ShaderModule::Ptr fs = dw::vk::ShaderModule::create_from_file(m_vk_backend, "shaders/mesh.frag.spv");
+        dw::vk::ShaderModule::Ptr fs = dw::vk::ShaderModule::create_from_file(m_vk_backend, m_use_material_heap ? "shaders/mesh_heap.frag.spv" : "shaders/mesh.frag.spv");
 
         dw::vk::GraphicsPipeline::Desc pso_desc;
 
@@ -286,8 +295,15 @@ private:
 
         dw::vk::PipelineLayout::Desc pl_desc;
 
-        pl_desc.add_descriptor_set_layout(m_per_frame_ds_layout)
-            .add_descriptor_set_layout(dw::Material::descriptor_set_layout());
+        pl_desc.add_descriptor_set_layout(m_per_frame_ds_layout);
+
+        if (m_use_material_heap)
+        {
+            pl_desc.add_descriptor_set_layout(dw::Material::heap_descriptor_set_layout())
+                .add_push_constant_range(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int32_t));
+        }
+        else
+            pl_desc.add_descriptor_set_layout(dw::Material::descriptor_set_layout());
 
         m_pipeline_layout = dw::vk::PipelineLayout::create(m_vk_backend, pl_desc);
 
@@ -352,7 +368,7 @@ private:
         info.clearValueCount          = 2;
         info.pClearValues             = &clear_values[0];
 
-        vkCmdBeginRenderPass(cmd_buf->handle(), &info, VK_SUBPASS_CONTENTS_INLINE);
+        dw::profiler::begin_render_pass(cmd_buf, info, VK_SUBPASS_CONTENTS_INLINE);
 
         vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_pso->handle());
 
@@ -384,6 +400,9 @@ private:
         vkCmdBindVertexBuffers(cmd_buf->handle(), 0, 1, &m_mesh->vertex_buffer()->handle(), &offset);
         vkCmdBindIndexBuffer(cmd_buf->handle(), m_mesh->index_buffer()->handle(), 0, VK_INDEX_TYPE_UINT32);
 
+        if (m_use_material_heap)
+            vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout->handle(), 1, 1, &dw::Material::heap_descriptor_set()->handle(), 0, nullptr);
+
         const auto& submeshes = m_mesh->sub_meshes();
 
         for (uint32_t i = 0; i < submeshes.size(); i++)
@@ -391,15 +410,23 @@ private:
             auto& submesh = submeshes[i];
             auto& mat     = m_mesh->material(submesh.mat_idx);
 
-            vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout->handle(), 1, 1, &mat->descriptor_set()->handle(), 0, nullptr);
+            if (m_use_material_heap)
+            {
+                int32_t material_index = mat->heap_index();
+                vkCmdPushConstants(cmd_buf->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int32_t), &material_index);
+            }
+            else
+                vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout->handle(), 1, 1, &mat->descriptor_set()->handle(), 0, nullptr);
 
             // Issue draw call.
             vkCmdDrawIndexed(cmd_buf->handle(), submesh.index_count, 1, submesh.base_index, submesh.base_vertex, 0);
+            dw::profiler::increment(dw::profiler::COUNTER_DRAW_CALLS);
+            dw::profiler::increment(dw::profiler::COUNTER_INDICES, submesh.index_count);
         }
 
         render_gui(cmd_buf);
 
-        vkCmdEndRenderPass(cmd_buf->handle());
+        dw::profiler::end_render_pass(cmd_buf);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -429,6 +456,7 @@ private:
     dw::vk::DescriptorSetLayout::Ptr m_per_frame_ds_layout;
     dw::vk::DescriptorSet::Ptr       m_per_frame_ds;
     dw::vk::Buffer::Ptr              m_ubo;
+    bool                             m_use_material_heap = false;
 
     // Camera.
     std::unique_ptr<dw::Camera> m_main_camera;
@@ -31,6 +31,13 @@ protected:
         if (!create_uniform_buffer())
             return false;
 
+        // Materials are read from the material heap, which needs descriptor indexing.
+        if (!dw::Material::heap_descriptor_set_layout())
+        {
+            DW_LOG_FATAL("Material heap unavailable");
+            return false;
+        }
+
         // Load mesh.
         if (!load_mesh())
             return false;
@@ -291,6 +298,7 @@ private:
 
         pl_desc.add_descriptor_set_layout(m_scene->descriptor_set_layout());
         pl_desc.add_descriptor_set_layout(m_ray_tracing_layout);
+        pl_desc.add_descriptor_set_layout(dw::Material::heap_descriptor_set_layout());
 
         m_raytracing_pipeline_layout = dw::vk::PipelineLayout::create(m_vk_backend, pl_desc);
 
@@ -349,9 +357,10 @@ private:
         VkDescriptorSet descriptor_sets[] = {
             m_scene->descriptor_set()->handle(),
             m_ray_tracing_ds->handle(),
+            dw::Material::heap_descriptor_set()->handle()
         };
 
-        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_raytracing_pipeline_layout->handle(), 0, 2, descriptor_sets, 1, &dynamic_offset);
+        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_raytracing_pipeline_layout->handle(), 0, 3, descriptor_sets, 1, &dynamic_offset);
 
         VkDeviceSize group_size   = dw::vk::utilities::aligned_size(rt_pipeline_props.shaderGroupHandleSize, rt_pipeline_props.shaderGroupBaseAlignment);
         VkDeviceSize group_stride = group_size;
@@ -399,7 +408,7 @@ private:
         info.clearValueCount          = 2;
         info.pClearValues             = &clear_values[0];
 
-        vkCmdBeginRenderPass(cmd_buf->handle(), &info, VK_SUBPASS_CONTENTS_INLINE);
+        dw::profiler::begin_render_pass(cmd_buf, info, VK_SUBPASS_CONTENTS_INLINE);
 
         VkViewport vp;
 
@@ -425,12 +434,14 @@ private:
         vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_copy_pipeline_layout->handle(), 0, 1, &m_copy_ds->handle(), 0, nullptr);
 
         vkCmdDraw(cmd_buf->handle(), 3, 1, 0, 0);
+        dw::profiler::increment(dw::profiler::COUNTER_DRAW_CALLS);
+        dw::profiler::increment(dw::profiler::COUNTER_INDICES, 3);
 
 #if defined(DWSF_IMGUI)
         render_gui(cmd_buf);
 #endif
 
-        vkCmdEndRenderPass(cmd_buf->handle());
+        dw::profiler::end_render_pass(cmd_buf);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
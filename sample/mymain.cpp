@@ -5,6 +5,9 @@
 #include <ogl.h>
 #include <profiler.h>
 #include <assimp/scene.h>
+#if !defined(__EMSCRIPTEN__)
+#    include <material_table.h>
+#endif
 
 // Uniform buffer data structure.
 struct Transforms
@@ -27,6 +30,10 @@ protected:
         // Set initial GPU states.
         set_initial_states();
         std::cout << "set initial state" << std::endl;
+        // Load mesh.
+        if (!load_mesh())
+            return false;
+        std::cout << "mesh loaded" << std::endl;
         // Create GPU resources.
         if (!create_shaders())
             return false;
@@ -34,10 +41,6 @@ protected:
         if (!create_uniform_buffer())
             return false;
         std::cout << "uniform created" << std::endl;
-        // Load mesh.
-        if (!load_mesh())
-            return false;
-        std::cout << "mesh loaded" << std::endl;
 
         // Create camera.
         create_camera();
@@ -69,6 +72,9 @@ protected:
     void shutdown() override
     {
         // Unload assets.
+#if !defined(__EMSCRIPTEN__)
+        m_material_table.reset();
+#endif
         m_mesh.reset();
     }
 
@@ -102,8 +108,24 @@ private:
     bool create_shaders()
     {
         // Create shaders
-        m_vs = dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, std::string("../sample/shaders/test.vert"));
-        m_fs = dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, std::string("../sample/shaders/test.frag"));
+#if !defined(__EMSCRIPTEN__)
+        // Look up materials in a table indexed per vertex instead of binding the textures of every submesh.
+        if (m_use_material_table)
+        {
+            std::vector<std::string> defines;
+
+            if (m_material_table->bindless())
+                defines.push_back("MATERIAL_TABLE_BINDLESS");
+
+            m_vs = dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, std::string("../sample/shaders/material_table.vert"));
+            m_fs = dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, std::string("../sample/shaders/material_table.frag"), defines);
+        }
+        else
+#endif
+        {
+            m_vs = dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, std::string("../sample/shaders/test.vert"));
+            m_fs = dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, std::string("../sample/shaders/test.frag"));
+        }
 
         if (!m_vs || !m_fs)
         {
@@ -148,7 +170,20 @@ private:
     bool load_mesh()
     {
         m_mesh = dw::Mesh::load("../data/sample_assets/teapot.obj");
-        return m_mesh != nullptr;
+
+        if (!m_mesh)
+            return false;
+
+#if !defined(__EMSCRIPTEN__)
+        // Shader storage buffers need OpenGL 4.3.
+        if (GLAD_GL_VERSION_4_3)
+        {
+            m_material_table     = dw::MaterialTable::create({ m_mesh });
+            m_use_material_table = true;
+        }
+#endif
+
+        return true;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -182,8 +217,19 @@ private:
         // Bind vertex array.
         m_mesh->mesh_vertex_array()->bind();
 
-        // Set active texture unit uniform
-        m_program->set_uniform("s_Diffuse", 0);
+#if !defined(__EMSCRIPTEN__)
+        if (m_use_material_table)
+        {
+            // Bind material table, submeshes pick their material through the vertex position's w.
+            m_material_table->bind(m_program, 0);
+            m_program->set_uniform("u_MaterialBaseIndex", m_material_table->base_index(m_mesh->id()));
+        }
+        else
+#endif
+        {
+            // Set active texture unit uniform
+            m_program->set_uniform("s_Diffuse", 0);
+        }
 
         const auto& submeshes = m_mesh->sub_meshes();
 
@@ -193,12 +239,14 @@ private:
             auto& mat     = m_mesh->material(submesh.mat_idx);
 
             // Bind texture.
-            if (mat->albedo_texture())
+            if (!m_use_material_table && mat->albedo_texture())
                 mat->albedo_texture()->bind(0);
 
             // Issue draw call.
             glDrawElementsBaseVertex(
                 GL_TRIANGLES, submesh.index_count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * submesh.base_index), submesh.base_vertex);
+            dw::profiler::increment(dw::profiler::COUNTER_DRAW_CALLS);
+            dw::profiler::increment(dw::profiler::COUNTER_INDICES, submesh.index_count);
         }
     }
 
@@ -234,6 +282,10 @@ private:
 
     // Assets.
     dw::Mesh::Ptr m_mesh;
+#if !defined(__EMSCRIPTEN__)
+    dw::MaterialTable::Ptr m_material_table;
+#endif
+    bool m_use_material_table = false;
 
     // Uniforms.
     Transforms m_transforms;
@@ -9,7 +9,11 @@
 #    include <backends/imgui_impl_opengl3.h>
 #endif
 #include <profiler.h>
+#include <jobs.h>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #if defined(__EMSCRIPTEN__)
 #    include <emscripten/emscripten.h>
@@ -18,6 +22,8 @@
 #include "material.h"
 #include "mesh.h"
 #include "utility.h"
+#include "camera.h"
+#include "demo_player.h"
 
 namespace dw
 {
@@ -27,7 +33,7 @@ namespace dw
 
 static void APIENTRY glDebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* user_param)
 {
-    std::string msg_source;
+    const char* msg_source = "";
 
     switch (source)
     {
@@ -48,7 +54,7 @@ static void APIENTRY glDebugCallback(GLenum source, GLenum type, GLuint id, GLen
             break;
     }
 
-    std::string msg_type;
+    const char* msg_type = "";
 
     switch (type)
     {
@@ -72,7 +78,7 @@ static void APIENTRY glDebugCallback(GLenum source, GLenum type, GLuint id, GLen
             break;
     }
 
-    std::string msg_severity = "DEFAULT";
+    const char* msg_severity = "DEFAULT";
 
     switch (severity)
     {
@@ -87,12 +93,10 @@ static void APIENTRY glDebugCallback(GLenum source, GLenum type, GLuint id, GLen
             break;
     }
 
-    std::string log_msg = "glDebugMessage: " + std::string(message) + ", type = " + msg_type + ", source = " + msg_source + ", severity = " + msg_severity;
-
     if (type == GL_DEBUG_TYPE_ERROR)
-        DW_LOG_ERROR(log_msg);
+        DW_LOG_ERROR("glDebugMessage: {}, type = {}, source = {}, severity = {}", message, msg_type, msg_source, msg_severity);
     else
-        DW_LOG_WARNING(log_msg);
+        DW_LOG_WARNING("glDebugMessage: {}, type = {}, source = {}, severity = {}", message, msg_type, msg_source, msg_severity);
 }
 
 #endif
@@ -107,6 +111,50 @@ void Application::run_frame(void* arg)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+// Statistics over frame times in milliseconds, frames longer than late_threshold count as late.
+static FramePacingStats frame_time_statistics(const float* times, uint32_t count, double late_threshold)
+{
+    FramePacingStats stats = {};
+
+    stats.frames = count;
+
+    if (count == 0)
+        return stats;
+
+    std::vector<float> sorted(times, times + count);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        sum += sorted[i];
+
+        if (late_threshold > 0.0 && sorted[i] > late_threshold)
+            stats.late++;
+    }
+
+    stats.mean = sum / double(count);
+
+    double variance = 0.0;
+
+    for (uint32_t i = 0; i < count; i++)
+        variance += (sorted[i] - stats.mean) * (sorted[i] - stats.mean);
+
+    auto percentile = [&](double p) { return sorted[std::min(uint32_t(double(count) * p), count - 1)]; };
+
+    stats.std_dev = std::sqrt(variance / double(count));
+    stats.min     = sorted[0];
+    stats.max     = sorted[count - 1];
+    stats.p50     = percentile(0.50);
+    stats.p95     = percentile(0.95);
+    stats.p99     = percentile(0.99);
+
+    return stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 Application::Application() :
     m_mouse_x(0.0), m_mouse_y(0.0), m_last_mouse_x(0.0), m_last_mouse_y(0.0),
     m_mouse_delta_x(0.0), m_mouse_delta_y(0.0), m_delta(0.0),
@@ -149,6 +197,22 @@ void Application::update(double delta) {}
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void Application::simulate(double dt) {}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::unique_ptr<RenderPacket> Application::create_render_packet() { return std::make_unique<RenderPacket>(); }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::prepare(RenderPacket& packet) {}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::render(const RenderPacket& packet) {}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void Application::shutdown() {}
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -158,11 +222,15 @@ bool Application::init_base(int argc, const char* argv[])
     logger::initialize();
     logger::open_console_stream();
     logger::open_file_stream();
+    logger::install_crash_handler();
+
+    jobs::initialize();
 
     // Defaults
     AppSettings settings = intial_app_settings();
 
     load_initial_settings_from_file(settings);
+    parse_command_line(argc, argv, settings);
 
     bool maximized  = settings.maximized;
     bool fullscreen = settings.fullscreen;
@@ -170,6 +238,26 @@ bool Application::init_base(int argc, const char* argv[])
     m_width         = settings.width;
     m_height        = settings.height;
     m_title         = settings.title;
+
+    set_target_fps(settings.max_fps);
+    set_low_latency(settings.low_latency);
+    set_fixed_timestep(settings.fixed_timestep, settings.max_simulation_steps);
+
+    m_pipelined = settings.pipelined;
+
+    m_headless         = settings.headless;
+    m_benchmark        = settings.benchmark;
+    m_benchmark_frames = settings.benchmark_frames;
+    m_benchmark_warmup = settings.benchmark_warmup;
+    m_benchmark_report = settings.benchmark_report;
+
+    if (m_headless)
+    {
+        maximized  = false;
+        fullscreen = false;
+        m_vsync    = false;
+    }
+
     std::cout << m_width << std::endl;
     std::cout << m_height << std::endl;
     std::cout << m_title << std::endl;
@@ -186,7 +274,22 @@ bool Application::init_base(int argc, const char* argv[])
     const char* imgui_glsl_version = "#version 150";
 #endif
 
-    if (glfwInit() != GLFW_TRUE)
+    bool initialized = glfwInit() == GLFW_TRUE;
+
+#if defined(GLFW_PLATFORM_NULL) && !defined(DWSF_VULKAN)
+    // Without a display, fall back to GLFW's null platform with a Mesa OSMesa (llvmpipe) context.
+    if (!initialized && m_headless)
+    {
+        DW_LOG_WARNING("No display available, using the null platform for headless rendering.");
+
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+
+        initialized = glfwInit() == GLFW_TRUE;
+    }
+#endif
+
+    if (!initialized)
     {
         DW_LOG_FATAL("Failed to initialize GLFW");
         return false;
@@ -212,6 +315,7 @@ bool Application::init_base(int argc, const char* argv[])
 #endif
     glfwWindowHint(GLFW_RESIZABLE, false);
     glfwWindowHint(GLFW_MAXIMIZED, maximized);
+    glfwWindowHint(GLFW_VISIBLE, !m_headless);
    std::cout << "test1";
     m_window = glfwCreateWindow(m_width, m_height, m_title.c_str(), fullscreen ? glfwGetPrimaryMonitor() : nullptr, nullptr);
     //m_window = glfwCreateWindow(m_width, m_height, m_title.c_str(),nullptr, nullptr);
@@ -315,8 +419,11 @@ bool Application::init_base(int argc, const char* argv[])
 
     GLFWmonitor* primary = glfwGetPrimaryMonitor();
 
-    float xscale, yscale;
-    glfwGetMonitorContentScale(primary, &xscale, &yscale);
+    float xscale = 1.0f, yscale = 1.0f;
+
+    // Headless runs render at the requested size regardless of the monitor, which may not exist.
+    if (primary && !m_headless)
+        glfwGetMonitorContentScale(primary, &xscale, &yscale);
 
 #if defined(DWSF_IMGUI) && !defined(__APPLE__)
     ImGuiStyle* style = &ImGui::GetStyle();
@@ -348,6 +455,17 @@ bool Application::init_base(int argc, const char* argv[])
     if (!init(argc, argv))
         return false;
     std::cout <<"here" << std::endl;
+
+    if (m_benchmark)
+    {
+        DW_LOG_INFO("Benchmark: {} warmup frames, report will be written to {}", m_benchmark_warmup, m_benchmark_report);
+
+        if (m_benchmark_warmup == 0)
+            start_benchmark();
+    }
+
+    m_timer.start();
+
     return true;
 }
 
@@ -356,17 +474,111 @@ bool Application::init_base(int argc, const char* argv[])
 void Application::update_base(double delta)
 {
     begin_frame();
-    update(delta);
+
+    if (m_pipelined)
+        update_pipelined(delta);
+    else
+    {
+        update_simulation(delta);
+        update(delta);
+    }
+
     end_frame();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+double Application::update_simulation(double delta)
+{
+    if (m_benchmark && m_benchmark_demo && m_benchmark_demo->is_playing())
+        m_benchmark_demo->update(float(delta), m_benchmark_camera);
+
+    double alpha = 0.0;
+
+    m_simulation_steps = 0;
+
+    if (m_fixed_timestep > 0.0)
+    {
+        DW_SCOPED_STOPWATCH("simulate");
+
+        m_simulation_time += delta;
+
+        while (m_simulation_time >= m_fixed_timestep && m_simulation_steps < m_max_simulation_steps)
+        {
+            simulate(m_fixed_timestep);
+
+            m_simulation_time -= m_fixed_timestep;
+            m_simulation_steps++;
+        }
+
+        // Fell too far behind, drop whole steps and keep the phase.
+        if (m_simulation_time >= m_fixed_timestep)
+            m_simulation_time = std::fmod(m_simulation_time, m_fixed_timestep);
+
+        alpha = m_simulation_time / m_fixed_timestep;
+    }
+
+    m_simulation_alpha = alpha;
+
+    return alpha;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::update_pipelined(double delta)
+{
+    // The first frame has nothing to render yet, so its packet is prepared up front. With a zero delta, the time of this frame
+    // is simulated once, by the packet of the next one.
+    if (!m_render_packets[0])
+    {
+        for (auto& packet : m_render_packets)
+            packet = create_render_packet();
+
+        prepare_render_packet(*m_render_packets[m_render_packet_idx], 0.0);
+    }
+
+    const RenderPacket& current = *m_render_packets[m_render_packet_idx];
+    RenderPacket&       next    = *m_render_packets[(m_render_packet_idx + 1) % PIPELINE_DEPTH];
+
+    // Input was polled in begin_frame() and the callbacks only run from there, so the next frame can read it while this one
+    // renders.
+    jobs::Counter counter;
+    jobs::run([this, &next, delta]() { prepare_render_packet(next, delta); }, &counter, "Prepare Frame");
+
+    {
+        DW_SCOPED_STOPWATCH("render");
+        render(current);
+    }
+
+    jobs::wait(counter);
+
+    m_render_packet_idx = (m_render_packet_idx + 1) % PIPELINE_DEPTH;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::prepare_render_packet(RenderPacket& packet, double delta)
+{
+    packet.frame = m_prepared_frames++;
+    packet.delta = delta;
+    packet.alpha = update_simulation(delta);
+
+    prepare(packet);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void Application::shutdown_base()
 {
     // Execute user-side shutdown method.
     shutdown();
 
+    // Finish outstanding jobs while everything they may use is still alive.
+    jobs::shutdown();
+
+    for (auto& packet : m_render_packets)
+        packet.reset();
+
 #if defined(DWSF_VULKAN)
     // Shutdown debug draw.
 
@@ -386,6 +598,10 @@ void Application::shutdown_base()
 
     m_vk_backend->~Backend();
 #else
+    // Release the frame fences while the context is still alive, their destructors would run after glfwTerminate().
+    for (auto& fence : m_frame_fences)
+        fence.wait();
+
     // Shutdown debug draw.
     m_debug_draw.shutdown();
 
@@ -406,6 +622,7 @@ void Application::shutdown_base()
     // Close logger streams.
     logger::close_file_stream();
     logger::close_console_stream();
+    logger::shutdown();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -437,10 +654,17 @@ void Application::submit_and_present(const std::vector<vk::CommandBuffer::Ptr>&
 
 void Application::begin_frame()
 {
-    m_timer.start();
+    // In low latency mode the wait happens before input is polled, and ends early enough for the predicted work to finish on
+    // the deadline.
+    if (m_frame_period != 0 && m_low_latency)
+        pace_frame(uint64_t(m_predicted_work));
+
+    m_work_start = Timer::now();
 
     glfwPollEvents();
 
+    jobs::run_main_thread_jobs();
+
 #if defined(DWSF_VULKAN)
     if (m_should_recreate_swap_chain)
     {
@@ -450,6 +674,8 @@ void Application::begin_frame()
 
     m_vk_backend->acquire_next_swap_chain_image(m_present_complete_semaphore);
 
+    Material::update_heap();
+
 #    if defined(DWSF_IMGUI)
     ImGui_ImplVulkan_NewFrame();
 #    endif
@@ -485,15 +711,337 @@ void Application::end_frame()
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 #    endif
     glfwSwapBuffers(m_window);
+
+    // The driver may queue up frames, which lets the pipeline run ahead further than the two packets. Waiting for the frame
+    // that last used this fence bounds it to PIPELINE_GL_FRAMES_IN_FLIGHT.
+    if (m_pipelined)
+    {
+        m_frame_fences[m_frame_fence_idx].insert();
+        m_frame_fence_idx = (m_frame_fence_idx + 1) % PIPELINE_GL_FRAMES_IN_FLIGHT;
+    }
 #endif
 
+    // Rise to a slower frame immediately, decay slowly back to faster ones.
+    double work      = double(Timer::now() - m_work_start);
+    m_predicted_work = work > m_predicted_work ? work : m_predicted_work * 0.95 + work * 0.05;
+
+    if (m_frame_period != 0 && !m_low_latency)
+        pace_frame(0);
+
+    // Measured from the end of the previous frame so that the delta includes any time spent waiting.
     m_timer.stop();
     m_delta         = m_timer.elapsed_time_milisec();
     m_delta_seconds = m_timer.elapsed_time_sec();
+    m_timer.start();
+
+    m_frame_times[m_frame_time_count % FRAME_PACING_HISTORY] = float(m_delta);
+    m_frame_time_count++;
+
+    if (m_benchmark)
+        benchmark_frame();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::benchmark_frame()
+{
+    // The recorded frame time is the measured one, the application always steps by the same amount.
+    if (m_benchmark_frame >= m_benchmark_warmup)
+        m_benchmark_times.push_back(float(m_delta));
+
+    m_delta         = BENCHMARK_FRAME_DELTA;
+    m_delta_seconds = BENCHMARK_FRAME_DELTA * 0.001;
+
+    m_benchmark_frame++;
+
+    if (m_benchmark_frame == m_benchmark_warmup)
+    {
+        start_benchmark();
+        return;
+    }
+
+    if (m_benchmark_frame < m_benchmark_warmup)
+        return;
+
+    bool done = false;
+
+    if (m_benchmark_demo)
+    {
+        m_benchmark_demo_time += m_delta_seconds;
+        done = m_benchmark_demo_time >= m_benchmark_demo->duration();
+    }
+    else
+        done = m_benchmark_times.size() >= m_benchmark_frames;
+
+    if (done)
+    {
+        if (m_benchmark_demo)
+            m_benchmark_demo->stop();
+
+        write_benchmark_report();
+
+        m_benchmark = false;
+        request_exit();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::start_benchmark()
+{
+    profiler::reset_statistics();
+
+    m_benchmark_start = Timer::now();
+    m_benchmark_times.reserve(m_benchmark_demo ? 4096 : m_benchmark_frames);
+
+    if (m_benchmark_demo)
+    {
+        m_benchmark_demo_time = 0.0;
+        m_benchmark_demo->play();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::write_benchmark_report()
+{
+    double           duration = double(Timer::now() - m_benchmark_start) * 1e-9;
+    FramePacingStats frames   = frame_time_statistics(m_benchmark_times.data(), uint32_t(m_benchmark_times.size()), 0.0);
+
+    std::vector<std::string> scopes;
+    profiler::scopes(scopes);
+
+#if defined(DWSF_VULKAN)
+    std::string device = m_vk_backend->device_properties().deviceName;
+#else
+    std::string device = (const char*)glGetString(GL_RENDERER);
+#endif
+
+    std::ofstream f(m_benchmark_report);
+
+    if (!f.is_open())
+    {
+        DW_LOG_ERROR("Failed to open benchmark report {}", m_benchmark_report);
+        return;
+    }
+
+    bool csv = m_benchmark_report.size() >= 4 && m_benchmark_report.compare(m_benchmark_report.size() - 4, 4, ".csv") == 0;
+
+    if (csv)
+    {
+        f << "scope,source,frames,mean,std_dev,min,max,p50,p95,p99\n";
+        f << "frame,total," << frames.frames << "," << frames.mean << "," << frames.std_dev << "," << frames.min << "," << frames.max << "," << frames.p50 << "," << frames.p95 << "," << frames.p99 << "\n";
+
+        for (const auto& name : scopes)
+        {
+            const char* source_names[] = { "cpu", "gpu" };
+
+            for (uint32_t source = 0; source < 2; source++)
+            {
+                profiler::Statistics stats;
+
+                if (!profiler::statistics(name, profiler::TimeSource(source), stats))
+                    continue;
+
+                f << "\"" << name << "\"," << source_names[source] << "," << stats.frames << "," << stats.mean << "," << stats.std_dev << "," << stats.min << "," << stats.max << "," << stats.p50 << "," << stats.p95 << "," << stats.p99 << "\n";
+            }
+        }
+    }
+    else
+    {
+        nlohmann::json j;
+
+        j["title"]        = m_title;
+        j["device"]       = device;
+        j["width"]        = m_width;
+        j["height"]       = m_height;
+        j["headless"]     = m_headless;
+        j["duration_sec"] = duration;
+        j["frame_time_ms"] = { { "frames", frames.frames },
+                               { "mean", frames.mean },
+                               { "std_dev", frames.std_dev },
+                               { "min", frames.min },
+                               { "max", frames.max },
+                               { "p50", frames.p50 },
+                               { "p95", frames.p95 },
+                               { "p99", frames.p99 } };
+        j["frame_times"]   = m_benchmark_times;
+
+        nlohmann::json scopes_json = nlohmann::json::array();
+
+        for (const auto& name : scopes)
+        {
+            nlohmann::json scope;
+            scope["name"] = name;
+
+            const char* source_names[] = { "cpu_ms", "gpu_ms" };
+
+            for (uint32_t source = 0; source < 2; source++)
+            {
+                profiler::Statistics stats;
+
+                if (!profiler::statistics(name, profiler::TimeSource(source), stats))
+                    continue;
+
+                scope[source_names[source]] = { { "frames", stats.frames },
+                                                { "spikes", stats.spikes },
+                                                { "mean", stats.mean },
+                                                { "std_dev", stats.std_dev },
+                                                { "min", stats.min },
+                                                { "max", stats.max },
+                                                { "p50", stats.p50 },
+                                                { "p95", stats.p95 },
+                                                { "p99", stats.p99 } };
+            }
+
+            scopes_json.push_back(scope);
+        }
+
+        j["scopes"] = scopes_json;
+
+        nlohmann::json counters;
+
+        for (uint32_t i = 0; i < profiler::COUNTER_COUNT; i++)
+            counters[profiler::counter_name(profiler::Counter(i))] = profiler::counter(profiler::Counter(i));
+
+        j["counters"] = counters;
+
+        f << j.dump(4);
+    }
+
+    DW_LOG_INFO("Benchmark: {} frames on {} in {:.2f} s, mean {:.3f} ms, p99 {:.3f} ms, written to {}", frames.frames, device, duration, frames.mean, frames.p99, m_benchmark_report);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::set_benchmark_demo(DemoPlayer* demo, Camera* camera)
+{
+    m_benchmark_demo   = demo;
+    m_benchmark_camera = camera;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Application::benchmarking() const
+{
+    return m_benchmark;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::pace_frame(uint64_t lead_time)
+{
+#if !defined(__EMSCRIPTEN__)
+    uint64_t now = Timer::now();
+
+    m_frame_deadline += m_frame_period;
+
+    // Restart the cadence after a hitch instead of rushing through frames to catch up.
+    if (m_frame_deadline + m_frame_period < now)
+        m_frame_deadline = now;
+
+    if (m_frame_deadline > lead_time)
+        Timer::sleep_until(m_frame_deadline - lead_time);
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::set_target_fps(double fps)
+{
+    m_frame_period   = fps > 0.0 ? uint64_t(1000000000.0 / fps) : 0;
+    m_frame_deadline = Timer::now();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+double Application::target_fps() const
+{
+    return m_frame_period != 0 ? 1000000000.0 / double(m_frame_period) : 0.0;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void Application::set_fixed_timestep(double timestep, uint32_t max_steps)
+{
+    m_fixed_timestep       = std::max(timestep, 0.0);
+    m_max_simulation_steps = std::max(max_steps, 1u);
+    m_simulation_time      = 0.0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+double Application::fixed_timestep() const
+{
+    return m_fixed_timestep;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t Application::simulation_steps() const
+{
+    return m_simulation_steps;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+double Application::simulation_alpha() const
+{
+    return m_simulation_alpha;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::set_low_latency(bool enabled)
+{
+    m_low_latency = enabled;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Application::low_latency() const
+{
+    return m_low_latency;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+FramePacingStats Application::frame_pacing_stats() const
+{
+    uint32_t frames = std::min(m_frame_time_count, uint32_t(FRAME_PACING_HISTORY));
+
+    return frame_time_statistics(m_frame_times.data(), frames, m_frame_period != 0 ? double(m_frame_period) * 1.1e-6 : 0.0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_IMGUI)
+void Application::frame_pacing_ui()
+{
+    float fps = float(target_fps());
+
+    if (ImGui::SliderFloat("Frame Rate Limit", &fps, 0.0f, 240.0f, fps > 0.0f ? "%.0f FPS" : "Off"))
+        set_target_fps(fps);
+
+    ImGui::Checkbox("Low Latency", &m_low_latency);
+
+    FramePacingStats stats = frame_pacing_stats();
+
+    ImGui::Text("Mean: %.2f ms, Std Dev: %.2f ms", stats.mean, stats.std_dev);
+    ImGui::Text("Min: %.2f ms, Max: %.2f ms, 99th: %.2f ms", stats.min, stats.max, stats.p99);
+
+    if (m_frame_period != 0)
+        ImGui::Text("Late Frames: %u / %u", stats.late, stats.frames);
+
+    // Oldest to newest.
+    int offset = m_frame_time_count < FRAME_PACING_HISTORY ? 0 : int(m_frame_time_count % FRAME_PACING_HISTORY);
+
+    ImGui::PlotLines("Frame Times", m_frame_times.data(), int(stats.frames), offset, nullptr, 0.0f, float(stats.max) * 1.25f, ImVec2(0.0f, 60.0f));
+}
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void Application::request_exit() const
 {
     glfwSetWindowShouldClose(m_window, true);
@@ -536,6 +1084,60 @@ void Application::load_initial_settings_from_file(AppSettings& settings)
 
     if (j.find("vsync") != j.end())
         settings.vsync = j["vsync"];
+
+    if (j.find("max_fps") != j.end())
+        settings.max_fps = j["max_fps"];
+
+    if (j.find("low_latency") != j.end())
+        settings.low_latency = j["low_latency"];
+
+    if (j.find("fixed_timestep") != j.end())
+        settings.fixed_timestep = j["fixed_timestep"];
+
+    if (j.find("max_simulation_steps") != j.end())
+        settings.max_simulation_steps = j["max_simulation_steps"];
+
+    if (j.find("pipelined") != j.end())
+        settings.pipelined = j["pipelined"];
+
+    if (j.find("headless") != j.end())
+        settings.headless = j["headless"];
+
+    if (j.find("benchmark") != j.end())
+        settings.benchmark = j["benchmark"];
+
+    if (j.find("benchmark_frames") != j.end())
+        settings.benchmark_frames = j["benchmark_frames"];
+
+    if (j.find("benchmark_warmup") != j.end())
+        settings.benchmark_warmup = j["benchmark_warmup"];
+
+    if (j.find("benchmark_report") != j.end())
+        settings.benchmark_report = j["benchmark_report"];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::parse_command_line(int argc, const char* argv[], AppSettings& settings)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--headless") == 0)
+            settings.headless = true;
+        else if (strcmp(arg, "--benchmark") == 0)
+            settings.benchmark = true;
+        else if (strncmp(arg, "--benchmark-frames=", 19) == 0)
+        {
+            settings.benchmark        = true;
+            settings.benchmark_frames = uint32_t(std::max(1, atoi(arg + 19)));
+        }
+        else if (strncmp(arg, "--benchmark-warmup=", 19) == 0)
+            settings.benchmark_warmup = uint32_t(std::max(0, atoi(arg + 19)));
+        else if (strncmp(arg, "--benchmark-report=", 19) == 0)
+            settings.benchmark_report = arg + 19;
+    }
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
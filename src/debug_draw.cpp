@@ -1,5 +1,6 @@
 #include <debug_draw.h>
 #include <logger.h>
+#include <profiler.h>
 #include <utility.h>
 #if defined(DWSF_VULKAN)
 #    include <vk_mem_alloc.h>
@@ -952,6 +953,8 @@ bool DebugDraw::init(
 #endif
 )
 {
+    profiler::ScopedMemoryCategory memory_category(profiler::MEMORY_CATEGORY_DEBUG_DRAW);
+
 #if defined(DWSF_VULKAN)
     create_uniform_buffer(backend);
     create_vertex_buffer(backend);
@@ -1545,6 +1548,7 @@ void DebugDraw::render(vk::Backend::Ptr backend, vk::CommandBuffer::Ptr cmd_buff
             }
 
             vkCmdBindPipeline(cmd_buffer->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            profiler::increment(profiler::COUNTER_PIPELINE_BINDS);
 
             glm::vec4 params[2];
 
@@ -1554,6 +1558,8 @@ void DebugDraw::render(vk::Backend::Ptr backend, vk::CommandBuffer::Ptr cmd_buff
             vkCmdPushConstants(cmd_buffer->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(params), &params);
 
             vkCmdDraw(cmd_buffer->handle(), cmd.vertices, 1, v, 0);
+            profiler::increment(profiler::COUNTER_DRAW_CALLS);
+            profiler::increment(profiler::COUNTER_INDICES, cmd.vertices);
             v += cmd.vertices;
         }
 
@@ -1647,6 +1653,8 @@ void DebugDraw::render(gl::Framebuffer::Ptr fbo, int width, int height, const gl
             m_line_program->set_uniform("fade_params", params[1]);
 
             glDrawArrays(cmd.type, v, cmd.vertices);
+            profiler::increment(profiler::COUNTER_DRAW_CALLS);
+            profiler::increment(profiler::COUNTER_INDICES, cmd.vertices);
             v += cmd.vertices;
         }
 
@@ -291,9 +291,9 @@ DemoPlayer::~DemoPlayer()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-bool DemoPlayer::load_from_file()
+bool DemoPlayer::load_from_file(const std::string& path)
 {
-    std::fstream f("camera_path.bin", std::ios::in | std::ios::binary);
+    std::fstream f(path, std::ios::in | std::ios::binary);
 
     if (!f.is_open())
         return false;
@@ -470,6 +470,13 @@ bool DemoPlayer::is_playing()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+float DemoPlayer::duration()
+{
+    return m_position_spline.total_length() / m_speed;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void DemoPlayer::update(float dt, Camera* camera)
 {
     if (m_is_playing)
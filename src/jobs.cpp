@@ -0,0 +1,534 @@
+#include <jobs.h>
+#include <profiler.h>
+#include <logger.h>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#define JOB_QUEUE_SIZE 4096 // Power of two
+#define MAIN_THREAD_INDEX 0
+#define EXTERNAL_THREAD_INDEX UINT32_MAX
+
+namespace dw
+{
+namespace jobs
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct Job
+{
+    Function                func;
+    Counter*                counter;
+    const profiler::Marker* marker;
+    bool                    main_thread;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Chase-Lev work-stealing deque (Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models"). The owning thread
+// pushes and pops at the bottom, any thread may steal from the top. Fixed size, push() fails once it is full.
+struct WorkQueue
+{
+    std::atomic<int64_t> top    = { 0 };
+    std::atomic<int64_t> bottom = { 0 };
+    std::atomic<Job*>    jobs[JOB_QUEUE_SIZE];
+
+    bool push(Job* job)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+
+        if (b - t >= JOB_QUEUE_SIZE)
+            return false;
+
+        jobs[b & (JOB_QUEUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    Job* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job* job = jobs[b & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+
+        // Last job, race the thieves for it.
+        if (t == b)
+        {
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = nullptr;
+
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return job;
+    }
+
+    Job* steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return nullptr;
+
+        Job* job = jobs[t & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+
+        return job;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static thread_local uint32_t t_thread_index = EXTERNAL_THREAD_INDEX;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Markers are never freed, so that jobs can hold on to them across a restart of the scheduler. String literals have a fixed
+// address, so the lock is only taken the first time a thread sees a name.
+static const profiler::Marker* job_marker(const char* name)
+{
+    static std::mutex                                                           s_mutex;
+    static std::unordered_map<const char*, std::unique_ptr<profiler::Marker>> s_markers;
+    thread_local std::unordered_map<const char*, const profiler::Marker*>      t_markers;
+
+    if (!name)
+        return nullptr;
+
+    auto it = t_markers.find(name);
+
+    if (it != t_markers.end())
+        return it->second;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    auto& marker = s_markers[name];
+
+    if (!marker)
+        marker = std::make_unique<profiler::Marker>(name);
+
+    t_markers[name] = marker.get();
+
+    return marker.get();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct Scheduler
+{
+    std::vector<std::unique_ptr<WorkQueue>> m_queues; // Main thread first, then the workers.
+    std::vector<std::thread>                m_workers;
+    std::atomic<bool>                       m_running = { true };
+
+    // Jobs submitted by threads without a deque, or while the own one is full.
+    std::mutex            m_shared_mutex;
+    std::deque<Job*>      m_shared_jobs;
+    std::atomic<uint32_t> m_shared_count = { 0 };
+
+    std::mutex        m_main_thread_mutex;
+    std::vector<Job*> m_main_thread_jobs;
+
+    // Workers that have left worker_thread(), so that shutdown can keep running main thread jobs until they are all done.
+    std::atomic<uint32_t> m_exited_workers = { 0 };
+
+    // Jobs queued on the deques and the shared queue, for idle workers to decide whether to sleep.
+    std::atomic<uint32_t>   m_queued   = { 0 };
+    std::atomic<uint32_t>   m_sleeping = { 0 };
+    std::mutex              m_sleep_mutex;
+    std::condition_variable m_wake;
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    Scheduler(uint32_t worker_count)
+    {
+        t_thread_index = MAIN_THREAD_INDEX;
+
+        for (uint32_t i = 0; i <= worker_count; i++)
+            m_queues.push_back(std::make_unique<WorkQueue>());
+
+        for (uint32_t i = 1; i <= worker_count; i++)
+            m_workers.emplace_back(&Scheduler::worker_thread, this, i);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    ~Scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_running.store(false);
+        }
+
+        m_wake.notify_all();
+
+        // Workers only exit once there is nothing left to steal. One of them may be waiting on a main thread job, so those keep
+        // running until all workers are done.
+        while (m_exited_workers.load() < m_workers.size())
+        {
+            run_main_thread_jobs();
+            std::this_thread::yield();
+        }
+
+        for (auto& worker : m_workers)
+            worker.join();
+
+        // The last main thread jobs may have queued more work with no worker left to take it.
+        while (true)
+        {
+            run_main_thread_jobs();
+
+            Job* job = find_job(MAIN_THREAD_INDEX);
+
+            if (job)
+                execute(job);
+            else
+            {
+                std::lock_guard<std::mutex> lock(m_main_thread_mutex);
+
+                if (m_main_thread_jobs.empty())
+                    break;
+            }
+        }
+
+        t_thread_index = EXTERNAL_THREAD_INDEX;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void worker_thread(uint32_t idx)
+    {
+        t_thread_index = idx;
+
+        profiler::set_thread_name("Job Worker " + std::to_string(idx));
+
+        while (true)
+        {
+            Job* job = find_job(idx);
+
+            if (job)
+            {
+                execute(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+
+            if (!m_running.load() && m_queued.load() == 0)
+                break;
+
+            m_sleeping++;
+            m_wake.wait(lock, [this]() { return m_queued.load() > 0 || !m_running.load(); });
+            m_sleeping--;
+        }
+
+        m_exited_workers++;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Own deque first, then the shared queue, then the other deques starting after the own one.
+    Job* find_job(uint32_t idx)
+    {
+        Job* job = nullptr;
+
+        if (idx < m_queues.size())
+            job = m_queues[idx]->pop();
+
+        if (!job && m_shared_count.load(std::memory_order_acquire) > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_shared_mutex);
+
+            if (!m_shared_jobs.empty())
+            {
+                job = m_shared_jobs.front();
+                m_shared_jobs.pop_front();
+                m_shared_count.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        uint32_t count = uint32_t(m_queues.size());
+        uint32_t start = idx < count ? idx + 1 : 0;
+
+        for (uint32_t i = 0; !job && i < count; i++)
+        {
+            uint32_t victim = (start + i) % count;
+
+            if (victim != idx)
+                job = m_queues[victim]->steal();
+        }
+
+        if (job)
+            m_queued.fetch_sub(1);
+
+        return job;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void schedule(Job* job)
+    {
+        if (job->main_thread)
+        {
+            std::lock_guard<std::mutex> lock(m_main_thread_mutex);
+            m_main_thread_jobs.push_back(job);
+            return;
+        }
+
+        // Counted before it can be taken, so the count never drops below zero.
+        m_queued.fetch_add(1);
+
+        uint32_t idx = t_thread_index;
+
+        if (idx >= m_queues.size() || !m_queues[idx]->push(job))
+        {
+            std::lock_guard<std::mutex> lock(m_shared_mutex);
+            m_shared_jobs.push_back(job);
+            m_shared_count.fetch_add(1, std::memory_order_release);
+        }
+
+        // A worker that is about to sleep has registered itself before checking the queued count, so it either sees the job
+        // or gets woken up here.
+        if (m_sleeping.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_wake.notify_one();
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    static void execute(Job* job)
+    {
+        if (job->marker)
+            profiler::begin_cpu_sample(*job->marker);
+
+        job->func();
+
+        if (job->marker)
+            profiler::end_cpu_sample();
+
+        Counter* counter = job->counter;
+
+        delete job;
+
+        if (counter)
+            finish(counter);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Jobs that are not the last to finish only touch the count. The last one decrements it to zero with the lock held, so that
+    // wait(), which takes the lock once it has seen zero, can not return while the counter is still in use here.
+    static void finish(Counter* counter)
+    {
+        uint32_t pending = counter->m_pending.load(std::memory_order_relaxed);
+
+        while (pending > 1)
+        {
+            if (counter->m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                return;
+        }
+
+        std::vector<Job*> continuations;
+
+        {
+            std::lock_guard<std::mutex> lock(counter->m_mutex);
+
+            if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                continuations.swap(counter->m_continuations);
+        }
+
+        for (auto job : continuations)
+            submit(job);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    static void submit(Job* job);
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    static void wait(Counter& counter);
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void run_main_thread_jobs()
+    {
+        // Jobs may queue more main thread jobs, those run on the next call. A job that calls wait() re-enters this function, so
+        // every call works on its own batch.
+        std::vector<Job*> batch;
+
+        {
+            std::lock_guard<std::mutex> lock(m_main_thread_mutex);
+            batch.swap(m_main_thread_jobs);
+        }
+
+        for (auto job : batch)
+            execute(job);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    static Job* create_job(Function&& func, Counter* counter, const char* name, bool main_thread);
+    static void run_after(Counter& dependency, Job* job);
+};
+
+static Scheduler* g_scheduler = nullptr;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scheduler::submit(Job* job)
+{
+    if (g_scheduler && (job->main_thread || !g_scheduler->m_workers.empty()))
+        g_scheduler->schedule(job);
+    else
+        execute(job);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scheduler::wait(Counter& counter)
+{
+    uint32_t idx = t_thread_index;
+
+    while (counter.m_pending.load(std::memory_order_acquire) != 0)
+    {
+        if (!g_scheduler)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (idx == MAIN_THREAD_INDEX)
+            g_scheduler->run_main_thread_jobs();
+
+        Job* job = g_scheduler->find_job(idx);
+
+        if (job)
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+
+    // The job that brought the count to zero may still hold the lock.
+    std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Job* Scheduler::create_job(Function&& func, Counter* counter, const char* name, bool main_thread)
+{
+    if (counter)
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+    return new Job{ std::move(func), counter, job_marker(name), main_thread };
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scheduler::run_after(Counter& dependency, Job* job)
+{
+    {
+        std::lock_guard<std::mutex> lock(dependency.m_mutex);
+
+        if (dependency.m_pending.load(std::memory_order_acquire) != 0)
+        {
+            dependency.m_continuations.push_back(job);
+            return;
+        }
+    }
+
+    submit(job);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void initialize(uint32_t worker_count)
+{
+    if (g_scheduler)
+        return;
+
+#if defined(__EMSCRIPTEN__)
+    worker_count = 0;
+#else
+    if (worker_count == 0)
+        worker_count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+#endif
+
+    g_scheduler = new Scheduler(worker_count);
+
+    DW_LOG_INFO("Job system started with {} workers", worker_count);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void shutdown()
+{
+    // Jobs still running may submit more, the scheduler stays reachable until the workers have exited.
+    delete g_scheduler;
+    g_scheduler = nullptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t worker_count() { return g_scheduler ? uint32_t(g_scheduler->m_workers.size()) : 0; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t thread_index() { return t_thread_index; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void run(Function func, Counter* counter, const char* name)
+{
+    Scheduler::submit(Scheduler::create_job(std::move(func), counter, name, false));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void run_after(Counter& dependency, Function func, Counter* counter, const char* name)
+{
+    Scheduler::run_after(dependency, Scheduler::create_job(std::move(func), counter, name, false));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void run_on_main_thread(Function func, Counter* counter, const char* name)
+{
+    Scheduler::submit(Scheduler::create_job(std::move(func), counter, name, true));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void run_main_thread_jobs()
+{
+    if (g_scheduler)
+        g_scheduler->run_main_thread_jobs();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void wait(Counter& counter) { Scheduler::wait(counter); }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace jobs
+} // namespace dw
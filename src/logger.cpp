@@ -1,38 +1,1259 @@
 #include <logger.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cctype>
+#include <csignal>
+#include <cinttypes>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(WIN32)
+#    if !defined(NOMINMAX)
+#        define NOMINMAX
+#    endif
+#    include <Windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
 
 #define FILE_STREAM_INDEX 0
 #define CONSOLE_STREAM_INDEX 1
 #define CUSTOM_STREAM_INDEX 2
 
+#define LOG_QUEUE_SIZE 4096 // Power of two
+#define LOG_TEXT_RESERVE 256
+#define LOG_FILE_RESERVE 64
+#define LOG_STRINGS_RESERVE 128
+#define LOG_WRITER_SLEEP_MS 10
+
+#define BINARY_LOG_MAGIC "DWLOGBIN"
+#define BINARY_LOG_VERSION 1
+#define BINARY_RECORD_END 0
+#define BINARY_RECORD_SITE 1
+#define BINARY_RECORD_MESSAGE 2
+#define CRASH_RING_SIZE 1024
+#define CRASH_FILE_SIZE 32
+#define CRASH_TEXT_SIZE 256
+#define CRASH_LINE_SIZE 512
+#define CRASH_STACK_SIZE 65536
+
+#define BINARY_MAX_SITES 4096 // Further sites, usually messages built at run time, are defined again before every message.
+
 #define LOG_SEPERATOR                                                            \
     "**************************************************************************" \
     "******************************\n"
 
-namespace dw
+namespace dw
+{
+namespace logger
+{
+// Slot of the bounded multi-producer queue. A producer owns the slot once it has claimed its position and hands it to the
+// logger thread by publishing the next sequence number. The strings keep their capacity, so messages that fit are copied
+// without allocating. The format string goes into text, string arguments are copied into strings and point there.
+struct LogRecord
+{
+    std::atomic<uint64_t> sequence;
+    LogLevel              level;
+    int                   line;
+    bool                  simple; // log_info() and friends, without file and line.
+    std::time_t           time;
+    uint32_t              argument_count;
+    Argument              arguments[LOG_MAX_ARGUMENTS];
+    std::string           text;
+    std::string           file;
+    std::string           strings;
+};
+
+// Header at the start of every binary log file. Values are stored in the byte order of the machine that wrote them.
+struct BinaryHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t sequence; // Increases with every rotation, orders the files of a run.
+    int64_t  start_time;
+    uint64_t size; // Bytes written including the header, 0 if the file was not closed properly.
+};
+
+// Memory-mapped binary stream. Every distinct combination of level, file, line, format string and argument types is a site,
+// written out once per file. Messages then only carry the site ID, the seconds since the file was started and the raw
+// argument values, strings as length and bytes. A file that is full is truncated to its used size and the next one in the
+// rotation is overwritten.
+struct BinaryStream
+{
+    std::string path;
+    size_t      file_size  = 0;
+    uint32_t    file_count = 0;
+    uint32_t    sequence   = 0;
+    std::time_t start_time = 0;
+    uint8_t*    data       = nullptr;
+    size_t      pos        = 0;
+#if defined(WIN32)
+    HANDLE file    = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    std::unordered_map<std::string, uint32_t> sites;
+    std::vector<bool>                         written; // Sites defined in the current file.
+    std::string                               key;
+    std::string                               site_record;
+    std::string                               message_record;
+};
+
+// Slot of the crash ring. Written by the logging thread itself, before the message is queued, so a crash can not lose what
+// the logger thread has not written yet. The sequence is 0 while the slot is being written.
+struct CrashRecord
+{
+    std::atomic<uint64_t> sequence;
+    std::time_t           time;
+    LogLevel              level;
+    int                   line;
+    bool                  simple;
+    uint32_t              argument_count;
+    Argument              arguments[LOG_MAX_ARGUMENTS];
+    char                  file[CRASH_FILE_SIZE];
+    char                  text[CRASH_TEXT_SIZE]; // Format string followed by the string arguments, truncated to fit.
+    uint32_t              format_size;
+};
+
+// Output for the formatting functions that never allocates, the message is truncated to the buffer instead.
+struct FixedBuffer
+{
+    char*  data;
+    size_t capacity;
+    size_t size = 0;
+
+    void append(const char* str, size_t count)
+    {
+        count = std::min(count, capacity - size);
+        std::memcpy(data + size, str, count);
+        size += count;
+    }
+
+    FixedBuffer& operator+=(char c)
+    {
+        append(&c, 1);
+        return *this;
+    }
+
+    FixedBuffer& operator+=(const char* str)
+    {
+        append(str, std::strlen(str));
+        return *this;
+    }
+
+    FixedBuffer& operator+=(std::string_view str)
+    {
+        append(str.data(), str.size());
+        return *this;
+    }
+};
+
+struct LoggerState
+{
+    ~LoggerState() { shutdown(); }
+
+    bool                 _open_streams[3];
+    std::mutex           _stream_mutex;
+    std::ofstream        _stream;
+    std::time_t          _rawtime;
+    std::atomic<int>     _verbosity;
+    CustomStreamCallback _callback;
+    std::atomic<bool>    _debug;
+    BinaryStream         _binary;
+
+    // Queue.
+    std::unique_ptr<LogRecord[]> _records;
+    std::atomic<uint64_t>        _enqueue_pos = { 0 };
+    uint64_t                     _dequeue_pos = 0; // Logger thread only.
+    std::atomic<uint32_t>        _dropped     = { 0 };
+
+    // Logger thread.
+    std::thread             _thread;
+    std::atomic<bool>       _running  = { false };
+    std::atomic<bool>       _sleeping = { false };
+    std::mutex              _wake_mutex;
+    std::condition_variable _wake_cv;
+    std::condition_variable _flushed_cv;
+    bool                    _wake         = false;
+    bool                    _quit         = false;
+    uint64_t                _flush_target = 0;
+    uint64_t                _flushed_pos  = 0;
+};
+
+LoggerState g_logger;
+
+// Set while a custom stream callback runs, which is always with the stream lock held.
+static thread_local bool t_in_callback = false;
+
+// Static so that they can be read from a signal handler without touching the heap.
+static CrashRecord           g_crash_ring[CRASH_RING_SIZE];
+static std::atomic<uint64_t> g_crash_pos      = { 0 };
+static std::atomic<bool>     g_crashing       = { false };
+static char                  g_crash_path[256] = { 0 };
+static long                  g_crash_utc_offset = 0;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static const char* level_string(LogLevel level)
+{
+    switch (level)
+    {
+        case LEVEL_INFO:
+            return "INFO   ";
+        case LEVEL_WARNING:
+            return "WARNING";
+        case LEVEL_ERR:
+            return "ERROR  ";
+        case LEVEL_FATAL:
+            return "FATAL  ";
+    }
+
+    return "";
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Appends value in the given base without printf, which is not async-signal-safe.
+template <typename Output>
+static void append_unsigned(Output& output, uint64_t value, uint32_t base = 10, bool upper = false, uint32_t min_digits = 1)
+{
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char        buffer[64];
+    uint32_t    count = 0;
+
+    min_digits = std::min(min_digits, uint32_t(sizeof(buffer)));
+
+    do
+    {
+        buffer[count++] = digits[value % base];
+        value /= base;
+    } while (value != 0 || count < min_digits);
+
+    while (count > 0)
+        output += buffer[--count];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Fixed point with the given precision, scientific notation once the integer part no longer fits 64 bits. Rounding is not
+// exact in the last digit, which is fine for a crash log.
+template <typename Output>
+static void append_double(Output& output, double value, uint32_t precision)
+{
+    if (std::isnan(value))
+    {
+        output += "nan";
+        return;
+    }
+
+    if (std::signbit(value))
+    {
+        output += '-';
+        value = -value;
+    }
+
+    if (std::isinf(value))
+    {
+        output += "inf";
+        return;
+    }
+
+    int32_t exponent = 0;
+
+    if (value >= 1e19)
+    {
+        while (value >= 10.0)
+        {
+            value /= 10.0;
+            exponent++;
+        }
+    }
+
+    precision = std::min(precision, 17u);
+
+    uint64_t scale = 1;
+
+    for (uint32_t i = 0; i < precision; i++)
+        scale *= 10;
+
+    uint64_t whole    = uint64_t(value);
+    uint64_t fraction = uint64_t((value - double(whole)) * double(scale) + 0.5);
+
+    if (fraction >= scale)
+    {
+        whole++;
+        fraction -= scale;
+    }
+
+    if (exponent > 0 && whole == 10)
+    {
+        whole = 1;
+        exponent++;
+    }
+
+    append_unsigned(output, whole);
+
+    if (precision > 0)
+    {
+        output += '.';
+        append_unsigned(output, fraction, 10, false, precision);
+    }
+
+    if (exponent > 0)
+    {
+        output += "e+";
+        append_unsigned(output, uint64_t(exponent), 10, false, 2);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// format_argument() for the crash log, without printf. Honours the conversion and the precision of doubles, other flags and
+// the width are ignored.
+template <typename Output>
+static void format_argument_signal_safe(Output& output, const Argument& arg, std::string_view spec)
+{
+    char     conversion = 0;
+    uint32_t precision  = 6;
+
+    if (!spec.empty() && ((spec.back() >= 'a' && spec.back() <= 'z') || (spec.back() >= 'A' && spec.back() <= 'Z')))
+    {
+        conversion = spec.back();
+        spec.remove_suffix(1);
+    }
+
+    size_t dot = spec.find('.');
+
+    if (dot != std::string_view::npos)
+    {
+        precision = 0;
+
+        for (size_t i = dot + 1; i < spec.size() && spec[i] >= '0' && spec[i] <= '9'; i++)
+            precision = precision * 10 + uint32_t(spec[i] - '0');
+    }
+
+    switch (arg.type)
+    {
+        case Argument::TYPE_BOOL:
+            output += arg.b ? "true" : "false";
+            return;
+        case Argument::TYPE_CHAR:
+            output += arg.c;
+            return;
+        case Argument::TYPE_STRING:
+            output.append(arg.str.data, arg.str.size);
+            return;
+        case Argument::TYPE_POINTER:
+            output += "0x";
+            append_unsigned(output, uint64_t(uintptr_t(arg.p)), 16);
+            return;
+        case Argument::TYPE_INT:
+        case Argument::TYPE_UINT:
+        {
+            if (conversion == 'x' || conversion == 'X')
+                append_unsigned(output, arg.u, 16, conversion == 'X');
+            else if (conversion == 'o')
+                append_unsigned(output, arg.u, 8);
+            else if (arg.type == Argument::TYPE_INT && arg.i < 0)
+            {
+                output += '-';
+                append_unsigned(output, 0 - arg.u);
+            }
+            else
+                append_unsigned(output, arg.u);
+            return;
+        }
+        case Argument::TYPE_DOUBLE:
+            append_double(output, arg.d, precision);
+            return;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Appends an argument, spec is whatever followed the colon in the placeholder.
+template <typename Output>
+static void format_argument(Output& output, const Argument& arg, std::string_view spec)
+{
+    char buffer[64];
+    char format[16] = "%";
+    int  length     = 1;
+
+    // Flags, width and precision pass through to printf, a trailing letter picks the conversion.
+    char conversion = 0;
+
+    if (!spec.empty() && std::isalpha((unsigned char)spec.back()))
+    {
+        conversion = spec.back();
+        spec.remove_suffix(1);
+    }
+
+    for (size_t i = 0; i < spec.size() && length < 8; i++)
+    {
+        if (std::strchr("0123456789.+- #", spec[i]))
+            format[length++] = spec[i];
+    }
+
+    format[length] = '\0';
+
+    switch (arg.type)
+    {
+        case Argument::TYPE_BOOL:
+            output += arg.b ? "true" : "false";
+            return;
+        case Argument::TYPE_CHAR:
+            output += arg.c;
+            return;
+        case Argument::TYPE_STRING:
+            output.append(arg.str.data, arg.str.size);
+            return;
+        case Argument::TYPE_POINTER:
+            std::snprintf(buffer, sizeof(buffer), "%p", arg.p);
+            break;
+        case Argument::TYPE_INT:
+        case Argument::TYPE_UINT:
+        {
+            const char* modifier;
+
+            if (conversion == 'x')
+                modifier = PRIx64;
+            else if (conversion == 'X')
+                modifier = PRIX64;
+            else if (conversion == 'o')
+                modifier = PRIo64;
+            else
+                modifier = arg.type == Argument::TYPE_INT ? PRId64 : PRIu64;
+
+            std::strcat(format, modifier);
+
+            if (arg.type == Argument::TYPE_INT)
+                std::snprintf(buffer, sizeof(buffer), format, arg.i);
+            else
+                std::snprintf(buffer, sizeof(buffer), format, arg.u);
+            break;
+        }
+        case Argument::TYPE_DOUBLE:
+            format[length]     = (conversion && std::strchr("fFeEgGaA", conversion)) ? conversion : 'g';
+            format[length + 1] = '\0';
+            std::snprintf(buffer, sizeof(buffer), format, arg.d);
+            break;
+    }
+
+    output += buffer;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Replaces every {} in format with the next argument, {{ and }} are escaped braces. signal_safe formats the arguments without
+// printf, for the crash log.
+template <typename Output>
+static void format_message(Output& output, std::string_view format, const Argument* arguments, uint32_t argument_count, bool signal_safe = false)
+{
+    if (argument_count == 0)
+    {
+        output += format;
+        return;
+    }
+
+    uint32_t next = 0;
+    size_t   i    = 0;
+
+    while (i < format.size())
+    {
+        char c = format[i];
+
+        if (c == '{' && i + 1 < format.size() && format[i + 1] == '{')
+        {
+            output += '{';
+            i += 2;
+        }
+        else if (c == '}' && i + 1 < format.size() && format[i + 1] == '}')
+        {
+            output += '}';
+            i += 2;
+        }
+        else if (c == '{')
+        {
+            size_t end = format.find('}', i);
+
+            if (end == std::string_view::npos)
+            {
+                output += format.substr(i);
+                return;
+            }
+
+            std::string_view spec = format.substr(i + 1, end - i - 1);
+
+            if (!spec.empty() && spec[0] == ':')
+                spec.remove_prefix(1);
+
+            if (next < argument_count && signal_safe)
+                format_argument_signal_safe(output, arguments[next++], spec);
+            else if (next < argument_count)
+                format_argument(output, arguments[next++], spec);
+
+            i = end + 1;
+        }
+        else
+        {
+            output += c;
+            i++;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void format_line(std::string& output, int verbosity, std::time_t time, LogLevel level, std::string_view text, const Argument* arguments, uint32_t argument_count, std::string_view file, int line, bool simple)
+{
+    output.clear();
+
+    if ((verbosity & VERBOSITY_TIMESTAMP) || (verbosity & VERBOSITY_LEVEL))
+    {
+        output += "[ ";
+
+        if (verbosity & VERBOSITY_TIMESTAMP)
+        {
+            char timestamp[80];
+            std::strftime(timestamp, 80, "%H:%M:%S", std::localtime(&time));
+            output += timestamp;
+        }
+
+        if ((verbosity & VERBOSITY_TIMESTAMP) && (verbosity & VERBOSITY_LEVEL))
+            output += " | ";
+
+        if (verbosity & VERBOSITY_LEVEL)
+            output += level_string(level);
+
+        output += " ] : ";
+    }
+
+    format_message(output, text, arguments, argument_count);
+
+    if (!simple && (verbosity & VERBOSITY_FILE))
+    {
+        output += " , FILE : ";
+        output += file;
+    }
+
+    if (!simple && (verbosity & VERBOSITY_LINE))
+    {
+        output += " , LINE : ";
+        output += std::to_string(line);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void put_varint(std::string& output, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        output += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+
+    output += char(value);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void put_string(std::string& output, std::string_view str)
+{
+    put_varint(output, str.size());
+    output += str;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void unmap_binary_file()
+{
+    BinaryStream& binary = g_logger._binary;
+
+    if (!binary.data)
+        return;
+
+    reinterpret_cast<BinaryHeader*>(binary.data)->size = binary.pos;
+
+#if defined(WIN32)
+    UnmapViewOfFile(binary.data);
+    CloseHandle(binary.mapping);
+
+    LARGE_INTEGER size;
+    size.QuadPart = LONGLONG(binary.pos);
+    SetFilePointerEx(binary.file, size, nullptr, FILE_BEGIN);
+    SetEndOfFile(binary.file);
+    CloseHandle(binary.file);
+
+    binary.file    = INVALID_HANDLE_VALUE;
+    binary.mapping = nullptr;
+#else
+    munmap(binary.data, binary.file_size);
+
+    if (ftruncate(binary.fd, off_t(binary.pos)) != 0)
+        std::cerr << "Failed to truncate binary log file.\n";
+
+    close(binary.fd);
+
+    binary.fd = -1;
+#endif
+
+    binary.data = nullptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Opens the next file of the rotation. Must be called with the stream mutex held.
+static bool map_binary_file()
+{
+    BinaryStream& binary = g_logger._binary;
+    std::string   path   = binary.path + "." + std::to_string(binary.sequence % binary.file_count);
+
+#if defined(WIN32)
+    binary.file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (binary.file == INVALID_HANDLE_VALUE)
+        return false;
+
+    binary.mapping = CreateFileMappingA(binary.file, nullptr, PAGE_READWRITE, DWORD(uint64_t(binary.file_size) >> 32), DWORD(binary.file_size & 0xffffffff), nullptr);
+
+    if (binary.mapping)
+        binary.data = static_cast<uint8_t*>(MapViewOfFile(binary.mapping, FILE_MAP_WRITE, 0, 0, binary.file_size));
+
+    if (!binary.data)
+    {
+        if (binary.mapping)
+            CloseHandle(binary.mapping);
+
+        CloseHandle(binary.file);
+
+        binary.file    = INVALID_HANDLE_VALUE;
+        binary.mapping = nullptr;
+
+        return false;
+    }
+#else
+    binary.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (binary.fd == -1)
+        return false;
+
+    void* data = MAP_FAILED;
+
+    if (ftruncate(binary.fd, off_t(binary.file_size)) == 0)
+        data = mmap(nullptr, binary.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, binary.fd, 0);
+
+    if (data == MAP_FAILED)
+    {
+        close(binary.fd);
+        binary.fd = -1;
+
+        return false;
+    }
+
+    binary.data = static_cast<uint8_t*>(data);
+#endif
+
+    BinaryHeader* header = reinterpret_cast<BinaryHeader*>(binary.data);
+
+    std::memcpy(header->magic, BINARY_LOG_MAGIC, sizeof(header->magic));
+    header->version    = BINARY_LOG_VERSION;
+    header->sequence   = binary.sequence++;
+    header->start_time = int64_t(std::time(nullptr));
+    header->size       = 0;
+
+    binary.start_time = std::time_t(header->start_time);
+    binary.pos        = sizeof(BinaryHeader);
+    binary.written.assign(binary.written.size(), false);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void encode_site(std::string& output, uint32_t id, LogLevel level, std::string_view text, const Argument* arguments, uint32_t argument_count, std::string_view file, int line, bool simple)
+{
+    output.clear();
+    output += char(BINARY_RECORD_SITE);
+    put_varint(output, id);
+    output += char(level);
+    output += char(simple);
+    put_varint(output, uint32_t(line));
+    put_string(output, file);
+    put_string(output, text);
+    output += char(argument_count);
+
+    for (uint32_t i = 0; i < argument_count; i++)
+        output += char(arguments[i].type);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Must be called with the stream mutex held.
+static void write_binary(std::time_t time, LogLevel level, std::string_view text, const Argument* arguments, uint32_t argument_count, std::string_view file, int line, bool simple)
+{
+    BinaryStream& binary = g_logger._binary;
+
+    binary.key.clear();
+    binary.key += char(level);
+    binary.key += char(simple);
+    binary.key.append(reinterpret_cast<const char*>(&line), sizeof(line));
+    binary.key += file;
+    binary.key += '\0';
+    binary.key += text;
+    binary.key += '\0';
+
+    for (uint32_t i = 0; i < argument_count; i++)
+        binary.key += char(arguments[i].type);
+
+    auto     it = binary.sites.find(binary.key);
+    uint32_t id = BINARY_MAX_SITES;
+
+    if (it != binary.sites.end())
+        id = it->second;
+    else if (binary.sites.size() < BINARY_MAX_SITES)
+    {
+        id = uint32_t(binary.sites.size());
+        binary.sites.emplace(binary.key, id);
+        binary.written.push_back(false);
+    }
+
+    bool defined = id < BINARY_MAX_SITES && binary.written[id];
+
+    std::string& message = binary.message_record;
+
+    message.clear();
+    message += char(BINARY_RECORD_MESSAGE);
+    put_varint(message, id);
+    put_varint(message, time > binary.start_time ? uint64_t(time - binary.start_time) : 0);
+
+    for (uint32_t i = 0; i < argument_count; i++)
+    {
+        const Argument& arg = arguments[i];
+
+        switch (arg.type)
+        {
+            case Argument::TYPE_BOOL:
+                message += char(arg.b);
+                break;
+            case Argument::TYPE_CHAR:
+                message += arg.c;
+                break;
+            case Argument::TYPE_INT:
+                put_varint(message, (uint64_t(arg.i) << 1) ^ uint64_t(arg.i >> 63)); // Zigzag, small negatives stay short.
+                break;
+            case Argument::TYPE_UINT:
+                put_varint(message, arg.u);
+                break;
+            case Argument::TYPE_DOUBLE:
+                message.append(reinterpret_cast<const char*>(&arg.d), sizeof(arg.d));
+                break;
+            case Argument::TYPE_STRING:
+                put_string(message, std::string_view(arg.str.data, arg.str.size));
+                break;
+            case Argument::TYPE_POINTER:
+            {
+                uint64_t address = uint64_t(uintptr_t(arg.p));
+                message.append(reinterpret_cast<const char*>(&address), sizeof(address));
+                break;
+            }
+        }
+    }
+
+    std::string& site = binary.site_record;
+
+    if (!defined)
+        encode_site(site, id, level, text, arguments, argument_count, file, line, simple);
+    else
+        site.clear();
+
+    // Keep one byte for the end marker.
+    if (binary.pos + site.size() + message.size() >= binary.file_size)
+    {
+        unmap_binary_file();
+
+        if (!map_binary_file())
+            return;
+
+        encode_site(site, id, level, text, arguments, argument_count, file, line, simple);
+
+        if (binary.pos + site.size() + message.size() >= binary.file_size)
+            return;
+    }
+
+    std::memcpy(binary.data + binary.pos, site.data(), site.size());
+    binary.pos += site.size();
+    std::memcpy(binary.data + binary.pos, message.data(), message.size());
+    binary.pos += message.size();
+
+    if (id < BINARY_MAX_SITES)
+        binary.written[id] = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool get_varint(const uint8_t*& ptr, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+
+    for (uint32_t shift = 0; ptr < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *ptr++;
+        value |= uint64_t(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool get_string(const uint8_t*& ptr, const uint8_t* end, std::string_view& str)
+{
+    uint64_t size;
+
+    if (!get_varint(ptr, end, size) || size > uint64_t(end - ptr))
+        return false;
+
+    str = std::string_view(reinterpret_cast<const char*>(ptr), size_t(size));
+    ptr += size;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct DecodedSite
+{
+    LogLevel         level;
+    bool             simple;
+    int              line;
+    std::string_view file;
+    std::string_view text;
+    uint32_t         argument_count;
+    Argument::Type   types[LOG_MAX_ARGUMENTS];
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Decodes the records of one file, returns false if it ended in a malformed record.
+static bool decode_binary_file(const std::string& data, std::ostream& output)
+{
+    const BinaryHeader* header = reinterpret_cast<const BinaryHeader*>(data.data());
+    const uint8_t*      ptr    = reinterpret_cast<const uint8_t*>(data.data()) + sizeof(BinaryHeader);
+    const uint8_t*      end    = reinterpret_cast<const uint8_t*>(data.data()) + (header->size > 0 ? std::min(size_t(header->size), data.size()) : data.size());
+
+    std::vector<DecodedSite> sites(BINARY_MAX_SITES + 1);
+    std::vector<bool>        defined(BINARY_MAX_SITES + 1, false);
+    std::string              line;
+    Argument                 arguments[LOG_MAX_ARGUMENTS];
+
+    while (ptr < end && *ptr != BINARY_RECORD_END)
+    {
+        uint8_t  tag = *ptr++;
+        uint64_t id;
+
+        if (!get_varint(ptr, end, id) || id > BINARY_MAX_SITES)
+            return false;
+
+        if (tag == BINARY_RECORD_SITE)
+        {
+            DecodedSite& site = sites[id];
+            uint64_t     line_number;
+
+            if (end - ptr < 2)
+                return false;
+
+            site.level  = LogLevel(*ptr++);
+            site.simple = *ptr++ != 0;
+
+            if (!get_varint(ptr, end, line_number) || !get_string(ptr, end, site.file) || !get_string(ptr, end, site.text) || ptr >= end)
+                return false;
+
+            site.line           = int(line_number);
+            site.argument_count = *ptr++;
+
+            if (site.argument_count > LOG_MAX_ARGUMENTS || uint64_t(end - ptr) < site.argument_count)
+                return false;
+
+            for (uint32_t i = 0; i < site.argument_count; i++)
+                site.types[i] = Argument::Type(*ptr++);
+
+            defined[id] = true;
+        }
+        else if (tag == BINARY_RECORD_MESSAGE)
+        {
+            uint64_t delta;
+
+            if (!defined[id] || !get_varint(ptr, end, delta))
+                return false;
+
+            const DecodedSite& site = sites[id];
+
+            for (uint32_t i = 0; i < site.argument_count; i++)
+            {
+                Argument& arg = arguments[i];
+                arg.type      = site.types[i];
+
+                switch (arg.type)
+                {
+                    case Argument::TYPE_BOOL:
+                        if (ptr >= end)
+                            return false;
+
+                        arg.b = *ptr++ != 0;
+                        break;
+                    case Argument::TYPE_CHAR:
+                        if (ptr >= end)
+                            return false;
+
+                        arg.c = char(*ptr++);
+                        break;
+                    case Argument::TYPE_INT:
+                    {
+                        uint64_t value;
+
+                        if (!get_varint(ptr, end, value))
+                            return false;
+
+                        arg.i = int64_t(value >> 1) ^ -int64_t(value & 1);
+                        break;
+                    }
+                    case Argument::TYPE_UINT:
+                        if (!get_varint(ptr, end, arg.u))
+                            return false;
+                        break;
+                    case Argument::TYPE_DOUBLE:
+                    case Argument::TYPE_POINTER:
+                    {
+                        uint64_t bits;
+
+                        if (end - ptr < 8)
+                            return false;
+
+                        std::memcpy(&bits, ptr, sizeof(bits));
+                        ptr += sizeof(bits);
+
+                        if (arg.type == Argument::TYPE_DOUBLE)
+                            std::memcpy(&arg.d, &bits, sizeof(bits));
+                        else
+                            arg.p = reinterpret_cast<const void*>(uintptr_t(bits));
+                        break;
+                    }
+                    case Argument::TYPE_STRING:
+                    {
+                        std::string_view str;
+
+                        if (!get_string(ptr, end, str))
+                            return false;
+
+                        arg.str.data = str.data();
+                        arg.str.size = str.size();
+                        break;
+                    }
+                    default:
+                        return false;
+                }
+            }
+
+            format_line(line, VERBOSITY_ALL, std::time_t(header->start_time + int64_t(delta)), site.level, site.text, arguments, site.argument_count, site.file, site.line, site.simple);
+            output << line << "\n";
+        }
+        else
+            return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Formats into output, which is reused across calls. Must be called with the stream mutex held.
+static void call_custom_stream(const std::string& text, LogLevel level)
+{
+    t_in_callback = true;
+    g_logger._callback(text, level);
+    t_in_callback = false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void write_record(std::string& output, std::time_t time, LogLevel level, std::string_view text, const Argument* arguments, uint32_t argument_count, std::string_view file, int line, bool simple)
+{
+    if (g_logger._binary.data)
+        write_binary(time, level, text, arguments, argument_count, file, line, simple);
+
+    // Binary only runs skip formatting altogether.
+    if (!g_logger._open_streams[FILE_STREAM_INDEX] && !g_logger._open_streams[CONSOLE_STREAM_INDEX] && !(g_logger._open_streams[CUSTOM_STREAM_INDEX] && g_logger._callback))
+        return;
+
+    format_line(output, g_logger._verbosity.load(std::memory_order_relaxed), time, level, text, arguments, argument_count, file, line, simple);
+
+    if (g_logger._open_streams[FILE_STREAM_INDEX])
+        g_logger._stream << output << "\n";
+
+    if (g_logger._open_streams[CONSOLE_STREAM_INDEX])
+        std::cout << output << "\n";
+
+    if (g_logger._open_streams[CUSTOM_STREAM_INDEX] && g_logger._callback)
+        call_custom_stream(output, level);
+
+    if (level == LEVEL_ERR || level == LEVEL_FATAL || g_logger._debug.load(std::memory_order_relaxed))
+    {
+        if (g_logger._open_streams[FILE_STREAM_INDEX])
+            g_logger._stream.flush();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void record_crash_ring(std::time_t time, LogLevel level, const char* file, int line, bool simple, std::string_view format, const Argument* arguments, uint32_t argument_count)
+{
+    uint64_t     pos    = g_crash_pos.fetch_add(1, std::memory_order_relaxed);
+    CrashRecord& record = g_crash_ring[pos % CRASH_RING_SIZE];
+
+    // Orders this write after the one a lap earlier. That one is only still in progress if the logging thread stalled for a
+    // whole lap, the message is then left out of the ring.
+    if (record.sequence.exchange(0, std::memory_order_acq_rel) == 0 && pos >= CRASH_RING_SIZE)
+        return;
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    record.time           = time;
+    record.level          = level;
+    record.line           = line;
+    record.simple         = simple;
+    record.argument_count = argument_count;
+
+    size_t file_size = std::min(std::strlen(file), size_t(CRASH_FILE_SIZE - 1));
+    std::memcpy(record.file, file, file_size);
+    record.file[file_size] = '\0';
+
+    size_t size = std::min(format.size(), size_t(CRASH_TEXT_SIZE));
+    std::memcpy(record.text, format.data(), size);
+    record.format_size = uint32_t(size);
+
+    for (uint32_t i = 0; i < argument_count; i++)
+    {
+        record.arguments[i] = arguments[i];
+
+        if (arguments[i].type == Argument::TYPE_STRING)
+        {
+            size_t str_size = std::min(arguments[i].str.size, CRASH_TEXT_SIZE - size);
+            std::memcpy(record.text + size, arguments[i].str.data, str_size);
+
+            record.arguments[i].str.data = record.text + size;
+            record.arguments[i].str.size = str_size;
+            size += str_size;
+        }
+    }
+
+    record.sequence.store(pos + 1, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void submit(LogLevel level, const char* file, int line, std::string_view format, const Argument* arguments, uint32_t argument_count)
 {
-namespace logger
+    bool        simple = file == nullptr;
+    std::time_t time   = std::time(nullptr);
+
+    if (simple)
+        file = "";
+
+    record_crash_ring(time, level, file, line, simple, format, arguments, argument_count);
+
+    if (!g_logger._running.load(std::memory_order_acquire))
+    {
+        // A custom stream callback that logs already holds the stream lock.
+        std::unique_lock<std::mutex> lock(g_logger._stream_mutex, std::defer_lock);
+
+        if (!t_in_callback)
+            lock.lock();
+
+        std::string output;
+        write_record(output, time, level, format, arguments, argument_count, file, line, simple);
+
+        if (level == LEVEL_FATAL)
+            dump_crash_log();
+
+        return;
+    }
+
+    uint64_t   pos    = g_logger._enqueue_pos.load(std::memory_order_relaxed);
+    LogRecord* record = nullptr;
+
+    while (!record)
+    {
+        LogRecord& slot     = g_logger._records[pos & (LOG_QUEUE_SIZE - 1)];
+        uint64_t   sequence = slot.sequence.load(std::memory_order_acquire);
+        int64_t    diff     = int64_t(sequence) - int64_t(pos);
+
+        if (diff == 0)
+        {
+            if (g_logger._enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                record = &slot;
+        }
+        else if (diff < 0)
+        {
+            // Full, the logger thread is behind by a whole queue. It can not wait on itself when a callback logs.
+            if (level < LEVEL_ERR || std::this_thread::get_id() == g_logger._thread.get_id())
+            {
+                g_logger._dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            std::this_thread::yield();
+            pos = g_logger._enqueue_pos.load(std::memory_order_relaxed);
+        }
+        else
+            pos = g_logger._enqueue_pos.load(std::memory_order_relaxed);
+    }
+
+    record->level  = level;
+    record->line   = line;
+    record->simple = simple;
+    record->time   = time;
+    record->text.assign(format);
+    record->file.assign(file);
+
+    // Size the string storage up front so the argument pointers stay valid.
+    size_t strings_size = 0;
+
+    for (uint32_t i = 0; i < argument_count; i++)
+    {
+        if (arguments[i].type == Argument::TYPE_STRING)
+            strings_size += arguments[i].str.size;
+    }
+
+    record->strings.clear();
+    record->strings.reserve(strings_size);
+    record->argument_count = argument_count;
+
+    for (uint32_t i = 0; i < argument_count; i++)
+    {
+        record->arguments[i] = arguments[i];
+
+        if (arguments[i].type == Argument::TYPE_STRING)
+        {
+            record->arguments[i].str.data = record->strings.data() + record->strings.size();
+            record->strings.append(arguments[i].str.data, arguments[i].str.size);
+        }
+    }
+
+    record->sequence.store(pos + 1, std::memory_order_release);
+
+    if (level == LEVEL_FATAL)
+    {
+        flush();
+        dump_crash_log();
+    }
+    else if (g_logger._sleeping.load(std::memory_order_relaxed))
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_logger._wake_mutex);
+            g_logger._wake = true;
+        }
+
+        g_logger._wake_cv.notify_one();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Writes out every published record, returns false if there was none.
+static bool drain(std::string& output)
 {
-struct LoggerState
+    bool wrote = false;
+
+    std::lock_guard<std::mutex> lock(g_logger._stream_mutex);
+
+    while (true)
+    {
+        LogRecord& record = g_logger._records[g_logger._dequeue_pos & (LOG_QUEUE_SIZE - 1)];
+
+        if (record.sequence.load(std::memory_order_acquire) != g_logger._dequeue_pos + 1)
+            break;
+
+        write_record(output, record.time, record.level, record.text, record.arguments, record.argument_count, record.file, record.line, record.simple);
+
+        record.sequence.store(g_logger._dequeue_pos + LOG_QUEUE_SIZE, std::memory_order_release);
+        g_logger._dequeue_pos++;
+        wrote = true;
+    }
+
+    uint32_t dropped = g_logger._dropped.exchange(0, std::memory_order_relaxed);
+
+    if (dropped > 0)
+    {
+        Argument arg = make_argument(dropped);
+        write_record(output, std::time(nullptr), LEVEL_WARNING, "{} log messages dropped, the queue was full.", &arg, 1, "", 0, true);
+    }
+
+    return wrote;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void writer_thread()
 {
-    bool                 _open_streams[3];
-    std::mutex           _log_mutex;
-    std::ofstream        _stream;
-    std::time_t          _rawtime;
-    std::tm*             _timeinfo;
-    int                  _verbosity;
-    char                 _temp_buffer[80];
-    CustomStreamCallback _callback;
-    bool                 _debug;
-};
+    std::string output;
+    output.reserve(LOG_TEXT_RESERVE * 2);
 
-LoggerState g_logger;
+    while (true)
+    {
+        bool wrote = drain(output);
+
+        std::unique_lock<std::mutex> lock(g_logger._wake_mutex);
+
+        if (g_logger._flush_target > g_logger._flushed_pos && g_logger._dequeue_pos >= g_logger._flush_target)
+        {
+            {
+                std::lock_guard<std::mutex> stream_lock(g_logger._stream_mutex);
+
+                if (g_logger._open_streams[FILE_STREAM_INDEX])
+                    g_logger._stream.flush();
+
+                std::cout.flush();
+            }
+
+            g_logger._flushed_pos = g_logger._dequeue_pos;
+            g_logger._flushed_cv.notify_all();
+        }
+
+        if (wrote)
+            continue;
+
+        if (g_logger._quit && g_logger._dequeue_pos == g_logger._enqueue_pos.load(std::memory_order_acquire))
+            break;
+
+        // Producers only notify when they see the flag, a wake up missed in between is caught by the timeout.
+        g_logger._sleeping.store(true, std::memory_order_relaxed);
+        g_logger._wake_cv.wait_for(lock, std::chrono::milliseconds(LOG_WRITER_SLEEP_MS), [] { return g_logger._wake; });
+        g_logger._sleeping.store(false, std::memory_order_relaxed);
+        g_logger._wake = false;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
 
 void initialize()
 {
@@ -42,12 +1263,64 @@ void initialize()
     g_logger._callback  = nullptr;
     g_logger._verbosity = VERBOSITY_ALL;
     g_logger._debug     = false;
+
+    if (g_logger._running)
+        return;
+
+    g_logger._records.reset(new LogRecord[LOG_QUEUE_SIZE]);
+
+    for (uint64_t i = 0; i < LOG_QUEUE_SIZE; i++)
+    {
+        g_logger._records[i].sequence.store(i, std::memory_order_relaxed);
+        g_logger._records[i].text.reserve(LOG_TEXT_RESERVE);
+        g_logger._records[i].file.reserve(LOG_FILE_RESERVE);
+        g_logger._records[i].strings.reserve(LOG_STRINGS_RESERVE);
+    }
+
+    g_logger._enqueue_pos.store(0, std::memory_order_relaxed);
+    g_logger._dequeue_pos  = 0;
+    g_logger._flush_target = 0;
+    g_logger._flushed_pos  = 0;
+    g_logger._quit         = false;
+    g_logger._wake         = false;
+
+    g_logger._running.store(true, std::memory_order_release);
+    g_logger._thread = std::thread(writer_thread);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void shutdown()
+{
+    if (!g_logger._running.load(std::memory_order_acquire))
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(g_logger._wake_mutex);
+
+        g_logger._quit = true;
+        g_logger._wake = true;
+    }
+
+    g_logger._wake_cv.notify_one();
+    g_logger._thread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(g_logger._wake_mutex);
+        g_logger._running.store(false, std::memory_order_release);
+    }
+
+    g_logger._flushed_cv.notify_all();
+
+    flush();
 }
 
 void set_verbosity(int flags) { g_logger._verbosity = flags; }
 
 void open_console_stream()
 {
+    std::lock_guard<std::mutex> lock(g_logger._stream_mutex);
+
     g_logger._open_streams[CONSOLE_STREAM_INDEX] = true;
 
     std::time(&g_logger._rawtime);
@@ -58,6 +1331,8 @@ void open_console_stream()
 
 void open_file_stream()
 {
+    std::lock_guard<std::mutex> lock(g_logger._stream_mutex);
+
     g_logger._open_streams[FILE_STREAM_INDEX] = true;
     g_logger._stream.open("log.txt", std::ios::app | std::ofstream::out);
 
@@ -67,8 +1342,35 @@ void open_file_stream()
     g_logger._stream << LOG_SEPERATOR;
 }
 
+bool open_binary_stream(const std::string& path, size_t file_size, uint32_t file_count)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_logger._stream_mutex);
+
+        BinaryStream& binary = g_logger._binary;
+
+        unmap_binary_file();
+
+        binary.path       = path;
+        binary.file_size  = std::max(file_size, size_t(4096));
+        binary.file_count = std::max(file_count, 1u);
+        binary.sequence   = 0;
+        binary.sites.clear();
+        binary.written.clear();
+
+        if (map_binary_file())
+            return true;
+    }
+
+    DW_LOG_ERROR("Failed to open binary log file: {}", path);
+
+    return false;
+}
+
 void open_custom_stream(CustomStreamCallback callback)
 {
+    std::lock_guard<std::mutex> lock(g_logger._stream_mutex);
+
     g_logger._open_streams[CUSTOM_STREAM_INDEX] = true;
     g_logger._callback                          = callback;
 
@@ -76,18 +1378,22 @@ void open_custom_stream(CustomStreamCallback callback)
 
     if (g_logger._callback)
     {
-        g_logger._callback(LOG_SEPERATOR, LEVEL_INFO);
+        call_custom_stream(LOG_SEPERATOR, LEVEL_INFO);
 
         std::string init_string = std::ctime(&g_logger._rawtime);
         init_string += "Log Started.\n";
 
-        g_logger._callback(init_string, LEVEL_INFO);
-        g_logger._callback(LOG_SEPERATOR, LEVEL_INFO);
+        call_custom_stream(init_string, LEVEL_INFO);
+        call_custom_stream(LOG_SEPERATOR, LEVEL_INFO);
     }
 }
 
 void close_console_stream()
 {
+    flush();
+
+    std::lock_guard<std::mutex> lock(g_logger._stream_mutex);
+
     g_logger._open_streams[CONSOLE_STREAM_INDEX] = false;
 
     std::time(&g_logger._rawtime);
@@ -98,6 +1404,10 @@ void close_console_stream()
 
 void close_file_stream()
 {
+    flush();
+
+    std::lock_guard<std::mutex> lock(g_logger._stream_mutex);
+
     g_logger._open_streams[FILE_STREAM_INDEX] = false;
 
     std::time(&g_logger._rawtime);
@@ -108,21 +1418,34 @@ void close_file_stream()
     g_logger._stream.close();
 }
 
+void close_binary_stream()
+{
+    flush();
+
+    std::lock_guard<std::mutex> lock(g_logger._stream_mutex);
+
+    unmap_binary_file();
+}
+
 void close_custom_stream()
 {
+    flush();
+
+    std::lock_guard<std::mutex> lock(g_logger._stream_mutex);
+
     g_logger._open_streams[CUSTOM_STREAM_INDEX] = false;
 
     std::time(&g_logger._rawtime);
 
     if (g_logger._callback)
     {
-        g_logger._callback(LOG_SEPERATOR, LEVEL_INFO);
+        call_custom_stream(LOG_SEPERATOR, LEVEL_INFO);
 
         std::string init_string = std::ctime(&g_logger._rawtime);
         init_string += "Log Ended.\n";
 
-        g_logger._callback(init_string, LEVEL_INFO);
-        g_logger._callback(LOG_SEPERATOR, LEVEL_INFO);
+        call_custom_stream(init_string, LEVEL_INFO);
+        call_custom_stream(LOG_SEPERATOR, LEVEL_INFO);
     }
 }
 
@@ -130,177 +1453,315 @@ void enable_debug_mode() { g_logger._debug = true; }
 
 void disable_debug_mode() { g_logger._debug = false; }
 
+void log_arguments(LogLevel level, const char* file, int line, std::string_view format, const Argument* arguments, uint32_t argument_count)
+{
+    submit(level, file, line, format, arguments, argument_count);
+}
+
 void log(std::string text, std::string file, int line, LogLevel level)
 {
-    std::lock_guard<std::mutex> lock(g_logger._log_mutex);
+    // The basename is copied into the queue, so it only has to live until submit() returns.
+    submit(level, file_name(file.c_str()), line, text, nullptr, 0);
+}
 
-    std::string file_with_extension = file.substr(file.find_last_of("/\\") + 1);
-    std::time(&g_logger._rawtime);
-    g_logger._timeinfo = std::localtime(&g_logger._rawtime);
-    std::strftime(g_logger._temp_buffer, 80, "%H:%M:%S", g_logger._timeinfo);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    std::string log_level_string;
+// Only uses the stack and plain system calls, no printf or locale, so it also works from a signal handler.
+static void write_crash_log(const char* reason)
+{
+    if (g_crash_path[0] == '\0')
+        return;
 
-    switch (level)
-    {
-        case LEVEL_INFO:
-        {
-            log_level_string = "INFO   ";
-            break;
-        }
-        case LEVEL_WARNING:
-        {
-            log_level_string = "WARNING";
-            break;
-        }
-        case LEVEL_ERR:
+#if defined(WIN32)
+    HANDLE file = CreateFileA(g_crash_path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+
+    auto write_line = [file](const char* data, size_t size) {
+        DWORD written;
+        WriteFile(file, data, DWORD(size), &written, nullptr);
+    };
+#else
+    int fd = open(g_crash_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd == -1)
+        return;
+
+    auto write_line = [fd](const char* data, size_t size) {
+        while (size > 0)
         {
-            log_level_string = "ERROR  ";
-            break;
+            ssize_t written = write(fd, data, size);
+
+            if (written <= 0)
+                return;
+
+            data += written;
+            size -= size_t(written);
         }
-        case LEVEL_FATAL:
+    };
+#endif
+
+    char        buffer[CRASH_LINE_SIZE];
+    CrashRecord record;
+    uint64_t    end   = g_crash_pos.load(std::memory_order_acquire);
+    uint64_t    begin = end > CRASH_RING_SIZE ? end - CRASH_RING_SIZE : 0;
+
+    {
+        FixedBuffer line = { buffer, sizeof(buffer) };
+        line += LOG_SEPERATOR;
+        line += reason;
+        line += ", last messages:\n";
+        line += LOG_SEPERATOR;
+        write_line(line.data, line.size);
+    }
+
+    for (uint64_t pos = begin; pos < end; pos++)
+    {
+        const CrashRecord& slot = g_crash_ring[pos % CRASH_RING_SIZE];
+
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+            continue;
+
+        record.time           = slot.time;
+        record.level          = slot.level;
+        record.line           = slot.line;
+        record.simple         = slot.simple;
+        record.argument_count = std::min(slot.argument_count, uint32_t(LOG_MAX_ARGUMENTS));
+        record.format_size    = std::min(slot.format_size, uint32_t(CRASH_TEXT_SIZE));
+        std::memcpy(record.arguments, slot.arguments, sizeof(record.arguments));
+        std::memcpy(record.file, slot.file, sizeof(record.file));
+        std::memcpy(record.text, slot.text, sizeof(record.text));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Overwritten while copying.
+        if (slot.sequence.load(std::memory_order_relaxed) != pos + 1)
+            continue;
+
+        for (uint32_t i = 0; i < record.argument_count; i++)
         {
-            log_level_string = "FATAL  ";
-            break;
+            if (record.arguments[i].type == Argument::TYPE_STRING)
+                record.arguments[i].str.data = record.text + (record.arguments[i].str.data - slot.text);
         }
-    }
 
-    std::string output;
+        record.file[CRASH_FILE_SIZE - 1] = '\0';
 
-    if ((g_logger._verbosity & VERBOSITY_TIMESTAMP) || (g_logger._verbosity & VERBOSITY_LEVEL))
-    {
-        output = "[ ";
+        // strftime() and localtime() may lock, the offset to UTC is taken when the handler is installed instead.
+        long seconds = long((record.time + g_crash_utc_offset) % 86400);
 
-        if (g_logger._verbosity & VERBOSITY_TIMESTAMP)
-            output += g_logger._temp_buffer;
+        if (seconds < 0)
+            seconds += 86400;
 
-        if ((g_logger._verbosity & VERBOSITY_TIMESTAMP) && (g_logger._verbosity & VERBOSITY_LEVEL))
-            output += " | ";
+        FixedBuffer line = { buffer, sizeof(buffer) - 1 };
+        line += "[ ";
+        append_unsigned(line, uint64_t(seconds / 3600), 10, false, 2);
+        line += ':';
+        append_unsigned(line, uint64_t((seconds / 60) % 60), 10, false, 2);
+        line += ':';
+        append_unsigned(line, uint64_t(seconds % 60), 10, false, 2);
+        line += " | ";
+        line += level_string(record.level);
+        line += " ] : ";
+        format_message(line, std::string_view(record.text, record.format_size), record.arguments, record.argument_count, true);
 
-        if (g_logger._verbosity & VERBOSITY_LEVEL)
-            output += log_level_string;
+        if (!record.simple)
+        {
+            line += " , FILE : ";
+            line += record.file;
+            line += " , LINE : ";
 
-        output += " ] : ";
-    }
+            if (record.line < 0)
+                line += '-';
 
-    output += text;
+            append_unsigned(line, uint64_t(record.line < 0 ? -int64_t(record.line) : record.line));
+        }
 
-    if (g_logger._verbosity & VERBOSITY_FILE)
-    {
-        output += " , FILE : ";
-        output += file_with_extension;
+        buffer[line.size++] = '\n';
+        write_line(line.data, line.size);
     }
 
-    if (g_logger._verbosity & VERBOSITY_LINE)
-    {
-        output += " , LINE : ";
-        output += std::to_string(line);
-    }
+#if defined(WIN32)
+    CloseHandle(file);
+#else
+    close(fd);
+#endif
+}
 
-    if (g_logger._open_streams[FILE_STREAM_INDEX])
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(WIN32)
+static LONG WINAPI crash_handler(EXCEPTION_POINTERS* exception)
+{
+    if (!g_crashing.exchange(true))
     {
-        g_logger._stream << output << "\n";
+        char        reason[64];
+        FixedBuffer text = { reason, sizeof(reason) - 1 };
+        text += "Unhandled exception 0x";
+        append_unsigned(text, uint64_t(exception->ExceptionRecord->ExceptionCode), 16, false, 8);
+        reason[text.size] = '\0';
+        write_crash_log(reason);
     }
 
-    if (g_logger._open_streams[CONSOLE_STREAM_INDEX])
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+#else
+static const int        kCrashSignals[] = { SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS };
+static struct sigaction g_previous_actions[sizeof(kCrashSignals) / sizeof(kCrashSignals[0])];
+
+// The handler runs on its own stack so that a stack overflow can still be logged. Alternate stacks are per thread, this one
+// belongs to the thread that installed the handler.
+static char g_crash_stack[CRASH_STACK_SIZE];
+
+static void crash_handler(int signal)
+{
+    if (!g_crashing.exchange(true))
     {
-        std::cout << output << "\n";
+        char        reason[64];
+        FixedBuffer text = { reason, sizeof(reason) - 1 };
+        text += "Crashed with signal ";
+        append_unsigned(text, uint64_t(signal));
+        reason[text.size] = '\0';
+        write_crash_log(reason);
     }
 
-    if (g_logger._open_streams[CUSTOM_STREAM_INDEX] && g_logger._callback)
+    // Hand the signal on to whoever handled it before, or the default action.
+    for (size_t i = 0; i < sizeof(kCrashSignals) / sizeof(kCrashSignals[0]); i++)
     {
-        g_logger._callback(output, level);
+        if (kCrashSignals[i] == signal)
+            sigaction(signal, &g_previous_actions[i], nullptr);
     }
 
-    // Flush stream if error
-    if (level == LEVEL_ERR || level == LEVEL_FATAL || g_logger._debug)
-        flush();
+    raise(signal);
 }
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-void log_simple(std::string text, LogLevel level)
+void install_crash_handler(const std::string& path)
 {
-    std::lock_guard<std::mutex> lock(g_logger._log_mutex);
+    std::snprintf(g_crash_path, sizeof(g_crash_path), "%s", path.c_str());
 
-    std::time(&g_logger._rawtime);
-    g_logger._timeinfo = std::localtime(&g_logger._rawtime);
-    std::strftime(g_logger._temp_buffer, 80, "%H:%M:%S", g_logger._timeinfo);
+    std::time_t now   = std::time(nullptr);
+    std::tm     local = *std::localtime(&now);
+    std::tm     utc   = *std::gmtime(&now);
 
-    std::string log_level_string;
+    g_crash_utc_offset = (local.tm_hour - utc.tm_hour) * 3600 + (local.tm_min - utc.tm_min) * 60;
 
-    switch (level)
-    {
-        case LEVEL_INFO:
-        {
-            log_level_string = "INFO   ";
-            break;
-        }
-        case LEVEL_WARNING:
-        {
-            log_level_string = "WARNING";
-            break;
-        }
-        case LEVEL_ERR:
-        {
-            log_level_string = "ERROR  ";
-            break;
-        }
-        case LEVEL_FATAL:
-        {
-            log_level_string = "FATAL  ";
-            break;
-        }
-    }
+    if (g_crash_utc_offset > 12 * 3600)
+        g_crash_utc_offset -= 24 * 3600;
+    else if (g_crash_utc_offset < -12 * 3600)
+        g_crash_utc_offset += 24 * 3600;
 
-    std::string output;
+    g_crash_utc_offset += 24 * 3600; // Keeps the time of day positive.
+
+#if defined(WIN32)
+    SetUnhandledExceptionFilter(crash_handler);
+#else
+    stack_t stack  = {};
+    stack.ss_sp    = g_crash_stack;
+    stack.ss_size  = sizeof(g_crash_stack);
+    stack.ss_flags = 0;
+
+    if (sigaltstack(&stack, nullptr) != 0)
+        std::cerr << "Failed to install the crash handler stack, stack overflows will not be logged.\n";
+
+    struct sigaction action = {};
+    action.sa_handler       = crash_handler;
+    action.sa_flags         = SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+
+    for (size_t i = 0; i < sizeof(kCrashSignals) / sizeof(kCrashSignals[0]); i++)
+        sigaction(kCrashSignals[i], &action, &g_previous_actions[i]);
+#endif
+}
+
+void dump_crash_log()
+{
+    if (!g_crashing.load())
+        write_crash_log("Fatal error");
+}
+
+bool decode_binary_log(const std::string& path, std::ostream& output)
+{
+    std::vector<std::pair<uint32_t, std::string>> files;
 
-    if ((g_logger._verbosity & VERBOSITY_TIMESTAMP) || (g_logger._verbosity & VERBOSITY_LEVEL))
+    for (uint32_t i = 0;; i++)
     {
-        output = "[ ";
+        std::ifstream file(path + "." + std::to_string(i), std::ios::binary);
 
-        if (g_logger._verbosity & VERBOSITY_TIMESTAMP)
-            output += g_logger._temp_buffer;
+        if (!file)
+            break;
 
-        if ((g_logger._verbosity & VERBOSITY_TIMESTAMP) && (g_logger._verbosity & VERBOSITY_LEVEL))
-            output += " | ";
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 
-        if (g_logger._verbosity & VERBOSITY_LEVEL)
-            output += log_level_string;
+        if (data.size() < sizeof(BinaryHeader) || std::memcmp(data.data(), BINARY_LOG_MAGIC, 8) != 0 || reinterpret_cast<const BinaryHeader*>(data.data())->version != BINARY_LOG_VERSION)
+        {
+            output << "Skipping " << path << "." << i << ", not a binary log file.\n";
+            continue;
+        }
 
-        output += " ] : ";
+        files.emplace_back(reinterpret_cast<const BinaryHeader*>(data.data())->sequence, std::move(data));
     }
 
-    output += text;
+    std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
 
-    if (g_logger._open_streams[FILE_STREAM_INDEX])
+    bool success = !files.empty();
+
+    for (auto& file : files)
     {
-        g_logger._stream << output << "\n";
+        if (!decode_binary_file(file.second, output))
+        {
+            output << "Malformed record in binary log file " << file.first << ", skipping the rest of it.\n";
+            success = false;
+        }
     }
 
-    if (g_logger._open_streams[CONSOLE_STREAM_INDEX])
+    return success;
+}
+
+void flush()
+{
+    // Called from a custom stream callback, which runs with the stream lock held. Whatever is queued will follow shortly anyway.
+    if (t_in_callback)
     {
-        std::cout << output << "\n";
+        if (g_logger._open_streams[FILE_STREAM_INDEX])
+            g_logger._stream.flush();
+
+        return;
     }
 
-    if (g_logger._open_streams[CUSTOM_STREAM_INDEX] && g_logger._callback)
+    if (!g_logger._running.load(std::memory_order_acquire))
     {
-        g_logger._callback(output, level);
-    }
-}
+        std::lock_guard<std::mutex> lock(g_logger._stream_mutex);
 
-void log_info(std::string text) { log_simple(text, LEVEL_INFO); }
+        if (g_logger._open_streams[FILE_STREAM_INDEX])
+            g_logger._stream.flush();
 
-void log_error(std::string text) { log_simple(text, LEVEL_ERR); }
+        return;
+    }
 
-void log_warning(std::string text) { log_simple(text, LEVEL_WARNING); }
+    uint64_t target = g_logger._enqueue_pos.load(std::memory_order_acquire);
 
-void log_fatal(std::string text) { log_simple(text, LEVEL_FATAL); }
+    std::unique_lock<std::mutex> lock(g_logger._wake_mutex);
 
-void flush()
-{
-    if (g_logger._open_streams[FILE_STREAM_INDEX])
+    if (g_logger._flushed_pos >= target)
     {
-        g_logger._stream.flush();
+        lock.unlock();
+
+        std::lock_guard<std::mutex> stream_lock(g_logger._stream_mutex);
+
+        if (g_logger._open_streams[FILE_STREAM_INDEX])
+            g_logger._stream.flush();
+
+        return;
     }
+
+    g_logger._flush_target = std::max(g_logger._flush_target, target);
+    g_logger._wake         = true;
+    g_logger._wake_cv.notify_one();
+
+    g_logger._flushed_cv.wait(lock, [target] { return g_logger._flushed_pos >= target || !g_logger._running.load(std::memory_order_acquire); });
 }
 } // namespace logger
 } // namespace dw
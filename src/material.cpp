@@ -5,11 +5,93 @@
 #include <assimp/scene.h>
 #if defined(DWSF_VULKAN)
 #    include <vk_mem_alloc.h>
+#    include <algorithm>
+#    include <deque>
+#else
+#    include <texture_streamer.h>
 #endif
 
+#define MAX_HEAP_MATERIALS 4096
+#define MAX_HEAP_TEXTURES 2048
+#define HEAP_MATERIAL_DATA_SIZE (sizeof(MaterialData) * MAX_HEAP_MATERIALS)
+
 namespace dw
 {
-std::unordered_map<std::string, std::weak_ptr<Material>> Material::m_cache;
+#if defined(DWSF_VULKAN)
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Must match the Material struct in the ray tracing shaders and assets/shaders/material_heap.glsl (std430).
+struct MaterialData
+{
+    glm::ivec4 texture_indices0 = glm::ivec4(-1); // x: albedo, y: normals, z: roughness, w: metallic
+    glm::ivec4 texture_indices1 = glm::ivec4(-1); // x: emissive, z: roughness_channel, w: metallic_channel
+    glm::vec4  albedo;
+    glm::vec4  emissive;
+    glm::vec4  roughness_metallic;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct MaterialHeap
+{
+    std::weak_ptr<vk::Backend>                  backend;
+    vk::DescriptorPool::Ptr                     descriptor_pool;
+    vk::DescriptorSetLayout::Ptr                ds_layout;
+    vk::DescriptorSet::Ptr                      ds[vk::Backend::kMaxFramesInFlight]; // Per frame in flight, each with its own copy of the material data.
+    vk::Buffer::Ptr                             material_data_buffer;
+    std::vector<MaterialData>                   material_datas;                                   // Latest material data, copied to each frame as it comes up.
+    std::vector<uint32_t>                       dirty_materials[vk::Backend::kMaxFramesInFlight]; // Slots whose copy in that frame is stale.
+    uint32_t                                    material_count = 0;
+    uint32_t                                    texture_count  = 0;
+    uint32_t                                    max_textures   = 0;
+    std::vector<uint32_t>                       free_materials;
+    std::vector<uint32_t>                       free_textures;
+    std::deque<std::pair<uint32_t, uint32_t>>   pending_materials; // Freed slots along with the frame they were freed in.
+    std::deque<std::pair<uint32_t, uint32_t>>   pending_textures;
+    std::unordered_map<VkImageView, glm::uvec2> texture_slots; // x: slot, y: reference count
+};
+
+static MaterialHeap g_heap;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void recycle_heap_slots(vk::Backend::Ptr backend, std::deque<std::pair<uint32_t, uint32_t>>& pending, std::vector<uint32_t>& free_list)
+{
+    // Slots can only be reused once every frame that could still be reading them has finished.
+    while (!pending.empty())
+    {
+        auto front = pending.front();
+
+        if (backend->is_frame_done(front.second))
+        {
+            free_list.push_back(front.first);
+            pending.pop_front();
+        }
+        else
+            return;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static int32_t allocate_heap_slot(std::vector<uint32_t>& free_list, uint32_t& count, uint32_t max_count)
+{
+    if (!free_list.empty())
+    {
+        uint32_t slot = free_list.back();
+        free_list.pop_back();
+        return slot;
+    }
+    else if (count < max_count)
+        return count++;
+    else
+        return -1;
+}
+
+#endif
+
+std::unordered_map<uint64_t, Material::CacheEntry> Material::m_cache;
 
 #if defined(DWSF_VULKAN)
 std::unordered_map<std::string, std::weak_ptr<vk::Image>>     Material::m_image_cache;
@@ -20,12 +102,29 @@ vk::Image::Ptr                                                Material::m_defaul
 vk::ImageView::Ptr                                            Material::m_default_image_view;
 #else
 std::unordered_map<std::string, std::weak_ptr<gl::Texture2D>> Material::m_texture_cache;
+std::shared_ptr<TextureStreamer>                               Material::m_texture_streamer;
 #endif
 
 static uint32_t g_last_mat_idx = 0;
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+// 64-bit FNV-1a.
+static uint64_t fnv1a(const std::string& data)
+{
+    uint64_t h = 14695981039346656037ull;
+
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        h ^= uint8_t(data[i]);
+        h *= 1099511628211ull;
+    }
+
+    return h;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 Material::Ptr Material::load(
 #if defined(DWSF_VULKAN)
     vk::Backend::Ptr backend,
@@ -35,19 +134,21 @@ Material::Ptr Material::load(
     const int32_t&                  normal_idx,
     const glm::ivec2&               roughness_idx,
     const glm::ivec2&               metallic_idx,
-    const int32_t&                  emissive_idx)
+    const int32_t&                  emissive_idx,
+    const glm::vec4&                albedo_value,
+    const float&                    roughness_value,
+    const float&                    metallic_value,
+    const glm::vec3&                emissive_value)
 {
-    std::string mat_id;
+    std::string parameters = parameter_block(textures, albedo_idx, normal_idx, roughness_idx, metallic_idx, emissive_idx, albedo_value, roughness_value, metallic_value, emissive_value);
+    uint64_t    key        = fnv1a(parameters);
 
-    if (textures.empty())
-        mat_id = "Untextured_Material_" + std::to_string(rand());
-    else
-    {
-        for (auto path : textures)
-            mat_id += path;
-    }
+    auto          it     = m_cache.find(key);
+    Material::Ptr cached = it != m_cache.end() ? it->second.material.lock() : nullptr;
 
-    if (m_cache.find(mat_id) == m_cache.end() || m_cache[mat_id].expired())
+    if (cached && it->second.parameters == parameters)
+        return cached;
+    else
     {
         Material::Ptr mat = std::shared_ptr<Material>(new Material(
 #if defined(DWSF_VULKAN)
@@ -59,11 +160,96 @@ Material::Ptr Material::load(
             roughness_idx,
             metallic_idx,
             emissive_idx));
-        m_cache[mat_id] = mat;
+
+        mat->m_key            = key;
+        mat->m_albedo_color   = albedo_value;
+        mat->m_roughness      = roughness_value;
+        mat->m_metallic       = metallic_value;
+        mat->m_emissive_color = emissive_value;
+
+#if defined(DWSF_VULKAN)
+        mat->write_heap_data();
+#endif
+
+        // A different parameter block with the same key keeps its entry, this material is then not shared.
+        if (cached)
+            mat->m_key = 0;
+        else
+            m_cache[key] = { parameters, mat };
+
         return mat;
     }
-    else
-        return m_cache[mat_id].lock();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t Material::hash(const std::vector<std::string>& textures,
+                        const int32_t&                  albedo_idx,
+                        const int32_t&                  normal_idx,
+                        const glm::ivec2&               roughness_idx,
+                        const glm::ivec2&               metallic_idx,
+                        const int32_t&                  emissive_idx,
+                        const glm::vec4&                albedo_value,
+                        const float&                    roughness_value,
+                        const float&                    metallic_value,
+                        const glm::vec3&                emissive_value)
+{
+    return fnv1a(parameter_block(textures, albedo_idx, normal_idx, roughness_idx, metallic_idx, emissive_idx, albedo_value, roughness_value, metallic_value, emissive_value));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::string Material::parameter_block(const std::vector<std::string>& textures,
+                                      const int32_t&                  albedo_idx,
+                                      const int32_t&                  normal_idx,
+                                      const glm::ivec2&               roughness_idx,
+                                      const glm::ivec2&               metallic_idx,
+                                      const int32_t&                  emissive_idx,
+                                      const glm::vec4&                albedo_value,
+                                      const float&                    roughness_value,
+                                      const float&                    metallic_value,
+                                      const glm::vec3&                emissive_value)
+{
+    std::string block;
+
+    auto append_bytes = [&block](const void* data, size_t size) {
+        block.append((const char*)data, size);
+    };
+
+    // Textures are identified by path, which is also the key of the texture cache. Unused or empty slots add a zero-length entry.
+    auto append_texture = [&](int32_t idx, int32_t channel) {
+        uint32_t length = 0;
+
+        if (idx != -1 && textures[idx].size() > 0)
+        {
+            length = textures[idx].size();
+            append_bytes(&length, sizeof(uint32_t));
+            append_bytes(textures[idx].data(), length);
+        }
+        else
+            append_bytes(&length, sizeof(uint32_t));
+
+        append_bytes(&channel, sizeof(int32_t));
+    };
+
+    append_texture(albedo_idx, 0);
+    append_texture(normal_idx, 0);
+    append_texture(roughness_idx.x, roughness_idx.y);
+    append_texture(metallic_idx.x, metallic_idx.y);
+    append_texture(emissive_idx, 0);
+
+    // Adding zero folds -0.0 into +0.0 so that both produce the same key.
+    glm::vec4 albedo    = albedo_value + glm::vec4(0.0f);
+    float     roughness = roughness_value + 0.0f;
+    float     metallic  = metallic_value + 0.0f;
+    glm::vec3 emissive  = emissive_value + glm::vec3(0.0f);
+
+    append_bytes(&albedo, sizeof(glm::vec4));
+    append_bytes(&roughness, sizeof(float));
+    append_bytes(&metallic, sizeof(float));
+    append_bytes(&emissive, sizeof(glm::vec3));
+
+    return block;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -77,6 +263,10 @@ Material::Ptr Material::create(glm::vec4 albedo, float roughness, float metallic
     mat->m_metallic       = metallic;
     mat->m_emissive_color = emissive;
 
+#if defined(DWSF_VULKAN)
+    mat->write_heap_data();
+#endif
+
     return mat;
 }
 
@@ -85,19 +275,112 @@ Material::Ptr Material::create(glm::vec4 albedo, float roughness, float metallic
 Material::Material()
 {
     m_id = g_last_mat_idx++;
+
+#if defined(DWSF_VULKAN)
+    allocate_heap_slots();
+#endif
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-bool Material::is_loaded(const std::string& name)
+bool Material::is_loaded(const uint64_t& key)
 {
-    return m_cache.find(name) != m_cache.end();
+    auto it = m_cache.find(key);
+    return it != m_cache.end() && !it->second.material.expired();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 Material::~Material()
 {
+#if defined(DWSF_VULKAN)
+    free_heap_slots();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Material::Ptr Material::clone()
+{
+    Material::Ptr mat = std::shared_ptr<Material>(new Material(*this));
+
+    mat->m_id  = g_last_mat_idx++;
+    mat->m_key = 0;
+
+#if defined(DWSF_VULKAN)
+    // The copy shares the textures and their heap slots but needs a parameter slot of its own.
+    mat->m_heap_idx = -1;
+
+    for (uint32_t i = 0; i < 5; i++)
+        mat->m_heap_texture_indices[i] = -1;
+
+    mat->allocate_heap_slots();
+#endif
+
+    return mat;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::remove_from_cache()
+{
+    if (m_key == 0)
+        return;
+
+    auto it = m_cache.find(m_key);
+
+    if (it != m_cache.end() && it->second.material.lock().get() == this)
+        m_cache.erase(it);
+
+    m_key = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::set_albedo_value(const glm::vec4& value)
+{
+    remove_from_cache();
+    m_albedo_color = value;
+
+#if defined(DWSF_VULKAN)
+    write_heap_data();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::set_roughness_value(const float& value)
+{
+    remove_from_cache();
+    m_roughness = value;
+
+#if defined(DWSF_VULKAN)
+    write_heap_data();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::set_metallic_value(const float& value)
+{
+    remove_from_cache();
+    m_metallic = value;
+
+#if defined(DWSF_VULKAN)
+    write_heap_data();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::set_emissive_value(const glm::vec3& value)
+{
+    remove_from_cache();
+    m_emissive_color = value;
+
+#if defined(DWSF_VULKAN)
+    write_heap_data();
+#endif
 }
 
 #if defined(DWSF_VULKAN)
@@ -122,7 +405,7 @@ Material::Material(vk::Backend::Ptr backend, const std::vector<std::string>& tex
             m_image_views.push_back(image_view);
         }
         else
-            DW_LOG_ERROR("Failed to load image: " + textures[albedo_idx]);
+            DW_LOG_ERROR("Failed to load image: {}", textures[albedo_idx]);
     }
 
     if (normal_idx != -1 && textures[normal_idx].size() > 0)
@@ -138,7 +421,7 @@ Material::Material(vk::Backend::Ptr backend, const std::vector<std::string>& tex
             m_image_views.push_back(image_view);
         }
         else
-            DW_LOG_ERROR("Failed to load image: " + textures[normal_idx]);
+            DW_LOG_ERROR("Failed to load image: {}", textures[normal_idx]);
     }
 
     if (roughness_idx.x != -1 && textures[roughness_idx.x].size() > 0)
@@ -154,7 +437,7 @@ Material::Material(vk::Backend::Ptr backend, const std::vector<std::string>& tex
             m_image_views.push_back(image_view);
         }
         else
-            DW_LOG_ERROR("Failed to load image: " + textures[roughness_idx.x]);
+            DW_LOG_ERROR("Failed to load image: {}", textures[roughness_idx.x]);
     }
 
     if (metallic_idx.x != -1 && textures[metallic_idx.x].size() > 0)
@@ -170,7 +453,7 @@ Material::Material(vk::Backend::Ptr backend, const std::vector<std::string>& tex
             m_image_views.push_back(image_view);
         }
         else
-            DW_LOG_ERROR("Failed to load image: " + textures[metallic_idx.x]);
+            DW_LOG_ERROR("Failed to load image: {}", textures[metallic_idx.x]);
     }
 
     if (emissive_idx != -1 && textures[emissive_idx].size() > 0)
@@ -186,11 +469,13 @@ Material::Material(vk::Backend::Ptr backend, const std::vector<std::string>& tex
             m_image_views.push_back(image_view);
         }
         else
-            DW_LOG_ERROR("Failed to load image: " + textures[emissive_idx]);
+            DW_LOG_ERROR("Failed to load image: {}", textures[emissive_idx]);
     }
 
     // Create descriptor set
     m_descriptor_set = create_descriptor_set(backend);
+
+    allocate_heap_slots();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -231,12 +516,143 @@ void Material::initialize_common_resources(vk::Backend::Ptr backend)
 
     m_default_image      = vk::Image::create(backend, VK_IMAGE_TYPE_2D, 1, 1, 1, 1, 1, VK_FORMAT_R8G8B8A8_SNORM, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, sizeof(uint8_t) * 4, data);
     m_default_image_view = vk::ImageView::create(backend, m_default_image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    // Bindless material heap. Needs descriptor indexing with update-after-bind sampled images, without it materials are only
+    // available through their own descriptor sets.
+    const VkPhysicalDeviceVulkan12Features&             features   = backend->device_features12();
+    const VkPhysicalDeviceDescriptorIndexingProperties& properties = backend->descriptor_indexing_properties();
+
+    uint32_t max_textures = std::min({ uint32_t(MAX_HEAP_TEXTURES),
+                                       properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                       properties.maxDescriptorSetUpdateAfterBindSamplers,
+                                       properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                       properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                       properties.maxUpdateAfterBindDescriptorsInAllPools / vk::Backend::kMaxFramesInFlight - 1 });
+
+    if (!features.runtimeDescriptorArray || !features.descriptorBindingPartiallyBound || !features.descriptorBindingSampledImageUpdateAfterBind || !features.shaderSampledImageArrayNonUniformIndexing || max_textures == 0)
+    {
+        DW_LOG_WARNING("Descriptor indexing is not supported, the bindless material heap is disabled.");
+        return;
+    }
+
+    g_heap.backend      = backend;
+    g_heap.max_textures = max_textures;
+
+    // The ray tracing stages can only be used once the extension is enabled.
+    VkShaderStageFlags heap_stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+    if (backend->ray_tracing_enabled())
+        heap_stages |= VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
+
+    vk::DescriptorPool::Desc dp_desc;
+
+    dp_desc.set_max_sets(vk::Backend::kMaxFramesInFlight)
+        .set_create_flags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT)
+        .add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vk::Backend::kMaxFramesInFlight)
+        .add_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max_textures * vk::Backend::kMaxFramesInFlight);
+
+    g_heap.descriptor_pool = vk::DescriptorPool::create(backend, dp_desc);
+    g_heap.descriptor_pool->set_name("Material Heap Descriptor Pool");
+
+    std::vector<VkDescriptorBindingFlags> descriptor_binding_flags = {
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo set_layout_binding_flags;
+    DW_ZERO_MEMORY(set_layout_binding_flags);
+
+    set_layout_binding_flags.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    set_layout_binding_flags.bindingCount  = 2;
+    set_layout_binding_flags.pBindingFlags = descriptor_binding_flags.data();
+
+    vk::DescriptorSetLayout::Desc heap_ds_layout_desc;
+
+    heap_ds_layout_desc.set_next_ptr(&set_layout_binding_flags);
+    heap_ds_layout_desc.set_create_flags(VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+    // Material Data
+    heap_ds_layout_desc.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, heap_stages);
+    // Textures
+    heap_ds_layout_desc.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max_textures, heap_stages);
+
+    g_heap.ds_layout = vk::DescriptorSetLayout::create(backend, heap_ds_layout_desc);
+    g_heap.ds_layout->set_name("Material Heap Descriptor Set Layout");
+
+    // The material data of the frames in flight lives back to back in one buffer.
+    g_heap.material_data_buffer = vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, HEAP_MATERIAL_DATA_SIZE * vk::Backend::kMaxFramesInFlight, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    g_heap.material_data_buffer->set_name("Material Heap Data Buffer");
+
+    g_heap.material_datas.resize(MAX_HEAP_MATERIALS);
+
+    for (uint32_t i = 0; i < vk::Backend::kMaxFramesInFlight; i++)
+    {
+        g_heap.ds[i] = vk::DescriptorSet::create(backend, g_heap.ds_layout, g_heap.descriptor_pool);
+        g_heap.ds[i]->set_name("Material Heap Descriptor Set " + std::to_string(i));
+
+        VkDescriptorBufferInfo buffer_info;
+
+        buffer_info.buffer = g_heap.material_data_buffer->handle();
+        buffer_info.offset = HEAP_MATERIAL_DATA_SIZE * i;
+        buffer_info.range  = HEAP_MATERIAL_DATA_SIZE;
+
+        VkWriteDescriptorSet write_data;
+        DW_ZERO_MEMORY(write_data);
+
+        write_data.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data.descriptorCount = 1;
+        write_data.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write_data.pBufferInfo     = &buffer_info;
+        write_data.dstBinding      = 0;
+        write_data.dstSet          = g_heap.ds[i]->handle();
+
+        vkUpdateDescriptorSets(backend->device(), 1, &write_data, 0, nullptr);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::update_heap()
+{
+    auto backend = g_heap.backend.lock();
+
+    if (!backend)
+        return;
+
+    uint32_t frame = backend->current_frame_idx();
+
+    MaterialData* material_datas = (MaterialData*)((uint8_t*)g_heap.material_data_buffer->mapped_ptr() + HEAP_MATERIAL_DATA_SIZE * frame);
+
+    for (uint32_t idx : g_heap.dirty_materials[frame])
+        material_datas[idx] = g_heap.material_datas[idx];
+
+    g_heap.dirty_materials[frame].clear();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void Material::shutdown_common_resources()
 {
+    g_heap.material_data_buffer.reset();
+    g_heap.material_datas.clear();
+
+    for (uint32_t i = 0; i < vk::Backend::kMaxFramesInFlight; i++)
+    {
+        g_heap.ds[i].reset();
+        g_heap.dirty_materials[i].clear();
+    }
+
+    g_heap.ds_layout.reset();
+    g_heap.descriptor_pool.reset();
+    g_heap.backend.reset();
+    g_heap.material_count = 0;
+    g_heap.texture_count  = 0;
+    g_heap.max_textures   = 0;
+    g_heap.free_materials.clear();
+    g_heap.free_textures.clear();
+    g_heap.pending_materials.clear();
+    g_heap.pending_textures.clear();
+    g_heap.texture_slots.clear();
+
     m_default_image_view.reset();
     m_default_image.reset();
     m_common_ds_layout.reset();
@@ -353,6 +769,182 @@ vk::DescriptorSet::Ptr Material::create_descriptor_set(vk::Backend::Ptr backend)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+vk::DescriptorSetLayout::Ptr Material::heap_descriptor_set_layout()
+{
+    return g_heap.ds_layout;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+vk::DescriptorSet::Ptr Material::heap_descriptor_set()
+{
+    auto backend = g_heap.backend.lock();
+
+    if (!backend)
+        return nullptr;
+
+    return g_heap.ds[backend->current_frame_idx()];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::allocate_heap_slots()
+{
+    auto backend = g_heap.backend.lock();
+
+    if (!backend)
+        return;
+
+    recycle_heap_slots(backend, g_heap.pending_materials, g_heap.free_materials);
+    recycle_heap_slots(backend, g_heap.pending_textures, g_heap.free_textures);
+
+    m_heap_idx = allocate_heap_slot(g_heap.free_materials, g_heap.material_count, MAX_HEAP_MATERIALS);
+
+    if (m_heap_idx == -1)
+    {
+        DW_LOG_ERROR("Material heap is full, material {} will not be available for bindless rendering.", m_id);
+        return;
+    }
+
+    vk::ImageView::Ptr image_views[] = { albedo_image_view(), normal_image_view(), roughness_image_view(), metallic_image_view(), emissive_image_view() };
+
+    std::vector<VkDescriptorImageInfo> image_infos;
+    std::vector<VkWriteDescriptorSet>  write_datas;
+
+    image_infos.reserve(5);
+
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        if (!image_views[i])
+            continue;
+
+        VkImageView handle = image_views[i]->handle();
+        auto        it     = g_heap.texture_slots.find(handle);
+
+        // Textures shared between materials share a single slot.
+        if (it != g_heap.texture_slots.end())
+        {
+            it->second.y++;
+            m_heap_texture_indices[i] = it->second.x;
+            continue;
+        }
+
+        int32_t slot = allocate_heap_slot(g_heap.free_textures, g_heap.texture_count, g_heap.max_textures);
+
+        if (slot == -1)
+        {
+            DW_LOG_ERROR("Material heap texture array is full.");
+            continue;
+        }
+
+        g_heap.texture_slots[handle] = glm::uvec2(slot, 1);
+        m_heap_texture_indices[i]    = slot;
+
+        VkDescriptorImageInfo image_info;
+
+        image_info.sampler     = m_common_sampler->handle();
+        image_info.imageView   = handle;
+        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        image_infos.push_back(image_info);
+
+        VkWriteDescriptorSet write_data;
+        DW_ZERO_MEMORY(write_data);
+
+        write_data.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data.descriptorCount = 1;
+        write_data.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write_data.pImageInfo      = &image_infos.back();
+        write_data.dstBinding      = 1;
+        write_data.dstArrayElement = slot;
+
+        write_datas.push_back(write_data);
+    }
+
+    // Texture slots are not in use by any frame in flight, so all the sets can be updated right away.
+    if (write_datas.size() > 0)
+    {
+        for (uint32_t i = 0; i < vk::Backend::kMaxFramesInFlight; i++)
+        {
+            for (auto& write_data : write_datas)
+                write_data.dstSet = g_heap.ds[i]->handle();
+
+            vkUpdateDescriptorSets(backend->device(), write_datas.size(), write_datas.data(), 0, nullptr);
+        }
+    }
+
+    write_heap_data();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::free_heap_slots()
+{
+    auto backend = g_heap.backend.lock();
+
+    if (!backend || m_heap_idx == -1)
+        return;
+
+    uint32_t frame = backend->current_frame_idx();
+
+    g_heap.pending_materials.push_back({ m_heap_idx, frame });
+    m_heap_idx = -1;
+
+    vk::ImageView::Ptr image_views[] = { albedo_image_view(), normal_image_view(), roughness_image_view(), metallic_image_view(), emissive_image_view() };
+
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        if (!image_views[i] || m_heap_texture_indices[i] == -1)
+            continue;
+
+        auto it = g_heap.texture_slots.find(image_views[i]->handle());
+
+        if (it != g_heap.texture_slots.end() && --it->second.y == 0)
+        {
+            g_heap.pending_textures.push_back({ it->second.x, frame });
+            g_heap.texture_slots.erase(it);
+        }
+
+        m_heap_texture_indices[i] = -1;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::write_heap_data()
+{
+    auto backend = g_heap.backend.lock();
+
+    if (!backend || !g_heap.material_data_buffer || m_heap_idx == -1)
+        return;
+
+    MaterialData material_data;
+
+    // Covert from sRGB to Linear
+    material_data.albedo             = glm::vec4(glm::pow(glm::vec3(m_albedo_color), glm::vec3(2.2f)), m_albedo_color.a);
+    material_data.emissive           = glm::vec4(m_emissive_color, 0.0f);
+    material_data.roughness_metallic = glm::vec4(m_roughness, m_metallic, 0.0f, 0.0f);
+    material_data.texture_indices0   = glm::ivec4(m_heap_texture_indices[0], m_heap_texture_indices[1], m_heap_texture_indices[2], m_heap_texture_indices[3]);
+    material_data.texture_indices1   = glm::ivec4(m_heap_texture_indices[4], -1, m_roughness_channel, m_metallic_channel);
+
+    g_heap.material_datas[m_heap_idx] = material_data;
+
+    // Only the copy of the frame being recorded can be written right away, the others may still be read by frames in flight
+    // and are brought up to date by update_heap().
+    uint32_t frame = backend->current_frame_idx();
+
+    MaterialData* material_datas = (MaterialData*)((uint8_t*)g_heap.material_data_buffer->mapped_ptr() + HEAP_MATERIAL_DATA_SIZE * frame);
+    material_datas[m_heap_idx]   = material_data;
+
+    for (uint32_t i = 0; i < vk::Backend::kMaxFramesInFlight; i++)
+    {
+        if (i != frame)
+            g_heap.dirty_materials[i].push_back(m_heap_idx);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 #else
 
 Material::Material(const std::vector<std::string>& textures, const int32_t& albedo_idx, const int32_t& normal_idx, const glm::ivec2& roughness_idx, const glm::ivec2& metallic_idx, const int32_t& emissive_idx) :
@@ -399,7 +991,7 @@ gl::Texture2D::Ptr Material::load_texture(const std::string& path, bool srgb)
         return m_texture_cache[path].lock();
     else
     {
-        gl::Texture2D::Ptr tex = gl::Texture2D::create_from_file(path, false, srgb);
+        gl::Texture2D::Ptr tex = m_texture_streamer ? m_texture_streamer->load(path, srgb) : gl::Texture2D::create_from_file(path, false, srgb);
         m_texture_cache[path]  = tex;
         return tex;
     }
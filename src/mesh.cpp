@@ -496,19 +496,22 @@ void Mesh::load_from_disk(
                     normal_idx,
                     roughness_idx,
                     metallic_idx,
-                    emissive_idx);
+                    emissive_idx,
+                    albedo_value,
+                    roughness_value,
+                    metallic_value,
+                    emissive_value);
 
-                mat->set_albedo_value(albedo_value);
-                mat->set_roughness_value(roughness_value);
-                mat->set_metallic_value(metallic_value);
-                mat->set_emissive_value(emissive_value);
+                // Identical Assimp materials resolve to the same Material, so reuse its slot instead of adding a duplicate.
+                uint32_t local_mat_idx = std::find(m_materials.begin(), m_materials.end(), mat) - m_materials.begin();
 
-                mat_id_mapping[Scene->mMeshes[i]->mMaterialIndex]        = mat;
-                local_mat_idx_mapping[Scene->mMeshes[i]->mMaterialIndex] = m_materials.size();
+                if (local_mat_idx == m_materials.size())
+                    m_materials.push_back(mat);
 
-                m_sub_meshes[i].mat_idx = m_materials.size();
+                mat_id_mapping[Scene->mMeshes[i]->mMaterialIndex]        = mat;
+                local_mat_idx_mapping[Scene->mMeshes[i]->mMaterialIndex] = local_mat_idx;
 
-                m_materials.push_back(mat);
+                m_sub_meshes[i].mat_idx = local_mat_idx;
             }
             else // if already exists, find the pointer.
                 m_sub_meshes[i].mat_idx = local_mat_idx_mapping[Scene->mMeshes[i]->mMaterialIndex];
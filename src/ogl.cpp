@@ -3,7 +3,10 @@
 #    include <gtc/type_ptr.hpp>
 #    include <logger.h>
 #    include <ogl.h>
+#    include <profiler.h>
 #    include <utility.h>
+#    include <jobs.h>
+#    include <algorithm>
 #    define STB_IMAGE_IMPLEMENTATION
 #    include <stb_image.h>
 #    define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -45,6 +48,64 @@ size_t pixel_size_from_type(GLenum type)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+// Unknown formats are assumed to take 4 bytes per texel.
+size_t texel_size_from_internal_format(GLenum fmt, bool& block_compressed)
+{
+    block_compressed = false;
+
+    switch (fmt)
+    {
+        case GL_R8:
+        case GL_R8I:
+        case GL_R8UI:
+        case GL_STENCIL_INDEX8:
+            return 1;
+        case GL_RG8:
+        case GL_R16:
+        case GL_R16F:
+        case GL_R16I:
+        case GL_R16UI:
+        case GL_DEPTH_COMPONENT16:
+            return 2;
+        case GL_RGB8:
+        case GL_SRGB8:
+            return 4; // Drivers pad RGB8 to four bytes per texel.
+        case GL_RGB16F:
+            return 6;
+        case GL_RG32F:
+        case GL_RG32I:
+        case GL_RG32UI:
+        case GL_RGBA16:
+        case GL_RGBA16F:
+        case GL_RGBA16I:
+        case GL_RGBA16UI:
+        case GL_DEPTH32F_STENCIL8:
+            return 8;
+        case GL_RGB32F:
+            return 12;
+        case GL_RGBA32F:
+        case GL_RGBA32I:
+        case GL_RGBA32UI:
+            return 16;
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_SIGNED_RED_RGTC1:
+            block_compressed = true;
+            return 8;
+        case GL_COMPRESSED_RG_RGTC2:
+        case GL_COMPRESSED_SIGNED_RG_RGTC2:
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+        case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+            block_compressed = true;
+            return 16;
+        default:
+            return 4;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 Object::Object(const GLenum& identifier) :
     m_identifier(identifier)
 {
@@ -67,7 +128,7 @@ void Object::set_name(const GLuint& name, const std::string& label)
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 Texture::Texture() :
-    Object(GL_TEXTURE)
+    Object(GL_TEXTURE), m_memory_category(profiler::MEMORY_CATEGORY_COUNT)
 {
 }
 
@@ -78,12 +139,75 @@ Texture::~Texture()
     make_texture_handle_non_resident();
     make_image_handle_non_resident();
     glDeleteTextures(1, &m_gl_tex);
+    release_storage();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Texture::track_storage(uint32_t width, uint32_t height, uint32_t depth, uint32_t layers, uint32_t samples)
+{
+    // The category is picked when the first storage is allocated so that resizes stay in the same one.
+    if (m_memory_category == profiler::MEMORY_CATEGORY_COUNT)
+    {
+        bool render_target = samples > 1 || m_internal_format == GL_DEPTH_COMPONENT16 || m_internal_format == GL_DEPTH_COMPONENT24 || m_internal_format == GL_DEPTH_COMPONENT32F || m_internal_format == GL_DEPTH24_STENCIL8 || m_internal_format == GL_DEPTH32F_STENCIL8;
+
+        m_memory_category = profiler::memory_category(render_target ? profiler::MEMORY_CATEGORY_RENDER_TARGETS : profiler::MEMORY_CATEGORY_TEXTURES);
+    }
+
+    bool   block_compressed = false;
+    size_t texel_size       = texel_size_from_internal_format(m_internal_format, block_compressed);
+
+    m_memory_size = 0;
+
+    for (uint32_t i = 0; i < m_mip_levels; i++)
+    {
+        uint64_t w = std::max(1u, width >> i);
+        uint64_t h = std::max(1u, height >> i);
+        uint64_t d = std::max(1u, depth >> i);
+
+        if (block_compressed)
+        {
+            w = (w + 3) / 4;
+            h = (h + 3) / 4;
+        }
+
+        m_memory_size += w * h * d * texel_size;
+    }
+
+    m_memory_size *= uint64_t(layers) * samples;
+
+    profiler::track_allocation(m_memory_category, m_memory_size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Texture::release_storage()
+{
+    if (m_memory_size > 0)
+        profiler::track_free(m_memory_category, m_memory_size);
+
+    m_memory_size = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Texture::set_memory_category(profiler::MemoryCategory category)
+{
+    if (m_memory_size > 0)
+    {
+        profiler::track_free(m_memory_category, m_memory_size);
+        profiler::track_allocation(category, m_memory_size);
+    }
+
+    m_memory_category = category;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void Texture::bind(uint32_t unit)
 {
+    profiler::increment(profiler::COUNTER_TEXTURE_BINDS);
+
     glActiveTexture(GL_TEXTURE0 + unit);
     glBindTexture(m_target, m_gl_tex);
 }
@@ -219,6 +343,13 @@ GLuint64 Texture::make_texture_handle_resident()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+GLuint64 Texture::texture_handle()
+{
+    return m_texture_handle;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void Texture::make_texture_handle_non_resident()
 {
     if (m_texture_handle != 0)
@@ -336,6 +467,8 @@ void Texture1D::allocate()
         glCreateTextures(m_target, 1, &m_gl_tex);
         glTextureStorage1D(m_gl_tex, m_mip_levels, m_internal_format, m_width);
     }
+
+    track_storage(m_width, 1, 1, m_array_size, 1);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -389,6 +522,8 @@ void Texture1D::resize(uint32_t w)
     if (m_gl_tex != UINT32_MAX)
         glDeleteTextures(1, &m_gl_tex);
 
+    release_storage();
+
     m_version++;
     m_width = w;
 
@@ -425,26 +560,25 @@ Texture2D::Ptr Texture2D::create(uint32_t w, uint32_t h, uint32_t array_size, in
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
+
 Texture2D::Ptr Texture2D::create_from_file(std::string path, bool flip_vertical, bool srgb)
 {
     int x, y, n;
-    stbi_set_flip_vertically_on_load(flip_vertical);
+    stbi_set_flip_vertically_on_load_thread(flip_vertical);
 
     std::string ext = utility::file_extension(path);
 
     if (ext == "hdr")
     {
-        float* data = stbi_loadf(path.c_str(), &x, &y, &n, 0);
+        std::vector<uint16_t> data;
 
-        if (!data)
+        if (!utility::load_hdr_half(path, flip_vertical, x, y, data))
             return nullptr;
 
-        Texture2D::Ptr texture = Texture2D::create(x, y, 1, -1, 1, GL_RGB32F, GL_RGB, GL_FLOAT);
-        texture->write_data(0, 0, data);
+        Texture2D::Ptr texture = Texture2D::create(x, y, 1, -1, 1, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+        texture->write_data(0, 0, data.data());
         texture->generate_mipmaps();
 
-        stbi_image_free(data);
-
         return texture;
     }
     else
@@ -599,6 +733,8 @@ void Texture2D::allocate()
         else
             glTextureStorage2D(m_gl_tex, m_mip_levels, m_internal_format, m_width, m_height);
     }
+
+    track_storage(m_width, m_height, 1, m_array_size, m_num_samples);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -694,6 +830,8 @@ void Texture2D::resize(uint32_t w, uint32_t h)
     if (m_gl_tex != UINT32_MAX)
         glDeleteTextures(1, &m_gl_tex);
 
+    release_storage();
+
     m_version++;
     m_width  = w;
     m_height = h;
@@ -720,6 +858,36 @@ void Texture2D::resize(uint32_t w, uint32_t h)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void Texture2D::swap_storage(Texture2D::Ptr other)
+{
+    // Exchanges the GL texture objects so that every existing reference to this texture picks up the new storage.
+    std::swap(m_gl_tex, other->m_gl_tex);
+    std::swap(m_target, other->m_target);
+    std::swap(m_internal_format, other->m_internal_format);
+    std::swap(m_format, other->m_format);
+    std::swap(m_type, other->m_type);
+    std::swap(m_array_size, other->m_array_size);
+    std::swap(m_mip_levels, other->m_mip_levels);
+    std::swap(m_texture_handle, other->m_texture_handle);
+    std::swap(m_image_handle, other->m_image_handle);
+    std::swap(m_width, other->m_width);
+    std::swap(m_height, other->m_height);
+    std::swap(m_num_samples, other->m_num_samples);
+
+    // Each storage moves to the memory category of the texture that now owns it.
+    profiler::MemoryCategory memory_category = m_memory_category;
+
+    set_memory_category(other->m_memory_category);
+    other->set_memory_category(memory_category);
+    std::swap(m_memory_size, other->m_memory_size);
+    std::swap(m_memory_category, other->m_memory_category);
+
+    m_version++;
+    other->m_version++;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 uint32_t Texture2D::width()
 {
     return m_width;
@@ -812,6 +980,8 @@ void Texture3D::allocate()
     glCreateTextures(m_target, 1, &m_gl_tex);
 
     glTextureStorage3D(m_gl_tex, m_mip_levels, m_internal_format, m_width, m_height, m_depth);
+
+    track_storage(m_width, m_height, m_depth, 1, 1);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -892,6 +1062,8 @@ void Texture3D::resize(uint32_t w, uint32_t h, uint32_t d)
     if (m_gl_tex != UINT32_MAX)
         glDeleteTextures(1, &m_gl_tex);
 
+    release_storage();
+
     m_version++;
     m_width  = w;
     m_height = h;
@@ -950,80 +1122,74 @@ TextureCube::Ptr TextureCube::create(uint32_t w, uint32_t h, uint32_t array_size
 // -----------------------------------------------------------------------------------------------------------------------------------
 TextureCube::Ptr TextureCube::create_from_files(std::string path[], bool srgb)
 {
+    // The faces are decoded in parallel, only the uploads have to happen on this thread.
+    int  x[6], y[6];
+    bool loaded[6];
+
     if (utility::file_extension(path[0]) == "hdr")
     {
-        // Load the first image to determine format and dimensions.
-        std::string tex_path = path[0];
-
-        int    x, y, n;
-        float* data = stbi_loadf(tex_path.c_str(), &x, &y, &n, 3);
+        std::vector<uint16_t> data[6];
 
-        if (!data)
-            return nullptr;
-
-        GLenum internal_format, format;
-
-        internal_format = GL_RGB32F;
-        format          = GL_RGB;
-
-        TextureCube::Ptr cube = TextureCube::create(x, y, 1, -1, internal_format, format, GL_FLOAT);
-
-        cube->write_data(0, 0, 0, data);
-        stbi_image_free(data);
+        jobs::parallel_for(0, 6, 1, [&](uint32_t first, uint32_t last) {
+            for (uint32_t i = first; i < last; i++)
+                loaded[i] = utility::load_hdr_half(path[i], false, x[i], y[i], data[i]);
+        }, "Decode Cube Face");
 
-        for (int i = 1; i < 6; i++)
+        for (int i = 0; i < 6; i++)
         {
-            tex_path = path[i];
-            data     = stbi_loadf(tex_path.c_str(), &x, &y, &n, 3);
-
-            if (!data)
+            if (!loaded[i])
                 return nullptr;
-
-            cube->write_data(i, 0, 0, data);
-            stbi_image_free(data);
         }
 
+        TextureCube::Ptr cube = TextureCube::create(x[0], y[0], 1, -1, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+
+        for (int i = 0; i < 6; i++)
+            cube->write_data(i, 0, 0, data[i].data());
+
         return cube;
     }
     else
     {
-        // Load the first image to determine format and dimensions.
-        std::string tex_path = path[0];
+        stbi_uc* data[6];
 
-        int      x, y, n;
-        stbi_uc* data = stbi_load(tex_path.c_str(), &x, &y, &n, 3);
-
-        if (!data)
-            return nullptr;
+        jobs::parallel_for(0, 6, 1, [&](uint32_t first, uint32_t last) {
+            for (uint32_t i = first; i < last; i++)
+            {
+                // Workers keep whatever flag their last decode set.
+                int n;
+                stbi_set_flip_vertically_on_load_thread(false);
+                data[i]   = stbi_load(path[i].c_str(), &x[i], &y[i], &n, 3);
+                loaded[i] = data[i] != nullptr;
+            }
+        }, "Decode Cube Face");
 
-        GLenum internal_format, format;
+        TextureCube::Ptr cube;
 
-        if (srgb)
+        if (std::all_of(loaded, loaded + 6, [](bool l) { return l; }))
         {
-            internal_format = GL_SRGB8;
-            format          = GL_RGB;
-        }
-        else
-        {
-            internal_format = GL_RGBA8;
-            format          = GL_RGB;
-        }
-
-        TextureCube::Ptr cube = TextureCube::create(x, y, 1, -1, internal_format, format, GL_UNSIGNED_BYTE);
+            GLenum internal_format, format;
 
-        cube->write_data(0, 0, 0, data);
-        stbi_image_free(data);
+            if (srgb)
+            {
+                internal_format = GL_SRGB8;
+                format          = GL_RGB;
+            }
+            else
+            {
+                internal_format = GL_RGBA8;
+                format          = GL_RGB;
+            }
 
-        for (int i = 1; i < 6; i++)
-        {
-            tex_path = path[i];
-            data     = stbi_load(tex_path.c_str(), &x, &y, &n, 3);
+            cube = TextureCube::create(x[0], y[0], 1, -1, internal_format, format, GL_UNSIGNED_BYTE);
 
-            if (!data)
-                return nullptr;
+            for (int i = 0; i < 6; i++)
+                cube->write_data(i, 0, 0, data[i]);
+        }
 
-            cube->write_data(i, 0, 0, data);
-            stbi_image_free(data);
+        for (int i = 0; i < 6; i++)
+        {
+            if (data[i])
+                stbi_image_free(data[i]);
         }
 
         return cube;
@@ -1098,6 +1264,8 @@ void TextureCube::allocate()
         glTextureStorage3D(m_gl_tex, m_mip_levels, m_internal_format, m_width, m_height, m_array_size);
     else
         glTextureStorage2D(m_gl_tex, m_mip_levels, m_internal_format, m_width, m_height);
+
+    track_storage(m_width, m_height, 1, m_array_size * 6, 1);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -1183,6 +1351,8 @@ void TextureCube::resize(uint32_t w, uint32_t h)
     if (m_gl_tex != UINT32_MAX)
         glDeleteTextures(1, &m_gl_tex);
 
+    release_storage();
+
     glCreateTextures(m_target, 1, &m_gl_tex);
 
     m_version++;
@@ -1366,13 +1536,21 @@ Framebuffer::Framebuffer(std::vector<Texture::Ptr> color_attachments, Texture::P
     {
         glNamedFramebufferTexture(m_gl_fbo, GL_COLOR_ATTACHMENT0 + i, color_attachments[i]->id(), 0);
         attachments[i] = GL_COLOR_ATTACHMENT0 + i;
+
+        if (color_attachments[i]->memory_category() == profiler::MEMORY_CATEGORY_TEXTURES)
+            color_attachments[i]->set_memory_category(profiler::MEMORY_CATEGORY_RENDER_TARGETS);
     }
 
     glNamedFramebufferDrawBuffers(m_gl_fbo, color_attachments.size(), attachments);
 
     if (depth_stencil_attachment)
+    {
         glNamedFramebufferTexture(m_gl_fbo, GL_DEPTH_ATTACHMENT, depth_stencil_attachment->id(), 0);
 
+        if (depth_stencil_attachment->memory_category() == profiler::MEMORY_CATEGORY_TEXTURES)
+            depth_stencil_attachment->set_memory_category(profiler::MEMORY_CATEGORY_RENDER_TARGETS);
+    }
+
     check_status();
 }
 
@@ -1450,7 +1628,7 @@ Shader::Ptr Shader::create_from_file(GLenum type, std::string path, std::vector<
 
     if (!utility::read_shader(path, source, defines))
     {
-        DW_LOG_ERROR("Failed to read GLSL shader source: " + path);
+        DW_LOG_ERROR("Failed to read GLSL shader source: {}", path);
 
         // Force assertion failure for debug builds.
         assert(false);
@@ -1629,6 +1807,8 @@ Program::~Program()
 
 void Program::use()
 {
+    profiler::increment(profiler::COUNTER_PIPELINE_BINDS);
+
     glUseProgram(m_gl_program);
 }
 
@@ -2053,6 +2233,19 @@ Buffer::Buffer(GLenum type, GLenum flags, size_t size, void* data) :
     glCreateBuffers(1, &m_gl_buffer);
 
     glNamedBufferStorage(m_gl_buffer, size, data, flags);
+
+    if (type == GL_ARRAY_BUFFER || type == GL_ELEMENT_ARRAY_BUFFER)
+        m_memory_category = profiler::memory_category(profiler::MEMORY_CATEGORY_MESHES);
+    else if (type == GL_PIXEL_UNPACK_BUFFER || type == GL_COPY_READ_BUFFER)
+        m_memory_category = profiler::memory_category(profiler::MEMORY_CATEGORY_STAGING);
+    else
+        m_memory_category = profiler::memory_category(profiler::MEMORY_CATEGORY_OTHER);
+
+    profiler::track_allocation(m_memory_category, size);
+    profiler::increment(profiler::COUNTER_BUFFERS_CREATED);
+
+    if (data)
+        profiler::increment(profiler::COUNTER_UPLOAD_BYTES, size);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -2060,6 +2253,7 @@ Buffer::Buffer(GLenum type, GLenum flags, size_t size, void* data) :
 Buffer::~Buffer()
 {
     glDeleteBuffers(1, &m_gl_buffer);
+    profiler::track_free(m_memory_category, m_size);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -2115,6 +2309,8 @@ void Buffer::unbind()
 
 void* Buffer::map(GLenum access)
 {
+    profiler::increment(profiler::COUNTER_BUFFER_MAPS);
+
     return glMapNamedBuffer(m_gl_buffer, access);
 }
 
@@ -2122,6 +2318,8 @@ void* Buffer::map(GLenum access)
 
 void* Buffer::map_range(GLenum access, size_t offset, size_t size)
 {
+    profiler::increment(profiler::COUNTER_BUFFER_MAPS);
+
     return glMapNamedBufferRange(m_gl_buffer, offset, size, access);
 }
 
@@ -2143,6 +2341,8 @@ void Buffer::flush_mapped_range(size_t offset, size_t length)
 
 void Buffer::write_data(size_t offset, size_t size, void* data)
 {
+    profiler::increment(profiler::COUNTER_UPLOAD_BYTES, size);
+
     glNamedBufferSubData(m_gl_buffer, offset, size, data);
 }
 
@@ -2217,6 +2417,8 @@ VertexArray::~VertexArray()
 
 void VertexArray::bind()
 {
+    profiler::increment(profiler::COUNTER_VERTEX_ARRAY_BINDS);
+
     glBindVertexArray(m_gl_vao);
 }
 
@@ -2323,9 +2525,14 @@ void Fence::wait()
 {
     if (m_fence)
     {
-        glClientWaitSync(m_fence, 0, 10000000);
-        m_fence = nullptr;
+        // Flushes on the first try, so that the fence is guaranteed to be signaled eventually.
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+
+        while (glClientWaitSync(m_fence, flags, 1000000000) == GL_TIMEOUT_EXPIRED)
+            flags = 0;
+
         glDeleteSync(m_fence);
+        m_fence = nullptr;
     }
 }
 
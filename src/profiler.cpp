@@ -1,15 +1,55 @@
 #include <imgui.h>
 #include <macros.h>
+#include <logger.h>
 #include <profiler.h>
 #include <timer.h>
 #include <stack>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <unordered_map>
+#include <map>
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
 #if defined(DWSF_VULKAN)
 #    include <extensions_vk.h>
 #endif
+#if defined(DWSF_ALLOCATION_TRACKING)
+#    include <new>
+#    include <cstdlib>
+#    if defined(WIN32)
+#        include <Windows.h>
+#        include <dbghelp.h>
+#        pragma comment(lib, "dbghelp.lib")
+#    elif defined(__linux__) || defined(__APPLE__)
+#        include <execinfo.h>
+#        include <cxxabi.h>
+#    endif
+#endif
 
-#define BUFFER_COUNT 3
-#define MAX_SAMPLES 256
+#define MAX_BUFFERED_FRAMES 8
+#define LATENCY_WINDOW 120
+#define INITIAL_QUERY_COUNT 256
+#define INVALID_QUERY UINT32_MAX
+#define PIPELINE_STATISTICS_COUNT 7
+#define THREAD_EVENT_COUNT 4096
+#define MAIN_THREAD_TID 0
+#define GPU_TID 1
+#define MAX_SCOPES 1024
+#define STATISTICS_WINDOW 256
+#define HISTOGRAM_BUCKETS_PER_OCTAVE 8
+#define HISTOGRAM_BUCKETS 168 // 1 us to ~1 s
+#define SPIKE_FACTOR 2.0
+#define SPIKE_MIN_FRAMES 16
+#define ALLOCATION_TABLE_SIZE 4096 // Power of two
+#define ALLOCATION_STACK_DEPTH 24
+#define MAX_ALLOCATION_SITES 32
 
 namespace dw
 {
@@ -17,37 +57,524 @@ namespace profiler
 {
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+static std::atomic<uint64_t> g_frame_counters[COUNTER_COUNT];
+static std::atomic<uint64_t> g_memory_bytes[MEMORY_CATEGORY_COUNT];
+static std::atomic<uint64_t> g_memory_peak_bytes[MEMORY_CATEGORY_COUNT];
+static std::atomic<uint64_t> g_memory_allocations[MEMORY_CATEGORY_COUNT];
+static thread_local MemoryCategory t_memory_category = MEMORY_CATEGORY_COUNT;
+
+#if defined(DWSF_ALLOCATION_TRACKING)
+struct AllocationRecord
+{
+    uint64_t hash;
+    uint64_t count;
+    uint64_t bytes;
+    uint32_t depth;
+    void*    frames[ALLOCATION_STACK_DEPTH];
+};
+
+// Running totals of the calling thread, scopes take the difference between their begin and end.
+static thread_local uint64_t t_allocations        = 0;
+static thread_local uint64_t t_allocated_bytes    = 0;
+static thread_local bool     t_recording_stack    = false;
+static std::atomic<bool>     g_allocation_capture = { false };
+
+// Sites are aggregated into a table that is allocated before the capture starts, so recording a stack never allocates.
+static std::mutex        g_allocation_mutex;
+static AllocationRecord* g_allocation_records  = nullptr;
+static uint64_t          g_allocation_overflow = 0;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint32_t capture_stack(void** frames, uint32_t max_depth)
+{
+    // Skips this function and record_allocation(), or operator new if either got inlined.
+#    if defined(WIN32)
+    return CaptureStackBackTrace(2, max_depth, frames, nullptr);
+#    elif defined(__linux__) || defined(__APPLE__)
+    void* all_frames[ALLOCATION_STACK_DEPTH + 2];
+    int   depth = backtrace(all_frames, max_depth + 2);
+
+    if (depth <= 2)
+        return 0;
+
+    memcpy(frames, all_frames + 2, (depth - 2) * sizeof(void*));
+
+    return uint32_t(depth - 2);
+#    else
+    return 0;
+#    endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::string symbolize(void* frame)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%p", frame);
+
+#    if defined(WIN32)
+    HANDLE process = GetCurrentProcess();
+
+    static bool initialized = SymInitialize(process, nullptr, TRUE);
+
+    if (!initialized)
+        return buffer;
+
+    char         symbol_buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+    SYMBOL_INFO* symbol  = (SYMBOL_INFO*)symbol_buffer;
+    symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+    symbol->MaxNameLen   = MAX_SYM_NAME;
+
+    if (!SymFromAddr(process, DWORD64(frame), nullptr, symbol))
+        return buffer;
+
+    std::string name = symbol->Name;
+
+    IMAGEHLP_LINE64 line;
+    DWORD           displacement = 0;
+    line.SizeOfStruct            = sizeof(IMAGEHLP_LINE64);
+
+    if (SymGetLineFromAddr64(process, DWORD64(frame), &displacement, &line))
+        name += " (" + std::string(line.FileName) + ":" + std::to_string(line.LineNumber) + ")";
+
+    return name;
+#    elif defined(__linux__) || defined(__APPLE__)
+    char** symbols = backtrace_symbols(&frame, 1);
+
+    if (!symbols)
+        return buffer;
+
+    std::string name = symbols[0];
+    free(symbols);
+
+    // glibc formats frames as "module(mangled+offset) [address]", demangle the function if there is one.
+    size_t begin = name.find('(');
+    size_t end   = name.find('+', begin);
+
+    if (begin != std::string::npos && end != std::string::npos && end > begin + 1)
+    {
+        int   status    = 0;
+        char* demangled = abi::__cxa_demangle(name.substr(begin + 1, end - begin - 1).c_str(), nullptr, nullptr, &status);
+
+        if (status == 0)
+            name = std::string(demangled) + " [" + name.substr(0, begin) + "]";
+
+        free(demangled);
+    }
+
+    return name;
+#    else
+    return buffer;
+#    endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Called by the replaced operator new on every thread, possibly before main() and after the profiler is shut down.
+static void record_allocation(size_t size)
+{
+    t_allocations++;
+    t_allocated_bytes += size;
+
+    increment(COUNTER_ALLOCATIONS);
+    increment(COUNTER_ALLOCATED_BYTES, size);
+
+    // Unwinding may allocate itself, those allocations are counted but not recorded.
+    if (!g_allocation_capture.load(std::memory_order_relaxed) || t_recording_stack)
+        return;
+
+    t_recording_stack = true;
+
+    void*    frames[ALLOCATION_STACK_DEPTH];
+    uint32_t depth = capture_stack(frames, ALLOCATION_STACK_DEPTH);
+    uint64_t hash  = 14695981039346656037ull;
+
+    for (uint32_t i = 0; i < depth; i++)
+        hash = (hash ^ uint64_t(frames[i])) * 1099511628211ull;
+
+    {
+        std::lock_guard<std::mutex> lock(g_allocation_mutex);
+
+        if (g_allocation_records)
+        {
+            uint32_t i = 0;
+
+            for (; i < ALLOCATION_TABLE_SIZE; i++)
+            {
+                AllocationRecord& record = g_allocation_records[(hash + i) & (ALLOCATION_TABLE_SIZE - 1)];
+
+                if (record.count == 0)
+                {
+                    record.hash  = hash;
+                    record.depth = depth;
+                    memcpy(record.frames, frames, depth * sizeof(void*));
+                }
+                else if (record.hash != hash || record.depth != depth || memcmp(record.frames, frames, depth * sizeof(void*)) != 0)
+                    continue;
+
+                record.count++;
+                record.bytes += size;
+                break;
+            }
+
+            if (i == ALLOCATION_TABLE_SIZE)
+                g_allocation_overflow++;
+        }
+    }
+
+    t_recording_stack = false;
+}
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint64_t thread_allocations()
+{
+#if defined(DWSF_ALLOCATION_TRACKING)
+    return t_allocations;
+#else
+    return 0;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint64_t thread_allocated_bytes()
+{
+#if defined(DWSF_ALLOCATION_TRACKING)
+    return t_allocated_bytes;
+#else
+    return 0;
+#endif
+}
+
+// Input vertices, input primitives, vertex shader invocations, clipping input and output primitives, fragment shader and compute
+// shader invocations. The Vulkan flags are listed in bit order, which is the order the results are written in.
+#if defined(DWSF_VULKAN)
+static const VkQueryPipelineStatisticFlags kPipelineStatisticFlags = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+#else
+static const GLenum kPipelineStatisticTargets[] = {
+    GL_VERTICES_SUBMITTED,
+    GL_PRIMITIVES_SUBMITTED,
+    GL_VERTEX_SHADER_INVOCATIONS,
+    GL_CLIPPING_INPUT_PRIMITIVES,
+    GL_CLIPPING_OUTPUT_PRIMITIVES,
+    GL_FRAGMENT_SHADER_INVOCATIONS,
+    GL_COMPUTE_SHADER_INVOCATIONS
+};
+#endif
+
+static const char* kCounterNames[] = {
+    "Draw Calls",
+    "Dispatches",
+    "Indices",
+    "Pipeline Binds",
+    "Vertex Array Binds",
+    "Texture Binds",
+    "Buffer Maps",
+    "Buffers Created",
+    "Upload Bytes",
+    "Allocations",
+    "Allocated Bytes"
+};
+
+static const char* kMemoryCategoryNames[] = {
+    "Meshes",
+    "Textures",
+    "Render Targets",
+    "Staging",
+    "Debug Draw",
+    "Other"
+};
+
+static const char* kMemoryCounterNames[] = {
+    "Memory: Meshes (MB)",
+    "Memory: Textures (MB)",
+    "Memory: Render Targets (MB)",
+    "Memory: Staging (MB)",
+    "Memory: Debug Draw (MB)",
+    "Memory: Other (MB)"
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 struct Profiler
 {
     struct Sample
     {
-        std::string name;
+        const char* name;
+        uint32_t    id;
 #if defined(DWSF_VULKAN)
         uint32_t query_index;
 #else
         gl::Query query;
 #endif
-        bool    start = true;
-        double  cpu_time;
-        Sample* end_sample;
+        bool     start = true;
+        double   cpu_time;
+        Sample*  end_sample;
+        uint32_t segment; // First pipeline statistics segment of the scope for begin samples, one past the last for end samples.
+        uint64_t allocations; // Heap allocations made by the main thread so far.
+        uint64_t allocated_bytes;
+    };
+
+    struct ThreadEvent
+    {
+        const char* name;
+        uint32_t    id;
+        bool        start;
+        double      time;
+    };
+
+    struct ThreadSample
+    {
+        const char* name;
+        uint32_t    id;
+        uint32_t    depth;
+        double      start_time;
+        double      end_time = -1.0;
+    };
+
+    // Main thread sample of a finished frame, GPU times are in microseconds of the GPU clock.
+    struct ResolvedSample
+    {
+        const char* name;
+        uint32_t    id;
+        uint32_t    depth;
+        double      cpu_start;
+        double      cpu_end;
+        double      gpu_start;
+        double      gpu_end;
+        bool        has_gpu_time;
+        bool        has_pipeline_statistics;
+        uint64_t    pipeline_statistics[PIPELINE_STATISTICS_COUNT];
+        uint64_t    allocations;
+        uint64_t    allocated_bytes;
+    };
+
+    struct TraceEvent
+    {
+        const char* name;
+        const char* category;
+        uint32_t    tid;
+        char        phase;
+        double      time;
+        double      value; // Duration of complete events, frame index of frame markers and the value of counters.
+    };
+
+    // Single producer (the owning thread), single consumer (end_frame()) ring of begin/end events. The indices sit on their own
+    // cache lines so that recording never contends with the merge.
+    struct ThreadBuffer
+    {
+        alignas(64) std::atomic<uint32_t> write_idx = { 0 };
+        alignas(64) std::atomic<uint32_t> read_idx  = { 0 };
+
+        // Producer side. Every pushed begin event reserves a slot for its end event so that pairs are never split when the
+        // ring is full, scopes that do not fit are dropped as a whole.
+        alignas(64) uint32_t  open_count = 0;
+        uint32_t              skip_depth = 0;
+        std::atomic<uint32_t> dropped    = { 0 };
+        ThreadEvent           events[THREAD_EVENT_COUNT];
+
+        // Set when the owning thread exits, the buffer is released once everything it recorded has been shown.
+        std::atomic<bool> retired = { false };
+
+        // Consumer side.
+        alignas(64) std::string   name;
+        uint32_t                  tid;
+        std::vector<ThreadSample> samples;
+        std::vector<uint32_t>     sample_stack;
+    };
+
+    // Rolling window of per-frame times in milliseconds along with a log-scale histogram of the same values. Only the thread
+    // calling begin_frame()/end_frame() writes, everything readers touch is atomic so statistics can be queried from any
+    // thread without taking a lock. A reader racing the writer may see a window that is one frame off.
+    struct StatisticsWindow
+    {
+        std::atomic<float>    values[STATISTICS_WINDOW];
+        std::atomic<uint32_t> histogram[HISTOGRAM_BUCKETS];
+        std::atomic<uint32_t> count  = { 0 };
+        std::atomic<uint32_t> head   = { 0 };
+        std::atomic<uint32_t> spikes = { 0 };
+
+        // Writer only.
+        double sum = 0.0;
+        bool   spike[STATISTICS_WINDOW];
+
+        StatisticsWindow() { reset(); }
+
+        static uint32_t bucket(float ms)
+        {
+            float us = ms * 1000.0f;
+
+            if (us < 1.0f)
+                return 0;
+
+            return std::min(uint32_t(HISTOGRAM_BUCKETS - 1), 1 + uint32_t(std::log2(us) * HISTOGRAM_BUCKETS_PER_OCTAVE));
+        }
+
+        // Geometric center of a bucket, in milliseconds.
+        static float bucket_center(uint32_t idx)
+        {
+            if (idx == 0)
+                return 0.0005f;
+
+            return std::exp2((float(idx) - 0.5f) / HISTOGRAM_BUCKETS_PER_OCTAVE) * 0.001f;
+        }
+
+        void reset()
+        {
+            for (uint32_t i = 0; i < STATISTICS_WINDOW; i++)
+            {
+                values[i].store(0.0f, std::memory_order_relaxed);
+                spike[i] = false;
+            }
+
+            for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+                histogram[i].store(0, std::memory_order_relaxed);
+
+            sum = 0.0;
+            spikes.store(0, std::memory_order_relaxed);
+            head.store(0, std::memory_order_relaxed);
+            count.store(0, std::memory_order_release);
+        }
+
+        void push(float value)
+        {
+            uint32_t n   = count.load(std::memory_order_relaxed);
+            uint32_t idx = head.load(std::memory_order_relaxed);
+
+            if (n == STATISTICS_WINDOW)
+            {
+                float old = values[idx].load(std::memory_order_relaxed);
+
+                histogram[bucket(old)].fetch_sub(1, std::memory_order_relaxed);
+                sum -= old;
+
+                if (spike[idx])
+                    spikes.fetch_sub(1, std::memory_order_relaxed);
+
+                n--;
+            }
+
+            spike[idx] = n >= SPIKE_MIN_FRAMES && value > SPIKE_FACTOR * (sum / n);
+
+            if (spike[idx])
+                spikes.fetch_add(1, std::memory_order_relaxed);
+
+            values[idx].store(value, std::memory_order_relaxed);
+            histogram[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+            sum += value;
+
+            head.store((idx + 1) % STATISTICS_WINDOW, std::memory_order_relaxed);
+            count.store(n + 1, std::memory_order_release);
+        }
+
+        bool statistics(Statistics& stats) const
+        {
+            uint32_t n = count.load(std::memory_order_acquire);
+
+            if (n == 0)
+                return false;
+
+            // The window is filled from the first slot, so the first n values are the valid ones.
+            double sum    = 0.0;
+            double sum_sq = 0.0;
+
+            stats.min = FLT_MAX;
+            stats.max = 0.0f;
+
+            for (uint32_t i = 0; i < n; i++)
+            {
+                float value = values[i].load(std::memory_order_relaxed);
+
+                sum += value;
+                sum_sq += double(value) * value;
+                stats.min = std::min(stats.min, value);
+                stats.max = std::max(stats.max, value);
+            }
+
+            double mean = sum / n;
+
+            stats.frames  = n;
+            stats.spikes  = spikes.load(std::memory_order_relaxed);
+            stats.mean    = float(mean);
+            stats.std_dev = float(std::sqrt(std::max(0.0, sum_sq / n - mean * mean)));
+
+            uint32_t counts[HISTOGRAM_BUCKETS];
+            uint32_t total = 0;
+
+            for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+            {
+                counts[i] = histogram[i].load(std::memory_order_relaxed);
+                total += counts[i];
+            }
+
+            stats.p50 = percentile(counts, total, 0.50f, stats);
+            stats.p95 = percentile(counts, total, 0.95f, stats);
+            stats.p99 = percentile(counts, total, 0.99f, stats);
+
+            return true;
+        }
+
+        static float percentile(const uint32_t* counts, uint32_t total, float p, const Statistics& stats)
+        {
+            uint32_t rank       = std::max(1u, uint32_t(std::ceil(p * total)));
+            uint32_t cumulative = 0;
+
+            for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+            {
+                cumulative += counts[i];
+
+                if (cumulative >= rank)
+                    return std::min(stats.max, std::max(stats.min, bucket_center(i)));
+            }
+
+            return stats.max;
+        }
+
+        // Oldest to newest.
+        void history(std::vector<float>& out) const
+        {
+            uint32_t n     = count.load(std::memory_order_acquire);
+            uint32_t first = n == STATISTICS_WINDOW ? head.load(std::memory_order_relaxed) : 0;
+
+            out.resize(n);
+
+            for (uint32_t i = 0; i < n; i++)
+                out[i] = values[(first + i) % STATISTICS_WINDOW].load(std::memory_order_relaxed);
+        }
     };
 
+    struct ScopeStatistics
+    {
+        StatisticsWindow windows[2]; // Indexed by TimeSource.
+    };
+
+#if !defined(DWSF_VULKAN)
+    struct StatisticsSegment
+    {
+        gl::Query queries[PIPELINE_STATISTICS_COUNT];
+    };
+#endif
+
     struct Buffer
     {
         std::vector<std::unique_ptr<Sample>> samples;
         int32_t                              index = 0;
+        uint64_t                             frame = 0;
+        bool                                 pipeline_statistics = false;
+        uint32_t                             segment_count       = 0;
 #if defined(DWSF_VULKAN)
         vk::QueryPool::Ptr query_pool;
-        uint32_t           query_index = 0;
+        uint32_t           query_index    = 0;
+        uint32_t           query_capacity = 0;
+        bool               should_reset   = true;
+        vk::QueryPool::Ptr statistics_pool;
+        uint32_t           statistics_capacity = 0;
+#else
+        std::vector<std::unique_ptr<StatisticsSegment>> segments;
 #endif
-
-        Buffer()
-        {
-            samples.resize(MAX_SAMPLES);
-
-            for (uint32_t i = 0; i < MAX_SAMPLES; i++)
-                samples[i] = nullptr;
-        }
     };
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -58,61 +585,82 @@ struct Profiler
 #endif
     )
     {
-#ifdef WIN32
-        QueryPerformanceFrequency(&m_frequency);
-#endif
+        m_main_thread = std::this_thread::get_id();
+
+        for (uint32_t i = 0; i < MAX_SCOPES; i++)
+        {
+            m_scope_statistics[i].store(nullptr, std::memory_order_relaxed);
+            m_frame_times[TIME_SOURCE_CPU][i] = -1.0;
+            m_frame_times[TIME_SOURCE_GPU][i] = -1.0;
+        }
 
 #if defined(DWSF_VULKAN)
-        for (int i = 0; i < BUFFER_COUNT; i++)
-            m_sample_buffers[i].query_pool = vk::QueryPool::create(backend, VK_QUERY_TYPE_TIMESTAMP, MAX_SAMPLES);
+        m_backend          = backend;
+        m_timestamp_period = backend->device_properties().limits.timestampPeriod;
 #endif
+
+        m_write_buffer = acquire_buffer();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
     ~Profiler()
     {
-#if defined(DWSF_VULKAN)
-        for (int i = 0; i < BUFFER_COUNT; i++)
-            m_sample_buffers[i].query_pool.reset();
+        for (uint32_t i = 0; i < MAX_SCOPES; i++)
+            delete m_scope_statistics[i].load(std::memory_order_relaxed);
+
+#if defined(DWSF_ALLOCATION_TRACKING)
+        // An unfinished allocation capture is dropped.
+        g_allocation_capture.store(false, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(g_allocation_mutex);
+
+        free(g_allocation_records);
+        g_allocation_records = nullptr;
 #endif
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void begin_sample(std::string name
+    void begin_sample(const Marker& marker
 #if defined(DWSF_VULKAN)
                       ,
-                      vk::CommandBuffer::Ptr cmd_buf
+                      const vk::CommandBuffer::Ptr& cmd_buf
 #endif
     )
     {
-#if defined(DWSF_VULKAN)
-        if (m_should_reset)
+        if (std::this_thread::get_id() != m_main_thread)
         {
-            m_sample_buffers[m_write_buffer_idx].query_index = 0;
-            vkCmdResetQueryPool(cmd_buf->handle(), m_sample_buffers[m_write_buffer_idx].query_pool->handle(), 0, MAX_SAMPLES);
-            m_should_reset = false;
+            begin_thread_sample(marker);
+            return;
         }
-#endif
 
-        int32_t idx = m_sample_buffers[m_write_buffer_idx].index++;
+        Buffer* buffer = m_write_buffer;
+
+#if defined(DWSF_VULKAN)
+        if (buffer->should_reset)
+        {
+            vkCmdResetQueryPool(cmd_buf->handle(), buffer->query_pool->handle(), 0, buffer->query_capacity);
 
-        if (!m_sample_buffers[m_write_buffer_idx].samples[idx])
-            m_sample_buffers[m_write_buffer_idx].samples[idx] = std::make_unique<Sample>();
+            if (buffer->pipeline_statistics && buffer->statistics_pool)
+                vkCmdResetQueryPool(cmd_buf->handle(), buffer->statistics_pool->handle(), 0, buffer->statistics_capacity);
+
+            buffer->should_reset = false;
+        }
+#endif
 
-        auto& sample = m_sample_buffers[m_write_buffer_idx].samples[idx];
+        Sample* sample = next_sample(buffer);
 
-        sample->name = name;
+        sample->name = marker.name;
+        sample->id   = marker.id;
 #if defined(DWSF_VULKAN)
-        sample->query_index = m_sample_buffers[m_write_buffer_idx].query_index++;
-        vkCmdWriteTimestamp(cmd_buf->handle(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_sample_buffers[m_write_buffer_idx].query_pool->handle(), sample->query_index);
+        write_timestamp(buffer, sample, cmd_buf);
 
         VkDebugUtilsLabelEXT debug_label;
 
         debug_label.sType      = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
         debug_label.pNext      = nullptr;
-        debug_label.pLabelName = name.c_str();
+        debug_label.pLabelName = marker.name;
         debug_label.color[0]   = 0.0f;
         debug_label.color[1]   = 1.0f;
         debug_label.color[2]   = 0.0f;
@@ -125,196 +673,1487 @@ struct Profiler
         sample->end_sample = nullptr;
         sample->start      = true;
 
-#ifdef WIN32
-        LARGE_INTEGER cpu_time;
-        QueryPerformanceCounter(&cpu_time);
-        sample->cpu_time = cpu_time.QuadPart * (1000000.0 / m_frequency.QuadPart);
-#else
-        timeval cpu_time;
-        gettimeofday(&cpu_time, nullptr);
-        sample->cpu_time = (cpu_time.tv_sec * 1000000.0) + cpu_time.tv_usec;
+        sample->cpu_time = cpu_time();
+
+        if (buffer->pipeline_statistics)
+        {
+            end_segment(buffer);
+            sample->segment = buffer->segment_count;
+            begin_segment(buffer
+#if defined(DWSF_VULKAN)
+                          ,
+                          cmd_buf
 #endif
+            );
+        }
 
-        m_sample_stack.push(sample.get());
+        m_sample_stack.push(sample);
+
+        // Taken last so that the profiler's own bookkeeping is left out of the scope.
+        sample->allocations     = thread_allocations();
+        sample->allocated_bytes = thread_allocated_bytes();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void end_sample(std::string name
+    void end_sample(const Marker& marker
 #if defined(DWSF_VULKAN)
                     ,
-                    vk::CommandBuffer::Ptr cmd_buf
+                    const vk::CommandBuffer::Ptr& cmd_buf
 #endif
     )
     {
-        int32_t idx = m_sample_buffers[m_write_buffer_idx].index++;
+        if (std::this_thread::get_id() != m_main_thread)
+        {
+            end_thread_sample();
+            return;
+        }
+
+        uint64_t allocations     = thread_allocations();
+        uint64_t allocated_bytes = thread_allocated_bytes();
 
-        if (!m_sample_buffers[m_write_buffer_idx].samples[idx])
-            m_sample_buffers[m_write_buffer_idx].samples[idx] = std::make_unique<Sample>();
+        if (m_sample_stack.empty())
+        {
+            DW_LOG_ERROR("PROFILER: end_sample() without a matching begin_sample(): {}", marker.name);
+            return;
+        }
 
-        auto& sample = m_sample_buffers[m_write_buffer_idx].samples[idx];
+        Buffer* buffer = m_write_buffer;
+        Sample* sample = next_sample(buffer);
 
-        sample->name  = name;
+        sample->name  = marker.name;
+        sample->id    = marker.id;
         sample->start = false;
 #if defined(DWSF_VULKAN)
-        sample->query_index = m_sample_buffers[m_write_buffer_idx].query_index++;
-        vkCmdWriteTimestamp(cmd_buf->handle(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_sample_buffers[m_write_buffer_idx].query_pool->handle(), sample->query_index);
+        write_timestamp(buffer, sample, cmd_buf);
 
         vkCmdEndDebugUtilsLabelEXT(cmd_buf->handle());
 #else
         sample->query.query_counter(GL_TIMESTAMP);
 #endif
-        sample->end_sample = nullptr;
+        sample->end_sample      = nullptr;
+        sample->allocations     = allocations;
+        sample->allocated_bytes = allocated_bytes;
 
-#ifdef WIN32
-        LARGE_INTEGER cpu_time;
-        QueryPerformanceCounter(&cpu_time);
-        sample->cpu_time = cpu_time.QuadPart * (1000000.0 / m_frequency.QuadPart);
-#else
-        timeval cpu_time;
-        gettimeofday(&cpu_time, nullptr);
-        sample->cpu_time = (cpu_time.tv_sec * 1000000.0) + cpu_time.tv_usec;
-#endif
+        sample->cpu_time = cpu_time();
 
         Sample* start = m_sample_stack.top();
 
-        start->end_sample = sample.get();
+        start->end_sample = sample;
 
         m_sample_stack.pop();
-    }
 
-    // -----------------------------------------------------------------------------------------------------------------------------------
+        if (buffer->pipeline_statistics)
+        {
+            end_segment(buffer);
+            sample->segment = buffer->segment_count;
 
-    void begin_frame()
-    {
+            if (!m_sample_stack.empty())
+            {
+                begin_segment(buffer
 #if defined(DWSF_VULKAN)
-        m_should_reset = true;
+                              ,
+                              cmd_buf
 #endif
-        m_read_buffer_idx++;
-        m_write_buffer_idx++;
-
-        if (m_read_buffer_idx == 3)
-            m_read_buffer_idx = 0;
+                );
+            }
+        }
 
-        if (m_write_buffer_idx == 3)
-            m_write_buffer_idx = 0;
+        // The CPU time is known right away, only the GPU time waits for the readback.
+        accumulate_statistics(TIME_SOURCE_CPU, start->id, (sample->cpu_time - start->cpu_time) * 0.001);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void end_frame()
+    // Samples are allocated individually so that growing the buffer never moves the ones linked through end_sample.
+    Sample* next_sample(Buffer* buffer)
     {
-        if (m_read_buffer_idx >= 0)
-            m_sample_buffers[m_read_buffer_idx].index = 0;
+        if (size_t(buffer->index) == buffer->samples.size())
+            buffer->samples.push_back(std::make_unique<Sample>());
+
+        return buffer->samples[buffer->index++].get();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-#if defined(DWSF_IMGUI)
-    void ui()
+#if defined(DWSF_VULKAN)
+    // The pool was reset for the frame already and can not be replaced mid frame, so samples past its capacity only lose their
+    // GPU time. The pool is grown before the buffer is recorded into again.
+    void write_timestamp(Buffer* buffer, Sample* sample, const vk::CommandBuffer::Ptr& cmd_buf)
     {
-        if (m_read_buffer_idx >= 0)
+        if (buffer->query_index < buffer->query_capacity)
         {
-            for (int32_t i = 0; i < m_sample_buffers[m_read_buffer_idx].index; i++)
-            {
-                auto& sample = m_sample_buffers[m_read_buffer_idx].samples[i];
-
-                if (sample->start)
-                {
-                    if (!m_should_pop_stack.empty())
-                    {
-                        if (!m_should_pop_stack.top())
-                        {
-                            m_should_pop_stack.push(false);
-                            continue;
-                        }
-                    }
-
-                    std::string id = std::to_string(i);
-
-                    uint64_t start_time = 0;
-                    uint64_t end_time   = 0;
-
-#    if defined(DWSF_VULKAN)
-                    m_sample_buffers[m_read_buffer_idx].query_pool->results(sample->query_index, 1, sizeof(uint64_t), &start_time, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
-                    m_sample_buffers[m_read_buffer_idx].query_pool->results(sample->end_sample->query_index, 1, sizeof(uint64_t), &end_time, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
-#    else
-                    sample->query.result_64(&start_time);
-                    sample->end_sample->query.result_64(&end_time);
-#    endif
-
-                    uint64_t gpu_time_diff = end_time - start_time;
-
-                    float gpu_time = float(gpu_time_diff / 1000000.0);
-                    float cpu_time = (sample->end_sample->cpu_time - sample->cpu_time) * 0.001f;
-
-                    if (ImGui::TreeNode(id.c_str(), "%s | %f ms (CPU) | %f ms (GPU)", sample->name.c_str(), cpu_time, gpu_time))
-                        m_should_pop_stack.push(true);
-                    else
-                        m_should_pop_stack.push(false);
-                }
-                else
-                {
-                    if (!m_should_pop_stack.empty())
-                    {
-                        bool should_pop = m_should_pop_stack.top();
-                        m_should_pop_stack.pop();
-
-                        if (should_pop)
-                            ImGui::TreePop();
-                    }
-                }
-            }
+            sample->query_index = buffer->query_index++;
+            vkCmdWriteTimestamp(cmd_buf->handle(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, buffer->query_pool->handle(), sample->query_index);
         }
+        else
+            sample->query_index = INVALID_QUERY;
     }
 #endif
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    int32_t             m_read_buffer_idx  = -3;
-    int32_t             m_write_buffer_idx = -1;
-    Buffer              m_sample_buffers[BUFFER_COUNT];
-    std::stack<Sample*> m_sample_stack;
-    std::stack<bool>    m_should_pop_stack;
-
+    // Pipeline statistics queries can not nest, so while they are enabled the frame is split into segments at every sample
+    // boundary of the main thread and each scope adds up the segments between its begin and end. No query is left active
+    // between top level scopes.
+    void begin_segment(Buffer* buffer
 #if defined(DWSF_VULKAN)
-    bool m_should_reset = true;
+                       ,
+                       const vk::CommandBuffer::Ptr& cmd_buf
 #endif
+    )
+    {
+        uint32_t idx = buffer->segment_count++;
+
+#if defined(DWSF_VULKAN)
+        // Scopes that include a segment past the end of the pool get no statistics this frame.
+        if (idx >= buffer->statistics_capacity || !buffer->statistics_pool)
+            return;
+
+        vkCmdBeginQuery(cmd_buf->handle(), buffer->statistics_pool->handle(), idx, 0);
+        m_segment_cmd_buf = cmd_buf->handle();
+#else
+        if (idx == buffer->segments.size())
+            buffer->segments.push_back(std::make_unique<StatisticsSegment>());
+
+        for (uint32_t i = 0; i < PIPELINE_STATISTICS_COUNT; i++)
+            buffer->segments[idx]->queries[i].begin(kPipelineStatisticTargets[i]);
+#endif
+
+        m_segment_active = true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void end_segment(Buffer* buffer)
+    {
+        if (!m_segment_active)
+            return;
+
+#if defined(DWSF_VULKAN)
+        // Ended on the command buffer it was begun on, which is still recording as long as the enclosing scope is open.
+        if (buffer->statistics_pool)
+            vkCmdEndQuery(m_segment_cmd_buf, buffer->statistics_pool->handle(), buffer->segment_count - 1);
+#else
+        for (uint32_t i = 0; i < PIPELINE_STATISTICS_COUNT; i++)
+            buffer->segments[buffer->segment_count - 1]->queries[i].end(kPipelineStatisticTargets[i]);
+#endif
+
+        m_segment_active = false;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_VULKAN)
+    // A query begun outside of a render pass can not be ended inside of it and the other way around, so the segment of the
+    // innermost open scope is split at both ends of the render pass.
+    bool split_segment_at_render_pass()
+    {
+        return std::this_thread::get_id() == m_main_thread && m_write_buffer && m_write_buffer->pipeline_statistics && !m_sample_stack.empty();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_render_pass(const vk::CommandBuffer::Ptr& cmd_buf, const VkRenderPassBeginInfo& info, VkSubpassContents contents)
+    {
+        bool split = split_segment_at_render_pass();
+
+        if (split)
+            end_segment(m_write_buffer);
+
+        vkCmdBeginRenderPass(cmd_buf->handle(), &info, contents);
+
+        if (split)
+            begin_segment(m_write_buffer, cmd_buf);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void end_render_pass(const vk::CommandBuffer::Ptr& cmd_buf)
+    {
+        bool split = split_segment_at_render_pass();
+
+        if (split)
+            end_segment(m_write_buffer);
+
+        vkCmdEndRenderPass(cmd_buf->handle());
+
+        if (split)
+            begin_segment(m_write_buffer, cmd_buf);
+    }
+#endif
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void set_pipeline_statistics(bool enabled)
+    {
+        if (enabled)
+        {
+#if defined(DWSF_VULKAN)
+            bool supported = m_backend.lock()->device_features().pipelineStatisticsQuery;
+#else
+            bool supported = GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_pipeline_statistics_query;
+#endif
+            if (!supported)
+            {
+                DW_LOG_WARNING("PROFILER: Pipeline statistics queries are not supported by this device.");
+                return;
+            }
+        }
+
+        m_pipeline_statistics = enabled;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Microseconds on the Timer clock.
+    double cpu_time() { return Timer::now() * 0.001; }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    struct ThreadBufferHandle
+    {
+        ThreadBuffer* buffer     = nullptr;
+        uint32_t      generation = 0;
+
+        ~ThreadBufferHandle();
+    };
+
+    ThreadBuffer* thread_buffer()
+    {
+        thread_local ThreadBufferHandle t_handle;
+
+        // The registry lock is only taken the first time a thread records a sample.
+        if (!t_handle.buffer || t_handle.generation != m_generation)
+        {
+            std::lock_guard<std::mutex> lock(m_thread_buffers_mutex);
+
+            m_thread_buffers.push_back(std::make_unique<ThreadBuffer>());
+
+            t_handle.buffer       = m_thread_buffers.back().get();
+            t_handle.buffer->name = t_thread_name.empty() ? "Thread " + std::to_string(m_thread_buffers.size()) : t_thread_name;
+            t_handle.buffer->tid  = m_next_tid++;
+            t_handle.generation   = m_generation;
+        }
+
+        return t_handle.buffer;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_thread_sample(const Marker& marker)
+    {
+        ThreadBuffer* buffer = thread_buffer();
+
+        uint32_t write_idx = buffer->write_idx.load(std::memory_order_relaxed);
+        uint32_t read_idx  = buffer->read_idx.load(std::memory_order_acquire);
+
+        if (buffer->skip_depth > 0 || THREAD_EVENT_COUNT - (write_idx - read_idx) < buffer->open_count + 2)
+        {
+            buffer->skip_depth++;
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        ThreadEvent& event = buffer->events[write_idx % THREAD_EVENT_COUNT];
+
+        event.name  = marker.name;
+        event.id    = marker.id;
+        event.start = true;
+        event.time  = cpu_time();
+
+        buffer->open_count++;
+        buffer->write_idx.store(write_idx + 1, std::memory_order_release);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void end_thread_sample()
+    {
+        ThreadBuffer* buffer = thread_buffer();
+
+        if (buffer->skip_depth > 0)
+        {
+            buffer->skip_depth--;
+            return;
+        }
+
+        uint32_t write_idx = buffer->write_idx.load(std::memory_order_relaxed);
+
+        ThreadEvent& event = buffer->events[write_idx % THREAD_EVENT_COUNT];
+
+        event.start = false;
+        event.time  = cpu_time();
+
+        buffer->open_count--;
+        buffer->write_idx.store(write_idx + 1, std::memory_order_release);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Builds the hierarchy of every thread from the events recorded since the last frame. Scopes still open on a thread carry
+    // over into the next frame.
+    void merge_thread_samples()
+    {
+        std::lock_guard<std::mutex> lock(m_thread_buffers_mutex);
+
+        // Buffers of exited threads whose last samples were already merged in the previous frame.
+        m_thread_buffers.erase(std::remove_if(m_thread_buffers.begin(), m_thread_buffers.end(), [](const std::unique_ptr<ThreadBuffer>& buffer) {
+                                   return buffer->retired.load(std::memory_order_acquire) && buffer->read_idx.load(std::memory_order_relaxed) == buffer->write_idx.load(std::memory_order_acquire);
+                               }),
+                               m_thread_buffers.end());
+
+        for (auto& buffer : m_thread_buffers)
+        {
+            std::vector<ThreadSample> open_samples;
+
+            for (auto idx : buffer->sample_stack)
+                open_samples.push_back(buffer->samples[idx]);
+
+            buffer->samples.swap(open_samples);
+
+            for (uint32_t i = 0; i < buffer->sample_stack.size(); i++)
+                buffer->sample_stack[i] = i;
+
+            uint32_t read_idx  = buffer->read_idx.load(std::memory_order_relaxed);
+            uint32_t write_idx = buffer->write_idx.load(std::memory_order_acquire);
+
+            for (; read_idx != write_idx; read_idx++)
+            {
+                const ThreadEvent& event = buffer->events[read_idx % THREAD_EVENT_COUNT];
+
+                if (event.start)
+                {
+                    ThreadSample sample;
+
+                    sample.name       = event.name;
+                    sample.id         = event.id;
+                    sample.start_time = event.time;
+                    sample.depth      = buffer->sample_stack.size();
+
+                    buffer->sample_stack.push_back(buffer->samples.size());
+                    buffer->samples.push_back(sample);
+                }
+                else if (!buffer->sample_stack.empty())
+                {
+                    ThreadSample& sample = buffer->samples[buffer->sample_stack.back()];
+
+                    sample.end_time = event.time;
+                    accumulate_statistics(TIME_SOURCE_CPU, sample.id, (sample.end_time - sample.start_time) * 0.001);
+
+                    buffer->sample_stack.pop_back();
+                }
+            }
+
+            buffer->read_idx.store(write_idx, std::memory_order_release);
+
+            // Samples carried over are still open, so every closed sample is seen here exactly once.
+            if (is_capturing_frame(m_frame))
+            {
+                m_trace_threads.emplace(buffer->tid, buffer->name);
+
+                for (const auto& sample : buffer->samples)
+                {
+                    if (sample.end_time >= 0.0)
+                        m_trace_events.push_back({ sample.name, "cpu", buffer->tid, 'X', sample.start_time, sample.end_time - sample.start_time });
+                }
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    Buffer* acquire_buffer()
+    {
+        Buffer* buffer = nullptr;
+
+        if (m_free_buffers.empty())
+        {
+            m_buffers.push_back(std::make_unique<Buffer>());
+            buffer = m_buffers.back().get();
+        }
+        else
+        {
+            buffer = m_free_buffers.back();
+            m_free_buffers.pop_back();
+        }
+
+        // Latched before the pools are checked, so a buffer acquired right after statistics were enabled gets its pool.
+        buffer->pipeline_statistics = m_pipeline_statistics;
+
+#if defined(DWSF_VULKAN)
+        // Only happens until the pools have grown to the densest frame seen.
+        if (buffer->query_capacity < m_query_capacity)
+        {
+            auto backend = m_backend.lock();
+
+            backend->queue_object_deletion(buffer->query_pool);
+
+            buffer->query_pool     = vk::QueryPool::create(backend, VK_QUERY_TYPE_TIMESTAMP, m_query_capacity);
+            buffer->query_capacity = m_query_capacity;
+        }
+
+        // There is at most one segment per sample, so the statistics pool grows along with the time stamp pool.
+        if (buffer->pipeline_statistics && buffer->statistics_capacity < m_query_capacity)
+        {
+            auto backend = m_backend.lock();
+
+            backend->queue_object_deletion(buffer->statistics_pool);
+
+            buffer->statistics_pool     = vk::QueryPool::create(backend, VK_QUERY_TYPE_PIPELINE_STATISTICS, m_query_capacity, kPipelineStatisticFlags);
+            buffer->statistics_capacity = m_query_capacity;
+        }
+#endif
+
+        buffer->index               = 0;
+        buffer->frame               = m_frame;
+        buffer->segment_count       = 0;
+#if defined(DWSF_VULKAN)
+        buffer->query_index  = 0;
+        buffer->should_reset = true;
+#endif
+
+        return buffer;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Resolves every submitted frame whose time stamps are available, oldest first, without ever waiting on the GPU. Frames
+    // stay buffered for as long as the GPU lags behind, the buffer pool grows to match and is trimmed back to the peak latency
+    // seen in the last LATENCY_WINDOW frames.
+    void resolve_pending_buffers()
+    {
+        while (!m_pending_buffers.empty())
+        {
+            Buffer* buffer = m_pending_buffers.front();
+
+            if (!resolve_samples(buffer))
+            {
+                if (m_pending_buffers.size() < MAX_BUFFERED_FRAMES)
+                    break;
+
+                // Results this late are dropped rather than waited on.
+                m_dropped_frames++;
+
+                if (m_capturing && buffer->frame == m_capture_end_frame - 1)
+                    write_trace();
+            }
+
+            m_pending_buffers.pop_front();
+            m_free_buffers.push_back(buffer);
+        }
+
+        m_latency      = m_pending_buffers.size();
+        m_peak_latency = std::max(m_peak_latency, m_latency);
+
+        if (m_frame % LATENCY_WINDOW == 0)
+        {
+            // In flight, plus the buffer being written and one spare.
+            while (m_buffers.size() > m_peak_latency + 2 && !m_free_buffers.empty())
+            {
+                Buffer* buffer = m_free_buffers.back();
+                m_free_buffers.pop_back();
+
+#if defined(DWSF_VULKAN)
+                // A dropped frame may still be executing.
+                m_backend.lock()->queue_object_deletion(buffer->query_pool);
+                m_backend.lock()->queue_object_deletion(buffer->statistics_pool);
+#endif
+
+                m_buffers.erase(std::find_if(m_buffers.begin(), m_buffers.end(), [buffer](const std::unique_ptr<Buffer>& b) { return b.get() == buffer; }));
+            }
+
+            m_peak_latency = m_latency;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool results_available(Buffer* buffer)
+    {
+#if defined(DWSF_VULKAN)
+        if (buffer->query_index == 0)
+            return true;
+
+        // Every result is followed by its availability.
+        m_query_results.resize(buffer->query_index * 2);
+
+        buffer->query_pool->results(0, buffer->query_index, m_query_results.size() * sizeof(uint64_t), m_query_results.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+        for (uint32_t i = 0; i < buffer->query_index; i++)
+        {
+            if (m_query_results[i * 2 + 1] == 0)
+                return false;
+        }
+
+        uint32_t segment_count = std::min(buffer->segment_count, buffer->statistics_capacity);
+
+        if (buffer->pipeline_statistics && segment_count > 0)
+        {
+            const uint32_t stride = PIPELINE_STATISTICS_COUNT + 1;
+
+            m_statistics_results.resize(segment_count * stride);
+
+            buffer->statistics_pool->results(0, segment_count, m_statistics_results.size() * sizeof(uint64_t), m_statistics_results.data(), stride * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+            for (uint32_t i = 0; i < segment_count; i++)
+            {
+                if (m_statistics_results[i * stride + PIPELINE_STATISTICS_COUNT] == 0)
+                    return false;
+            }
+        }
+#else
+        // Newest first, time stamps usually become available in submission order.
+        for (int32_t i = buffer->index - 1; i >= 0; i--)
+        {
+            if (!buffer->samples[i]->query.result_available())
+                return false;
+        }
+
+        for (int32_t i = int32_t(buffer->pipeline_statistics ? buffer->segment_count : 0) - 1; i >= 0; i--)
+        {
+            for (uint32_t j = 0; j < PIPELINE_STATISTICS_COUNT; j++)
+            {
+                if (!buffer->segments[i]->queries[j].result_available())
+                    return false;
+            }
+        }
+#endif
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Prefix sums over the segments of the frame, returns the number of segments that have results.
+    uint32_t resolve_segments(Buffer* buffer)
+    {
+        if (!buffer->pipeline_statistics)
+            return 0;
+
+#if defined(DWSF_VULKAN)
+        uint32_t segment_count = std::min(buffer->segment_count, buffer->statistics_capacity);
+#else
+        uint32_t segment_count = buffer->segment_count;
+#endif
+
+        m_statistics_prefix.assign((segment_count + 1) * PIPELINE_STATISTICS_COUNT, 0);
+
+        for (uint32_t i = 0; i < segment_count; i++)
+        {
+            for (uint32_t j = 0; j < PIPELINE_STATISTICS_COUNT; j++)
+            {
+                uint64_t value = 0;
+
+#if defined(DWSF_VULKAN)
+                value = m_statistics_results[i * (PIPELINE_STATISTICS_COUNT + 1) + j];
+#else
+                buffer->segments[i]->queries[j].result_64(&value);
+#endif
+
+                m_statistics_prefix[(i + 1) * PIPELINE_STATISTICS_COUNT + j] = m_statistics_prefix[i * PIPELINE_STATISTICS_COUNT + j] + value;
+            }
+        }
+
+        return segment_count;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool resolve_samples(Buffer* buffer)
+    {
+        if (!results_available(buffer))
+            return false;
+
+        m_resolved_samples.clear();
+
+        uint32_t segment_count = resolve_segments(buffer);
+        uint32_t depth         = 0;
+
+        for (int32_t i = 0; i < buffer->index; i++)
+        {
+            auto& sample = buffer->samples[i];
+
+            if (!sample->start)
+            {
+                depth--;
+                continue;
+            }
+
+            // Left open at the end of the frame, there is no end time stamp to resolve against.
+            if (!sample->end_sample)
+                continue;
+
+            uint64_t start_time = 0;
+            uint64_t end_time   = 0;
+
+#if defined(DWSF_VULKAN)
+            bool has_gpu_time = sample->query_index != INVALID_QUERY && sample->end_sample->query_index != INVALID_QUERY;
+
+            if (has_gpu_time)
+            {
+                start_time = m_query_results[sample->query_index * 2];
+                end_time   = m_query_results[sample->end_sample->query_index * 2];
+            }
+#else
+            bool has_gpu_time = true;
+
+            sample->query.result_64(&start_time);
+            sample->end_sample->query.result_64(&end_time);
+#endif
+
+            ResolvedSample resolved;
+
+            resolved.name         = sample->name;
+            resolved.id           = sample->id;
+            resolved.depth        = depth++;
+            resolved.cpu_start    = sample->cpu_time;
+            resolved.cpu_end      = sample->end_sample->cpu_time;
+            resolved.gpu_start    = start_time * m_timestamp_period * 0.001;
+            resolved.gpu_end      = end_time * m_timestamp_period * 0.001;
+            resolved.has_gpu_time = has_gpu_time;
+
+            resolved.allocations     = sample->end_sample->allocations - sample->allocations;
+            resolved.allocated_bytes = sample->end_sample->allocated_bytes - sample->allocated_bytes;
+
+            resolved.has_pipeline_statistics = buffer->pipeline_statistics && sample->end_sample->segment <= segment_count;
+
+            for (uint32_t j = 0; resolved.has_pipeline_statistics && j < PIPELINE_STATISTICS_COUNT; j++)
+                resolved.pipeline_statistics[j] = m_statistics_prefix[sample->end_sample->segment * PIPELINE_STATISTICS_COUNT + j] - m_statistics_prefix[sample->segment * PIPELINE_STATISTICS_COUNT + j];
+
+            m_resolved_samples.push_back(resolved);
+
+            if (has_gpu_time)
+                accumulate_statistics(TIME_SOURCE_GPU, resolved.id, (resolved.gpu_end - resolved.gpu_start) * 0.001);
+        }
+
+        commit_statistics(TIME_SOURCE_GPU);
+
+        if (is_capturing_frame(buffer->frame))
+        {
+            capture_resolved_samples();
+
+            if (buffer->frame == m_capture_end_frame - 1)
+                write_trace();
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void capture_resolved_samples()
+    {
+        if (m_resolved_samples.empty())
+            return;
+
+#if defined(DWSF_VULKAN)
+        // There is no common clock without VK_EXT_calibrated_timestamps, so the GPU timeline of every frame starts where
+        // its first sample was recorded on the CPU. Gaps within a frame are exact, the latency to the CPU is not.
+        m_gpu_clock_offset = m_resolved_samples[0].cpu_start - m_resolved_samples[0].gpu_start;
+#endif
+
+        for (const auto& sample : m_resolved_samples)
+        {
+            m_trace_events.push_back({ sample.name, "cpu", MAIN_THREAD_TID, 'X', sample.cpu_start, sample.cpu_end - sample.cpu_start });
+
+            if (sample.has_gpu_time)
+                m_trace_events.push_back({ sample.name, "gpu", GPU_TID, 'X', sample.gpu_start + m_gpu_clock_offset, sample.gpu_end - sample.gpu_start });
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void capture_allocations(uint32_t frame_count)
+    {
+#if defined(DWSF_ALLOCATION_TRACKING)
+        if (m_allocation_capture_frames > 0)
+        {
+            DW_LOG_WARNING("PROFILER: An allocation capture is already in progress.");
+            return;
+        }
+
+        m_allocation_capture_frames = frame_count;
+#else
+        DW_LOG_WARNING("PROFILER: Allocation tracking requires building with ENABLE_ALLOCATION_TRACKING.");
+#endif
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void capture(uint32_t frame_count, const std::string& path)
+    {
+        if (m_capturing)
+        {
+            DW_LOG_WARNING("PROFILER: A capture is already in progress, ignoring request for {}", path);
+            return;
+        }
+
+        if (frame_count == 0)
+            return;
+
+        m_capturing           = true;
+        m_capture_path        = path;
+        m_capture_start_frame = m_frame + 1;
+        m_capture_end_frame   = m_capture_start_frame + frame_count;
+
+        m_trace_events.clear();
+        m_trace_threads.clear();
+        m_trace_threads[MAIN_THREAD_TID] = "Main Thread";
+        m_trace_threads[GPU_TID]         = "GPU";
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    inline bool is_capturing_frame(uint64_t frame) { return m_capturing && frame >= m_capture_start_frame && frame < m_capture_end_frame; }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    static void write_json_string(std::ofstream& file, const char* str)
+    {
+        file << '"';
+
+        for (; *str; str++)
+        {
+            char c = *str;
+
+            if (c == '"' || c == '\\')
+                file << '\\' << c;
+            else if (uint8_t(c) < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                file << escaped;
+            }
+            else
+                file << c;
+        }
+
+        file << '"';
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Chrome Trace Event format, which both chrome://tracing and ui.perfetto.dev open. Time stamps are in microseconds.
+    void write_trace()
+    {
+        m_capturing = false;
+
+        std::ofstream file(m_capture_path);
+
+        if (!file.is_open())
+        {
+            DW_LOG_ERROR("PROFILER: Failed to open trace file for writing: {}", m_capture_path);
+            return;
+        }
+
+        char buffer[256];
+
+        file << "{\"traceEvents\":[\n";
+        file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"dwSampleFramework\"}}";
+
+        for (const auto& thread : m_trace_threads)
+        {
+            snprintf(buffer, sizeof(buffer), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", thread.first);
+            file << buffer;
+            write_json_string(file, thread.second.c_str());
+            file << "}}";
+
+            snprintf(buffer, sizeof(buffer), ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"sort_index\":%u}}", thread.first, thread.first);
+            file << buffer;
+        }
+
+        for (const auto& event : m_trace_events)
+        {
+            file << ",\n{\"name\":";
+            write_json_string(file, event.name);
+
+            double ts = event.time - m_capture_origin;
+
+            if (event.phase == 'X')
+                snprintf(buffer, sizeof(buffer), ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event.category, event.tid, ts, event.value);
+            else if (event.phase == 'i')
+                snprintf(buffer, sizeof(buffer), ",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"args\":{\"frame\":%u}}", event.category, event.tid, ts, uint32_t(event.value));
+            else
+                snprintf(buffer, sizeof(buffer), ",\"cat\":\"%s\",\"ph\":\"C\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%f}}", event.category, event.tid, ts, event.value);
+
+            file << buffer;
+        }
+
+        file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+        DW_LOG_INFO("PROFILER: Wrote {} trace events to {}", m_trace_events.size(), m_capture_path);
+
+        m_trace_events.clear();
+        m_trace_events.shrink_to_fit();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_frame()
+    {
+        double frame_start = cpu_time();
+
+        m_frame++;
+        m_write_buffer->frame = m_frame;
+
+        if (m_capturing)
+        {
+            if (m_frame == m_capture_start_frame)
+            {
+                m_capture_origin = frame_start;
+
+#if !defined(DWSF_VULKAN)
+                // GL time stamps share the clock of GL_TIMESTAMP, so a single query aligns the GPU timeline to the CPU.
+                GLint64 gpu_time = 0;
+                glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+                m_gpu_clock_offset = cpu_time() - gpu_time * 0.001;
+#endif
+            }
+
+            if (m_frame > m_capture_start_frame && m_frame <= m_capture_end_frame)
+                m_trace_events.push_back({ "Frame Time (ms)", "frame", MAIN_THREAD_TID, 'C', m_frame_start, (frame_start - m_frame_start) * 0.001 });
+
+            if (is_capturing_frame(m_frame))
+                m_trace_events.push_back({ "Frame", "frame", MAIN_THREAD_TID, 'i', frame_start, double(m_frame - m_capture_start_frame) });
+        }
+
+        m_frame_start = frame_start;
+
+#if defined(DWSF_ALLOCATION_TRACKING)
+        if (m_allocation_capture_frames > 0 && !g_allocation_capture.load(std::memory_order_relaxed))
+            begin_allocation_capture();
+#endif
+
+        resolve_pending_buffers();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void end_frame()
+    {
+        for (uint32_t i = 0; i < COUNTER_COUNT; i++)
+        {
+            uint64_t value = g_counters[i].exchange(0, std::memory_order_relaxed);
+
+            g_frame_counters[i].store(value, std::memory_order_relaxed);
+
+            if (is_capturing_frame(m_frame))
+                m_trace_events.push_back({ counter_name(Counter(i)), "counters", MAIN_THREAD_TID, 'C', m_frame_start, double(value) });
+        }
+
+        if (is_capturing_frame(m_frame))
+        {
+            for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+                m_trace_events.push_back({ kMemoryCounterNames[i], "memory", MAIN_THREAD_TID, 'C', m_frame_start, double(g_memory_bytes[i].load(std::memory_order_relaxed)) / (1024.0 * 1024.0) });
+        }
+
+#if defined(DWSF_VULKAN)
+        while (m_query_capacity < uint32_t(m_write_buffer->index))
+            m_query_capacity *= 2;
+#endif
+
+        // A scope left open across frames, its statistics are lost but no query may stay active.
+        end_segment(m_write_buffer);
+
+        m_pending_buffers.push_back(m_write_buffer);
+        m_write_buffer = acquire_buffer();
+
+        merge_thread_samples();
+        commit_statistics(TIME_SOURCE_CPU);
+
+#if defined(DWSF_ALLOCATION_TRACKING)
+        if (g_allocation_capture.load(std::memory_order_relaxed) && --m_allocation_capture_frames == 0)
+            end_allocation_capture();
+#endif
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_ALLOCATION_TRACKING)
+    void begin_allocation_capture()
+    {
+        // The first unwind may load the unwinder library, get that out of the way before any stack is recorded.
+        void* frames[ALLOCATION_STACK_DEPTH];
+        capture_stack(frames, ALLOCATION_STACK_DEPTH);
+
+        // Allocated with calloc() so that it does not show up in the frame's allocations.
+        AllocationRecord* records = (AllocationRecord*)calloc(ALLOCATION_TABLE_SIZE, sizeof(AllocationRecord));
+
+        {
+            std::lock_guard<std::mutex> lock(g_allocation_mutex);
+
+            g_allocation_records  = records;
+            g_allocation_overflow = 0;
+        }
+
+        g_allocation_capture.store(true, std::memory_order_relaxed);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void end_allocation_capture()
+    {
+        g_allocation_capture.store(false, std::memory_order_relaxed);
+
+        AllocationRecord* records = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(g_allocation_mutex);
+
+            records              = g_allocation_records;
+            g_allocation_records = nullptr;
+        }
+
+        uint64_t allocations     = t_allocations;
+        uint64_t allocated_bytes = t_allocated_bytes;
+
+        std::vector<AllocationRecord*> sorted;
+
+        for (uint32_t i = 0; i < ALLOCATION_TABLE_SIZE; i++)
+        {
+            if (records[i].count > 0)
+                sorted.push_back(&records[i]);
+        }
+
+        std::sort(sorted.begin(), sorted.end(), [](const AllocationRecord* a, const AllocationRecord* b) { return a->count > b->count; });
+
+        if (sorted.size() > MAX_ALLOCATION_SITES)
+            sorted.resize(MAX_ALLOCATION_SITES);
+
+        m_allocation_sites.clear();
+
+        for (auto record : sorted)
+        {
+            AllocationSite site;
+
+            site.count = record->count;
+            site.bytes = record->bytes;
+
+            for (uint32_t i = 0; i < record->depth; i++)
+                site.stack.push_back(symbolize(record->frames[i]));
+
+            m_allocation_sites.push_back(site);
+        }
+
+        if (g_allocation_overflow > 0)
+            DW_LOG_WARNING("PROFILER: Allocation capture ran out of sites, {} allocations were not recorded.", g_allocation_overflow);
+
+        free(records);
+
+        // Symbolizing allocates plenty, keep it out of the next frame's counters.
+        g_counters[COUNTER_ALLOCATIONS].fetch_sub(t_allocations - allocations, std::memory_order_relaxed);
+        g_counters[COUNTER_ALLOCATED_BYTES].fetch_sub(t_allocated_bytes - allocated_bytes, std::memory_order_relaxed);
+    }
+#endif
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Scopes recorded several times in a frame, or on several threads, add up to a single value for that frame.
+    void accumulate_statistics(TimeSource source, uint32_t id, double ms)
+    {
+        if (id >= MAX_SCOPES)
+            return;
+
+        if (m_frame_times[source][id] < 0.0)
+        {
+            m_frame_times[source][id] = 0.0;
+            m_frame_scopes[source].push_back(id);
+        }
+
+        m_frame_times[source][id] += ms;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void commit_statistics(TimeSource source)
+    {
+        bool reset = m_reset_statistics.exchange(false, std::memory_order_relaxed);
+
+        for (uint32_t id = 0; reset && id < MAX_SCOPES; id++)
+        {
+            ScopeStatistics* scope = m_scope_statistics[id].load(std::memory_order_relaxed);
+
+            if (scope)
+            {
+                scope->windows[TIME_SOURCE_CPU].reset();
+                scope->windows[TIME_SOURCE_GPU].reset();
+            }
+        }
+
+        for (auto id : m_frame_scopes[source])
+        {
+            ScopeStatistics* scope = m_scope_statistics[id].load(std::memory_order_relaxed);
+
+            if (!scope)
+            {
+                scope = new ScopeStatistics();
+                m_scope_statistics[id].store(scope, std::memory_order_release);
+            }
+
+            scope->windows[source].push(float(m_frame_times[source][id]));
+            m_frame_times[source][id] = -1.0;
+        }
+
+        m_frame_scopes[source].clear();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool statistics(uint32_t id, TimeSource source, Statistics& stats)
+    {
+        if (id >= MAX_SCOPES)
+            return false;
+
+        ScopeStatistics* scope = m_scope_statistics[id].load(std::memory_order_acquire);
+
+        return scope && scope->windows[source].statistics(stats);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_IMGUI)
+    // Samples are stored in begin order along with their depth, so a node is only visited if all of its parents are open.
+    template <typename T, typename F>
+    static void sample_tree(const std::vector<T>& samples, F tree_node)
+    {
+        uint32_t open_depth = 0;
+
+        for (uint32_t i = 0; i < samples.size(); i++)
+        {
+            if (samples[i].depth > open_depth)
+                continue;
+
+            while (open_depth > samples[i].depth)
+            {
+                ImGui::TreePop();
+                open_depth--;
+            }
+
+            if (tree_node(std::to_string(i), samples[i]))
+                open_depth++;
+        }
+
+        for (; open_depth > 0; open_depth--)
+            ImGui::TreePop();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void allocation_ui()
+    {
+#if defined(DWSF_ALLOCATION_TRACKING)
+        ImGui::Text("%llu allocations, %.1f KB this frame", (unsigned long long)g_frame_counters[COUNTER_ALLOCATIONS].load(std::memory_order_relaxed), g_frame_counters[COUNTER_ALLOCATED_BYTES].load(std::memory_order_relaxed) / 1024.0);
+
+        if (m_allocation_capture_frames > 0)
+            ImGui::Text("Capturing allocations, %u frames left...", m_allocation_capture_frames);
+        else
+        {
+            ImGui::InputInt("Allocation Frames", &m_ui_allocation_frames);
+
+            if (ImGui::Button("Capture Allocations"))
+                capture_allocations(std::max(m_ui_allocation_frames, 1));
+        }
+
+        for (uint32_t i = 0; i < m_allocation_sites.size(); i++)
+        {
+            const AllocationSite& site = m_allocation_sites[i];
+
+            if (ImGui::TreeNode((void*)(intptr_t)i, "%llu allocations, %.1f KB | %s", (unsigned long long)site.count, site.bytes / 1024.0, site.stack.empty() ? "Unknown" : site.stack[0].c_str()))
+            {
+                for (const auto& frame : site.stack)
+                    ImGui::TextUnformatted(frame.c_str());
+
+                ImGui::TreePop();
+            }
+        }
+#else
+        ImGui::TextUnformatted("Build with ENABLE_ALLOCATION_TRACKING to track heap allocations.");
+#endif
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void memory_ui()
+    {
+        uint64_t total_bytes       = 0;
+        uint64_t total_allocations = 0;
+
+        for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+        {
+            MemoryUsage usage = memory_usage(MemoryCategory(i));
+
+            ImGui::Text("%s: %.2f MB (peak %.2f MB, %llu allocations)", kMemoryCategoryNames[i], usage.bytes / (1024.0 * 1024.0), usage.peak_bytes / (1024.0 * 1024.0), (unsigned long long)usage.allocations);
+
+            total_bytes += usage.bytes;
+            total_allocations += usage.allocations;
+        }
+
+        ImGui::Text("Total: %.2f MB (%llu allocations)", total_bytes / (1024.0 * 1024.0), (unsigned long long)total_allocations);
+
+#if defined(DWSF_VULKAN)
+        // Per heap figures straight from VMA, these also cover allocations made outside the wrappers and the unused space of
+        // the memory blocks VMA sub-allocates from.
+        auto backend = m_backend.lock();
+
+        const VkPhysicalDeviceMemoryProperties* memory_properties = nullptr;
+        vmaGetMemoryProperties(backend->allocator(), &memory_properties);
+
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+        vmaGetHeapBudgets(backend->allocator(), budgets);
+
+        ImGui::Separator();
+
+        for (uint32_t i = 0; i < memory_properties->memoryHeapCount; i++)
+        {
+            const VmaBudget& budget = budgets[i];
+
+            ImGui::Text("Heap %u (%s): %.2f / %.2f MB used | %.2f MB in %u allocations, %.2f MB in %u blocks",
+                        i,
+                        (memory_properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "Device" : "Host",
+                        budget.usage / (1024.0 * 1024.0),
+                        budget.budget / (1024.0 * 1024.0),
+                        budget.statistics.allocationBytes / (1024.0 * 1024.0),
+                        budget.statistics.allocationCount,
+                        budget.statistics.blockBytes / (1024.0 * 1024.0),
+                        budget.statistics.blockCount);
+        }
+#endif
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void ui()
+    {
+        if (m_capturing)
+            ImGui::Text("Capturing trace to %s...", m_capture_path.c_str());
+        else
+        {
+            ImGui::InputInt("Trace Frames", &m_ui_trace_frames);
+
+            if (ImGui::Button("Capture Trace"))
+                capture(std::max(m_ui_trace_frames, 1), "trace.json");
+        }
+
+        ImGui::Text("GPU readback latency: %u frames (%u buffers, %u dropped)", m_latency, uint32_t(m_buffers.size()), m_dropped_frames);
+
+        bool pipeline_statistics = m_pipeline_statistics;
+
+        if (ImGui::Checkbox("Pipeline Statistics", &pipeline_statistics))
+            set_pipeline_statistics(pipeline_statistics);
+
+        sample_tree(m_resolved_samples, [](const std::string& id, const ResolvedSample& sample) {
+            float cpu_time = float((sample.cpu_end - sample.cpu_start) * 0.001);
+            float gpu_time = float((sample.gpu_end - sample.gpu_start) * 0.001);
+
+            char label[512];
+            int  length = snprintf(label, sizeof(label), "%s | %f ms (CPU) | %f ms (GPU)", sample.name, cpu_time, gpu_time);
+
+            if (sample.has_pipeline_statistics)
+            {
+                const uint64_t* stats = sample.pipeline_statistics;
+
+                length += snprintf(label + length,
+                                   sizeof(label) - length,
+                                   " | IA %llu verts %llu prims | VS %llu | Clip %llu -> %llu | FS %llu | CS %llu",
+                                   (unsigned long long)stats[0],
+                                   (unsigned long long)stats[1],
+                                   (unsigned long long)stats[2],
+                                   (unsigned long long)stats[3],
+                                   (unsigned long long)stats[4],
+                                   (unsigned long long)stats[5],
+                                   (unsigned long long)stats[6]);
+            }
+
+#if defined(DWSF_ALLOCATION_TRACKING)
+            snprintf(label + length, sizeof(label) - length, " | %llu allocs (%.1f KB)", (unsigned long long)sample.allocations, sample.allocated_bytes / 1024.0);
+#endif
+
+            return ImGui::TreeNode(id.c_str(), "%s", label);
+        });
+
+        if (ImGui::TreeNode("Counters"))
+        {
+            for (uint32_t i = 0; i < COUNTER_COUNT; i++)
+                ImGui::Text("%s: %llu", kCounterNames[i], (unsigned long long)g_frame_counters[i].load(std::memory_order_relaxed));
+
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Allocations"))
+        {
+            allocation_ui();
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("GPU Memory"))
+        {
+            memory_ui();
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Stopwatches"))
+        {
+            if (ImGui::Button("Reset"))
+                Stopwatch::reset_all();
+
+            Stopwatch::all(m_ui_stopwatches);
+
+            for (const auto& stopwatch : m_ui_stopwatches)
+            {
+                double mean = stopwatch.count > 0 ? double(stopwatch.total) / double(stopwatch.count) : 0.0;
+
+                ImGui::Text("%s: %llu calls | mean %.3f us | min %.3f us | max %.3f us | total %.3f ms",
+                            stopwatch.name,
+                            (unsigned long long)stopwatch.count,
+                            mean * 0.001,
+                            stopwatch.min * 0.001,
+                            stopwatch.max * 0.001,
+                            stopwatch.total * 0.000001);
+            }
+
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Statistics"))
+        {
+            if (ImGui::Button("Reset"))
+                m_reset_statistics.store(true, std::memory_order_relaxed);
+
+            for (uint32_t id = 0; id < MAX_SCOPES; id++)
+            {
+                ScopeStatistics* scope = m_scope_statistics[id].load(std::memory_order_acquire);
+
+                if (!scope)
+                    continue;
+
+                ImGui::PushID(id);
+
+                if (ImGui::TreeNode("scope", "%s", marker_name(id)))
+                {
+                    const char* source_names[] = { "CPU", "GPU" };
+
+                    for (uint32_t source = 0; source < 2; source++)
+                    {
+                        Statistics stats;
+
+                        if (!scope->windows[source].statistics(stats))
+                            continue;
+
+                        ImGui::Text("%s | min %.3f | mean %.3f | max %.3f | std dev %.3f ms", source_names[source], stats.min, stats.mean, stats.max, stats.std_dev);
+                        ImGui::Text("%s | p50 %.3f | p95 %.3f | p99 %.3f ms | %u spikes in %u frames", source_names[source], stats.p50, stats.p95, stats.p99, stats.spikes, stats.frames);
+
+                        scope->windows[source].history(m_ui_history);
+                        ImGui::PlotLines(source_names[source], m_ui_history.data(), m_ui_history.size(), 0, nullptr, 0.0f, stats.max, ImVec2(0, 40));
+                    }
+
+                    ImGui::TreePop();
+                }
+
+                ImGui::PopID();
+            }
+
+            ImGui::TreePop();
+        }
+
+        std::lock_guard<std::mutex> lock(m_thread_buffers_mutex);
+
+        for (uint32_t i = 0; i < m_thread_buffers.size(); i++)
+        {
+            auto& buffer = m_thread_buffers[i];
+
+            ImGui::PushID(i);
+
+            if (ImGui::TreeNode("thread", "%s (%d dropped)", buffer->name.c_str(), (int)buffer->dropped.load(std::memory_order_relaxed)))
+            {
+                sample_tree(buffer->samples, [](const std::string& id, const ThreadSample& sample) {
+                    if (sample.end_time < 0.0)
+                        return ImGui::TreeNode(id.c_str(), "%s | running", sample.name);
+                    else
+                        return ImGui::TreeNode(id.c_str(), "%s | %f ms (CPU)", sample.name, float((sample.end_time - sample.start_time) * 0.001));
+                });
+
+                ImGui::TreePop();
+            }
+
+            ImGui::PopID();
+        }
+    }
+#endif
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    Buffer*                                    m_write_buffer = nullptr;
+    std::deque<Buffer*>                        m_pending_buffers; // Submitted frames waiting for their time stamps, oldest first.
+    std::vector<Buffer*>                       m_free_buffers;
+    std::vector<std::unique_ptr<Buffer>>       m_buffers;
+    uint32_t                                   m_latency        = 0;
+    uint32_t                                   m_peak_latency   = 0;
+    uint32_t                                   m_dropped_frames = 0;
+    std::stack<Sample*>                        m_sample_stack;
+    std::vector<ResolvedSample>                m_resolved_samples;
+    std::thread::id                            m_main_thread;
+    uint32_t                                   m_generation = 0;
+    uint32_t                                   m_next_tid   = GPU_TID + 1;
+    std::mutex                                 m_thread_buffers_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_thread_buffers;
+    uint64_t                                   m_frame            = 0;
+    double                                     m_frame_start      = 0.0;
+    double                                     m_timestamp_period = 1.0; // Nanoseconds per GPU tick.
+
+    // Trace capture.
+    bool                            m_capturing = false;
+    std::string                     m_capture_path;
+    uint64_t                        m_capture_start_frame = 0;
+    uint64_t                        m_capture_end_frame   = 0;
+    double                          m_capture_origin      = 0.0;
+    double                          m_gpu_clock_offset    = 0.0;
+    std::vector<TraceEvent>         m_trace_events;
+    std::map<uint32_t, std::string> m_trace_threads;
+    int32_t                         m_ui_trace_frames = 10;
+
+    // Statistics.
+    std::atomic<ScopeStatistics*>      m_scope_statistics[MAX_SCOPES];
+    std::atomic<bool>                  m_reset_statistics = { false };
+    double                             m_frame_times[2][MAX_SCOPES]; // Negative until the scope is recorded in the current frame.
+    std::vector<uint32_t>              m_frame_scopes[2];
+    std::vector<float>                 m_ui_history;
+    std::vector<Stopwatch::Statistics> m_ui_stopwatches;
+
+    // Allocation tracking.
+    uint32_t                    m_allocation_capture_frames = 0; // Frames left to record, including the current one.
+    std::vector<AllocationSite> m_allocation_sites;
+    int32_t                     m_ui_allocation_frames = 1;
+
+    // Pipeline statistics.
+    bool                  m_pipeline_statistics = false;
+    bool                  m_segment_active      = false;
+    std::vector<uint64_t> m_statistics_prefix;
+
+    static thread_local std::string t_thread_name;
 
-#ifdef WIN32
-    LARGE_INTEGER m_frequency;
+#if defined(DWSF_VULKAN)
+    std::weak_ptr<vk::Backend> m_backend;
+    std::vector<uint64_t>      m_query_results;
+    std::vector<uint64_t>      m_statistics_results;
+    VkCommandBuffer            m_segment_cmd_buf = VK_NULL_HANDLE;
+    uint32_t                   m_query_capacity = INITIAL_QUERY_COUNT;
 #endif
 };
 
-Profiler* g_profiler = nullptr;
+std::atomic<uint64_t>    g_counters[COUNTER_COUNT];
+Profiler*                g_profiler            = nullptr;
+static uint32_t          g_profiler_generation = 0;
+thread_local std::string Profiler::t_thread_name;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Profiler::ThreadBufferHandle::~ThreadBufferHandle()
+{
+    if (buffer && g_profiler && generation == g_profiler->m_generation)
+        buffer->retired.store(true, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct NameRegistry
+{
+    std::mutex                                m_mutex;
+    std::unordered_map<std::string, uint32_t> m_ids;
+    std::deque<std::string>                   m_names;
+};
+
+// Function local so that markers constructed during static initialization find it.
+static NameRegistry& name_registry()
+{
+    static NameRegistry registry;
+    return registry;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t intern(const std::string& name)
+{
+    NameRegistry&               registry = name_registry();
+    std::lock_guard<std::mutex> lock(registry.m_mutex);
+
+    auto it = registry.m_ids.find(name);
+
+    if (it != registry.m_ids.end())
+        return it->second;
+
+    uint32_t id = registry.m_names.size();
+
+    registry.m_names.push_back(name);
+    registry.m_ids[name] = id;
+
+    return id;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const char* marker_name(uint32_t id)
+{
+    NameRegistry&               registry = name_registry();
+    std::lock_guard<std::mutex> lock(registry.m_mutex);
+
+    // std::deque never moves its elements on push_back, so the pointer stays valid.
+    return id < registry.m_names.size() ? registry.m_names[id].c_str() : nullptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Marker::Marker(const std::string& name) :
+    id(intern(name)), name(marker_name(id))
+{
+}
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-ScopedProfile::ScopedProfile(std::string name
+ScopedProfile::ScopedProfile(const Marker& marker
 #if defined(DWSF_VULKAN)
                              ,
-                             vk::CommandBuffer::Ptr cmd_buf
+                             const vk::CommandBuffer::Ptr& cmd_buf
 #endif
                              ) :
-    m_name(name)
+#if defined(DWSF_VULKAN)
+    m_cmd_buf(cmd_buf),
+#endif
+    m_marker(marker)
 {
-    begin_sample(m_name
+    begin_sample(m_marker
 #if defined(DWSF_VULKAN)
                  ,
-                 cmd_buf
+                 m_cmd_buf
 #endif
     );
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
 
+ScopedProfile::ScopedProfile(const std::string& name
 #if defined(DWSF_VULKAN)
-    m_cmd_buf = cmd_buf;
+                             ,
+                             const vk::CommandBuffer::Ptr& cmd_buf
+#endif
+                             ) :
+#if defined(DWSF_VULKAN)
+    m_cmd_buf(cmd_buf),
+#endif
+    m_marker(name)
+{
+    begin_sample(m_marker
+#if defined(DWSF_VULKAN)
+                 ,
+                 m_cmd_buf
 #endif
+    );
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 ScopedProfile::~ScopedProfile()
 {
-    end_sample(m_name
+    end_sample(m_marker
 #if defined(DWSF_VULKAN)
                ,
                m_cmd_buf
@@ -335,6 +2174,16 @@ void initialize(
         backend
 #endif
     );
+
+    // Invalidates the thread buffers cached by threads that recorded samples into a previous instance.
+    g_profiler->m_generation = ++g_profiler_generation;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void set_thread_name(const std::string& name)
+{
+    Profiler::t_thread_name = name;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -343,14 +2192,48 @@ void shutdown() { DW_SAFE_DELETE(g_profiler); }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void begin_sample(std::string name
+void begin_sample(const Marker& marker
+#if defined(DWSF_VULKAN)
+                  ,
+                  const vk::CommandBuffer::Ptr& cmd_buf
+#endif
+)
+{
+    g_profiler->begin_sample(marker
+#if defined(DWSF_VULKAN)
+                             ,
+                             cmd_buf
+#endif
+    );
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void end_sample(const Marker& marker
+#if defined(DWSF_VULKAN)
+                ,
+                const vk::CommandBuffer::Ptr& cmd_buf
+#endif
+)
+{
+    g_profiler->end_sample(marker
+#if defined(DWSF_VULKAN)
+                           ,
+                           cmd_buf
+#endif
+    );
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void begin_sample(const std::string& name
 #if defined(DWSF_VULKAN)
                   ,
-                  vk::CommandBuffer::Ptr cmd_buf
+                  const vk::CommandBuffer::Ptr& cmd_buf
 #endif
 )
 {
-    g_profiler->begin_sample(name
+    g_profiler->begin_sample(Marker(name)
 #if defined(DWSF_VULKAN)
                              ,
                              cmd_buf
@@ -360,14 +2243,14 @@ void begin_sample(std::string name
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void end_sample(std::string name
+void end_sample(const std::string& name
 #if defined(DWSF_VULKAN)
                 ,
-                vk::CommandBuffer::Ptr cmd_buf
+                const vk::CommandBuffer::Ptr& cmd_buf
 #endif
 )
 {
-    g_profiler->end_sample(name
+    g_profiler->end_sample(Marker(name)
 #if defined(DWSF_VULKAN)
                            ,
                            cmd_buf
@@ -377,6 +2260,21 @@ void end_sample(std::string name
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void begin_cpu_sample(const Marker& marker)
+{
+    if (g_profiler)
+        g_profiler->begin_thread_sample(marker);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void end_cpu_sample()
+{
+    if (g_profiler)
+        g_profiler->end_thread_sample();
+}
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void begin_frame() { g_profiler->begin_frame(); }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -385,6 +2283,166 @@ void end_frame() { g_profiler->end_frame(); }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void capture(uint32_t frame_count, const std::string& path)
+{
+    g_profiler->capture(frame_count, path);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool is_capturing() { return g_profiler->m_capturing; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool statistics(const Marker& marker, TimeSource source, Statistics& stats)
+{
+    return g_profiler->statistics(marker.id, source, stats);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool statistics(const std::string& name, TimeSource source, Statistics& stats)
+{
+    return g_profiler->statistics(intern(name), source, stats);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void reset_statistics() { g_profiler->m_reset_statistics.store(true, std::memory_order_relaxed); }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void scopes(std::vector<std::string>& names)
+{
+    names.clear();
+
+    for (uint32_t id = 0; id < MAX_SCOPES; id++)
+    {
+        if (g_profiler->m_scope_statistics[id].load(std::memory_order_acquire))
+            names.push_back(marker_name(id));
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void set_pipeline_statistics(bool enabled) { g_profiler->set_pipeline_statistics(enabled); }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool pipeline_statistics() { return g_profiler->m_pipeline_statistics; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_VULKAN)
+void begin_render_pass(const vk::CommandBuffer::Ptr& cmd_buf, const VkRenderPassBeginInfo& info, VkSubpassContents contents)
+{
+    if (g_profiler)
+        g_profiler->begin_render_pass(cmd_buf, info, contents);
+    else
+        vkCmdBeginRenderPass(cmd_buf->handle(), &info, contents);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void end_render_pass(const vk::CommandBuffer::Ptr& cmd_buf)
+{
+    if (g_profiler)
+        g_profiler->end_render_pass(cmd_buf);
+    else
+        vkCmdEndRenderPass(cmd_buf->handle());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+#endif
+
+uint64_t counter(Counter counter) { return g_frame_counters[counter].load(std::memory_order_relaxed); }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const char* counter_name(Counter counter) { return kCounterNames[counter]; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ScopedMemoryCategory::ScopedMemoryCategory(MemoryCategory category) :
+    m_previous(t_memory_category)
+{
+    t_memory_category = category;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ScopedMemoryCategory::~ScopedMemoryCategory()
+{
+    t_memory_category = m_previous;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MemoryCategory memory_category(MemoryCategory fallback) { return t_memory_category == MEMORY_CATEGORY_COUNT ? fallback : t_memory_category; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void track_allocation(MemoryCategory category, uint64_t size)
+{
+    uint64_t bytes = g_memory_bytes[category].fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak  = g_memory_peak_bytes[category].load(std::memory_order_relaxed);
+
+    while (bytes > peak && !g_memory_peak_bytes[category].compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        ;
+
+    g_memory_allocations[category].fetch_add(1, std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void track_free(MemoryCategory category, uint64_t size)
+{
+    g_memory_bytes[category].fetch_sub(size, std::memory_order_relaxed);
+    g_memory_allocations[category].fetch_sub(1, std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MemoryUsage memory_usage(MemoryCategory category)
+{
+    MemoryUsage usage;
+
+    usage.bytes       = g_memory_bytes[category].load(std::memory_order_relaxed);
+    usage.peak_bytes  = g_memory_peak_bytes[category].load(std::memory_order_relaxed);
+    usage.allocations = g_memory_allocations[category].load(std::memory_order_relaxed);
+
+    return usage;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const char* memory_category_name(MemoryCategory category) { return kMemoryCategoryNames[category]; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool allocation_tracking()
+{
+#if defined(DWSF_ALLOCATION_TRACKING)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void capture_allocations(uint32_t frame_count) { g_profiler->capture_allocations(frame_count); }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool is_capturing_allocations() { return g_profiler->m_allocation_capture_frames > 0; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void allocation_sites(std::vector<AllocationSite>& sites) { sites = g_profiler->m_allocation_sites; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 #if defined(DWSF_IMGUI)
 void ui()
 {
@@ -394,4 +2452,96 @@ void ui()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 } // namespace profiler
-} // namespace dw
\ No newline at end of file
+} // namespace dw
+
+#if defined(DWSF_ALLOCATION_TRACKING)
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void* aligned_malloc(std::size_t size, std::size_t alignment)
+{
+#    if defined(WIN32)
+    return _aligned_malloc(size, alignment);
+#    else
+    void* ptr = nullptr;
+    return posix_memalign(&ptr, std::max(alignment, sizeof(void*)), size) == 0 ? ptr : nullptr;
+#    endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void aligned_free(void* ptr)
+{
+#    if defined(WIN32)
+    _aligned_free(ptr);
+#    else
+    free(ptr);
+#    endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new(std::size_t size)
+{
+    dw::profiler::record_allocation(size);
+
+    if (void* ptr = malloc(size > 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    dw::profiler::record_allocation(size);
+
+    return malloc(size > 0 ? size : 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    dw::profiler::record_allocation(size);
+
+    if (void* ptr = aligned_malloc(size > 0 ? size : 1, std::size_t(alignment)))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { aligned_free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { aligned_free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { aligned_free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { aligned_free(ptr); }
+#endif
\ No newline at end of file
@@ -0,0 +1,586 @@
+#if !defined(DWSF_VULKAN)
+
+#    include <texture_streamer.h>
+#    include <material.h>
+#    include <mesh.h>
+#    include <logger.h>
+#    include <stb_image.h>
+#    include <imgui.h>
+#    include <algorithm>
+#    include <cfloat>
+
+namespace dw
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float g_srgb_to_linear[256];
+static bool  g_srgb_lut_initialized = false;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint8_t linear_to_srgb(float value)
+{
+    float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+    return (uint8_t)std::min(255.0f, std::max(0.0f, srgb * 255.0f + 0.5f));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// 2x2 box filter. Colour channels of sRGB images are averaged in linear space so that mips do not darken.
+static void downsample(const uint8_t* src, uint32_t src_w, uint32_t src_h, uint8_t* dst, uint32_t dst_w, uint32_t dst_h, uint32_t channels, bool srgb)
+{
+    for (uint32_t y = 0; y < dst_h; y++)
+    {
+        uint32_t y0 = std::min(y * 2, src_h - 1);
+        uint32_t y1 = std::min(y * 2 + 1, src_h - 1);
+
+        for (uint32_t x = 0; x < dst_w; x++)
+        {
+            uint32_t x0 = std::min(x * 2, src_w - 1);
+            uint32_t x1 = std::min(x * 2 + 1, src_w - 1);
+
+            const uint8_t* p00 = &src[(y0 * src_w + x0) * channels];
+            const uint8_t* p01 = &src[(y0 * src_w + x1) * channels];
+            const uint8_t* p10 = &src[(y1 * src_w + x0) * channels];
+            const uint8_t* p11 = &src[(y1 * src_w + x1) * channels];
+
+            uint8_t* out = &dst[(y * dst_w + x) * channels];
+
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                if (srgb && c < 3)
+                    out[c] = linear_to_srgb(0.25f * (g_srgb_to_linear[p00[c]] + g_srgb_to_linear[p01[c]] + g_srgb_to_linear[p10[c]] + g_srgb_to_linear[p11[c]]));
+                else
+                    out[c] = (uint8_t)((p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void texture_formats(uint32_t channels, bool srgb, GLenum& internal_format, GLenum& format)
+{
+    if (channels == 1)
+    {
+        internal_format = GL_R8;
+        format          = GL_RED;
+    }
+    else if (channels == 4)
+    {
+        internal_format = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        format          = GL_RGBA;
+    }
+    else
+    {
+        internal_format = srgb ? GL_SRGB8 : GL_RGB8;
+        format          = GL_RGB;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TextureStreamer::Ptr TextureStreamer::create(size_t budget, uint32_t mip_tail_size, size_t upload_budget)
+{
+    return std::shared_ptr<TextureStreamer>(new TextureStreamer(budget, mip_tail_size, upload_budget));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TextureStreamer::TextureStreamer(size_t budget, uint32_t mip_tail_size, size_t upload_budget) :
+    m_budget(budget), m_upload_budget(upload_budget), m_mip_tail_size(mip_tail_size)
+{
+    if (!g_srgb_lut_initialized)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            float value         = float(i) / 255.0f;
+            g_srgb_to_linear[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+        }
+
+        g_srgb_lut_initialized = true;
+    }
+
+    m_thread = std::thread(&TextureStreamer::loader_thread, this);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+gl::Texture2D::Ptr TextureStreamer::load(const std::string& path, bool srgb)
+{
+    auto it = m_cache.find(path);
+
+    if (it != m_cache.end() && !it->second.expired())
+        return it->second.lock();
+
+    // Neutral until the mip tail arrives: white for colour data, a flat normal for everything else.
+    uint8_t data[] = { 255, 255, 255, 255 };
+
+    if (!srgb)
+    {
+        data[0] = 128;
+        data[1] = 128;
+    }
+
+    gl::Texture2D::Ptr texture = gl::Texture2D::create(1, 1, 1, 1, 1, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+    texture->write_data(0, 0, data);
+
+    auto record     = std::make_shared<StreamedTexture>();
+    record->texture = texture;
+    record->key     = texture.get();
+    record->path    = path;
+    record->srgb    = srgb;
+
+    m_textures.push_back(record);
+    m_texture_map[texture.get()] = record.get();
+    m_cache[path]                = texture;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back(record);
+    }
+
+    m_cv.notify_one();
+
+    return texture;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::add_feedback(std::shared_ptr<Mesh> mesh, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, uint32_t viewport_height)
+{
+    const auto& submeshes = mesh->sub_meshes();
+    const auto& materials = mesh->materials();
+
+    glm::mat4 model_view = view * model;
+    float     scale      = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+    // Pixels covered by one world unit at a view distance of one.
+    float pixels_per_unit = 0.5f * float(viewport_height) * projection[1][1];
+
+    for (uint32_t i = 0; i < submeshes.size(); i++)
+    {
+        const SubMesh& submesh = submeshes[i];
+
+        if (submesh.mat_idx >= materials.size() || !materials[submesh.mat_idx])
+            continue;
+
+        glm::vec3 center      = 0.5f * (submesh.min_extents + submesh.max_extents);
+        float     radius      = 0.5f * glm::length(submesh.max_extents - submesh.min_extents) * scale;
+        glm::vec3 view_center = glm::vec3(model_view * glm::vec4(center, 1.0f));
+
+        // Entirely behind the camera.
+        if (-view_center.z + radius < 0.0f)
+            continue;
+
+        // Use the nearest point of the bounds so that the estimate is conservative.
+        float distance      = -view_center.z - radius;
+        float pixels_per_uv = distance > 1e-3f ? uv_density(mesh, i) * scale * pixels_per_unit / distance : FLT_MAX;
+
+        const auto&        material   = materials[submesh.mat_idx];
+        gl::Texture2D::Ptr textures[] = { material->albedo_texture(), material->normal_texture(), material->roughness_texture(), material->metallic_texture(), material->emissive_texture() };
+
+        for (auto& texture : textures)
+        {
+            if (!texture)
+                continue;
+
+            auto it = m_texture_map.find(texture.get());
+
+            if (it == m_texture_map.end())
+                continue;
+
+            StreamedTexture* record = it->second;
+
+            uint32_t mip = 0;
+
+            if (record->ready)
+            {
+                float texels_per_pixel = float(std::max(record->width, record->height)) / pixels_per_uv;
+
+                if (texels_per_pixel > 1.0f)
+                    mip = std::min(record->mip_count - 1, uint32_t(floorf(log2f(texels_per_pixel))));
+            }
+
+            record->requested_mip  = std::min(record->requested_mip, mip);
+            record->last_requested = m_frame;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::add_feedback(gl::Texture2D::Ptr texture, uint32_t mip)
+{
+    auto it = m_texture_map.find(texture.get());
+
+    if (it != m_texture_map.end())
+    {
+        it->second->requested_mip  = std::min(it->second->requested_mip, mip);
+        it->second->last_requested = m_frame;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::update()
+{
+    std::deque<std::shared_ptr<StreamedTexture>> decoded;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        decoded.swap(m_decoded);
+    }
+
+    // Mip tails are always made resident, evicting other textures if possible.
+    for (auto& record : decoded)
+    {
+        if (record->texture.expired())
+            continue;
+
+        if (record->failed)
+        {
+            DW_LOG_ERROR("Failed to load texture: {}", record->path);
+            continue;
+        }
+
+        record->ready = true;
+
+        size_t size = mip_chain_size(record.get(), record->tail_mip);
+
+        if (m_resident_size + size > m_budget)
+            evict(m_resident_size + size - m_budget, m_frame);
+
+        make_resident(record.get(), record->tail_mip);
+    }
+
+    // Drop textures that are no longer referenced.
+    for (auto it = m_textures.begin(); it != m_textures.end();)
+    {
+        StreamedTexture* record = it->get();
+
+        if (record->texture.expired())
+        {
+            m_resident_size -= record->resident_size;
+
+            auto map_it = m_texture_map.find(record->key);
+
+            if (map_it != m_texture_map.end() && map_it->second == record)
+                m_texture_map.erase(map_it);
+
+            it = m_textures.erase(it);
+        }
+        else
+            it++;
+    }
+
+    // Stream in one mip per texture per frame, largest deficit first, within the upload budget.
+    std::vector<StreamedTexture*> requests;
+
+    for (auto& record : m_textures)
+    {
+        if (record->ready && record->resident_mip != -1 && record->last_requested == m_frame && record->requested_mip < uint32_t(record->resident_mip))
+            requests.push_back(record.get());
+    }
+
+    std::sort(requests.begin(), requests.end(), [](StreamedTexture* a, StreamedTexture* b) {
+        return (a->resident_mip - int32_t(a->requested_mip)) > (b->resident_mip - int32_t(b->requested_mip));
+    });
+
+    size_t uploaded = 0;
+
+    for (auto record : requests)
+    {
+        if (uploaded >= m_upload_budget)
+            break;
+
+        uint32_t top_mip = record->resident_mip - 1;
+        size_t   size    = mip_chain_size(record, top_mip) - record->resident_size;
+
+        if (m_resident_size + size > m_budget && !evict(m_resident_size + size - m_budget, m_frame))
+            continue;
+
+        make_resident(record, top_mip);
+        uploaded += size;
+    }
+
+    // The budget may have been lowered since the last frame.
+    if (m_resident_size > m_budget)
+        evict(m_resident_size - m_budget, m_frame);
+
+    for (auto& record : m_textures)
+        record->requested_mip = UINT32_MAX;
+
+    m_frame++;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::ui()
+{
+#    if defined(DWSF_IMGUI)
+    uint32_t fully_resident = 0;
+
+    for (auto& record : m_textures)
+    {
+        if (record->resident_mip == 0)
+            fully_resident++;
+    }
+
+    float budget_mb = float(m_budget) / (1024.0f * 1024.0f);
+
+    ImGui::Text("Textures: %d (%d fully resident)", (int)m_textures.size(), fully_resident);
+    ImGui::Text("Resident: %.2f MB / %.2f MB", float(m_resident_size) / (1024.0f * 1024.0f), budget_mb);
+
+    if (ImGui::InputFloat("Budget (MB)", &budget_mb))
+        m_budget = size_t(std::max(0.0f, budget_mb) * 1024.0f * 1024.0f);
+#    endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::loader_thread()
+{
+    while (true)
+    {
+        std::shared_ptr<StreamedTexture> record;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_quit || !m_pending.empty(); });
+
+            if (m_quit)
+                return;
+
+            record = m_pending.front();
+            m_pending.pop_front();
+        }
+
+        // Skip textures that were released before we got to them.
+        if (!record->texture.expired())
+            decode(record.get());
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_decoded.push_back(record);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::decode(StreamedTexture* record)
+{
+    int x, y, n;
+
+    if (!stbi_info(record->path.c_str(), &x, &y, &n))
+    {
+        record->failed = true;
+        return;
+    }
+
+    // Grey-alpha images are expanded so that every image maps onto an R, RGB or RGBA format.
+    uint32_t channels = n == 2 ? 4 : n;
+
+    stbi_set_flip_vertically_on_load_thread(false);
+    stbi_uc* data = stbi_load(record->path.c_str(), &x, &y, &n, channels);
+
+    if (!data)
+    {
+        record->failed = true;
+        return;
+    }
+
+    record->width     = x;
+    record->height    = y;
+    record->channels  = channels;
+    record->mip_count = 1;
+
+    uint32_t width  = x;
+    uint32_t height = y;
+
+    while (width > 1 || height > 1)
+    {
+        width  = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+        record->mip_count++;
+    }
+
+    record->mips.resize(record->mip_count);
+    record->mips[0].assign(data, data + size_t(x) * size_t(y) * channels);
+    record->tail_mip = record->mip_count - 1;
+
+    stbi_image_free(data);
+
+    width  = x;
+    height = y;
+
+    for (uint32_t i = 1; i < record->mip_count; i++)
+    {
+        uint32_t mip_width  = std::max(1u, width / 2);
+        uint32_t mip_height = std::max(1u, height / 2);
+
+        record->mips[i].resize(size_t(mip_width) * size_t(mip_height) * channels);
+
+        downsample(record->mips[i - 1].data(), width, height, record->mips[i].data(), mip_width, mip_height, channels, record->srgb);
+
+        if (std::max(width, height) > m_mip_tail_size && std::max(mip_width, mip_height) <= m_mip_tail_size)
+            record->tail_mip = i;
+
+        width  = mip_width;
+        height = mip_height;
+    }
+
+    if (std::max(record->width, record->height) <= m_mip_tail_size)
+        record->tail_mip = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::make_resident(StreamedTexture* record, uint32_t top_mip)
+{
+    auto texture = record->texture.lock();
+
+    GLenum internal_format, format;
+    texture_formats(record->channels, record->srgb, internal_format, format);
+
+    uint32_t width  = std::max(1u, record->width >> top_mip);
+    uint32_t height = std::max(1u, record->height >> top_mip);
+
+    gl::Texture2D::Ptr storage = gl::Texture2D::create(width, height, 1, record->mip_count - top_mip, 1, internal_format, format, GL_UNSIGNED_BYTE);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (uint32_t i = top_mip; i < record->mip_count; i++)
+    {
+        // Mips that are already resident are copied on the GPU, only the new ones are uploaded.
+        if (record->resident_mip != -1 && i >= uint32_t(record->resident_mip))
+            glCopyImageSubData(texture->id(), GL_TEXTURE_2D, i - record->resident_mip, 0, 0, 0, storage->id(), GL_TEXTURE_2D, i - top_mip, 0, 0, 0, std::max(1u, record->width >> i), std::max(1u, record->height >> i), 1);
+        else
+            storage->write_data(0, i - top_mip, record->mips[i].data());
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    texture->swap_storage(storage);
+
+    m_resident_size -= record->resident_size;
+    record->resident_size = mip_chain_size(record, top_mip);
+    record->resident_mip  = top_mip;
+    m_resident_size += record->resident_size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool TextureStreamer::evict(size_t size, uint64_t frame)
+{
+    std::vector<StreamedTexture*> candidates;
+
+    for (auto& record : m_textures)
+    {
+        if (record->ready && record->resident_mip != -1 && uint32_t(record->resident_mip) < record->tail_mip && record->last_requested < frame)
+            candidates.push_back(record.get());
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](StreamedTexture* a, StreamedTexture* b) {
+        return a->last_requested < b->last_requested;
+    });
+
+    size_t freed = 0;
+
+    for (auto record : candidates)
+    {
+        // Drop just enough top mips from the least recently used texture, never going below the mip tail.
+        uint32_t top_mip = record->resident_mip + 1;
+
+        while (top_mip < record->tail_mip && record->resident_size - mip_chain_size(record, top_mip) < size - freed)
+            top_mip++;
+
+        size_t resident_size = record->resident_size;
+        make_resident(record, top_mip);
+        freed += resident_size - record->resident_size;
+
+        if (freed >= size)
+            return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t TextureStreamer::mip_chain_size(StreamedTexture* record, uint32_t top_mip)
+{
+    GLenum internal_format, format;
+    texture_formats(record->channels, record->srgb, internal_format, format);
+
+    bool   block_compressed;
+    size_t texel_size = gl::texel_size_from_internal_format(internal_format, block_compressed);
+    size_t size       = 0;
+
+    for (uint32_t i = top_mip; i < record->mip_count; i++)
+        size += size_t(std::max(1u, record->width >> i)) * size_t(std::max(1u, record->height >> i)) * texel_size;
+
+    return size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float TextureStreamer::uv_density(std::shared_ptr<Mesh> mesh, uint32_t submesh_idx)
+{
+    uint64_t key = (uint64_t(mesh->id()) << 32) | submesh_idx;
+    auto     it  = m_uv_density_cache.find(key);
+
+    if (it != m_uv_density_cache.end())
+        return it->second;
+
+    const SubMesh& submesh  = mesh->sub_meshes()[submesh_idx];
+    const auto&    vertices = mesh->vertices();
+    const auto&    indices  = mesh->indices();
+
+    double world_area = 0.0;
+    double uv_area    = 0.0;
+
+    for (uint32_t i = submesh.base_index; i + 2 < submesh.base_index + submesh.index_count && i + 2 < indices.size(); i += 3)
+    {
+        const Vertex& v0 = vertices[indices[i]];
+        const Vertex& v1 = vertices[indices[i + 1]];
+        const Vertex& v2 = vertices[indices[i + 2]];
+
+        glm::vec3 e0 = glm::vec3(v1.position - v0.position);
+        glm::vec3 e1 = glm::vec3(v2.position - v0.position);
+        glm::vec2 t0 = glm::vec2(v1.tex_coord - v0.tex_coord);
+        glm::vec2 t1 = glm::vec2(v2.tex_coord - v0.tex_coord);
+
+        world_area += 0.5 * glm::length(glm::cross(e0, e1));
+        uv_area += 0.5 * fabs(t0.x * t1.y - t0.y * t1.x);
+    }
+
+    // World units covered by one unit of UV space. Assume the UVs span the bounds if there is nothing to measure.
+    float density;
+
+    if (uv_area > 1e-12)
+        density = float(sqrt(world_area / uv_area));
+    else
+        density = glm::length(submesh.max_extents - submesh.min_extents);
+
+    m_uv_density_cache[key] = density;
+
+    return density;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace dw
+
+#endif
@@ -1,64 +1,155 @@
 #include <timer.h>
+#include <chrono>
+#include <cmath>
+#include <thread>
 
-Timer::Timer()
-{
-#ifdef WIN32
-    QueryPerformanceFrequency(&_frequency);
-    _start_count.QuadPart = 0;
-    _end_count.QuadPart   = 0;
-#else
-    _start_count.tv_sec = _start_count.tv_usec = 0;
-    _end_count.tv_sec = _end_count.tv_usec = 0;
+#if defined(WIN32)
+#    include <Windows.h>
+#    include <mmsystem.h>
+#    pragma comment(lib, "winmm.lib")
 #endif
 
-    _stopped             = 0;
-    _start_time_microsec = 0;
-    _end_time_microsec   = 0;
+// Stopwatches are only ever added, so readers can walk the list without a lock.
+static std::atomic<Stopwatch*> g_stopwatches = { nullptr };
+
+Timer::Timer()
+{
+    _stopped    = false;
+    _start_time = 0;
+    _end_time   = 0;
 }
 
 Timer::~Timer() {}
 
-void Timer::start()
+uint64_t Timer::now()
 {
-    _stopped = 0;
-#ifdef WIN32
-    QueryPerformanceCounter(&_start_count);
-#else
-    gettimeofday(&_start_count, nullptr);
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Timer::sleep_until(uint64_t time)
+{
+#if defined(WIN32)
+    static bool period_set = timeBeginPeriod(1) == TIMERR_NOERROR;
+    (void)period_set;
 #endif
+
+    // Running mean and variance of how long a 1 ms sleep actually takes on this thread.
+    thread_local double   mean  = 1000000.0;
+    thread_local double   m2    = 0.0;
+    thread_local uint64_t count = 1;
+
+    uint64_t current = now();
+
+    while (current < time)
+    {
+        double estimate = mean + std::sqrt(m2 / double(count));
+
+        if (double(time - current) <= estimate)
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        uint64_t end      = now();
+        double   observed = double(end - current);
+        current           = end;
+
+        // Welford's update, capped so the estimate keeps following the scheduler.
+        if (count < 1000)
+            count++;
+
+        double delta = observed - mean;
+        mean += delta / double(count);
+        m2 += delta * (observed - mean);
+    }
+
+    while (now() < time)
+        std::this_thread::yield();
+}
+
+void Timer::start()
+{
+    _stopped    = false;
+    _start_time = now();
 }
 
 void Timer::stop()
 {
-    _stopped = 1;
-#ifdef WIN32
-    QueryPerformanceCounter(&_end_count);
-#else
-    gettimeofday(&_end_count, nullptr);
-#endif
+    _stopped  = true;
+    _end_time = now();
 }
 
 double Timer::elapsed_time() { return elapsed_time_sec(); }
 
-double Timer::elapsed_time_sec() { return elapsed_time_microsec() * 0.000001; }
+double Timer::elapsed_time_sec() { return elapsed_time_nanosec() * 0.000000001; }
+
+double Timer::elapsed_time_milisec() { return elapsed_time_nanosec() * 0.000001; }
 
-double Timer::elapsed_time_milisec() { return elapsed_time_microsec() * 0.001; }
+double Timer::elapsed_time_microsec() { return elapsed_time_nanosec() * 0.001; }
 
-double Timer::elapsed_time_microsec()
+uint64_t Timer::elapsed_time_nanosec()
 {
-#ifdef WIN32
     if (!_stopped)
-        QueryPerformanceCounter(&_end_count);
+        _end_time = now();
 
-    _start_time_microsec = _start_count.QuadPart * (1000000.0 / _frequency.QuadPart);
-    _end_time_microsec   = _end_count.QuadPart * (1000000.0 / _frequency.QuadPart);
-#else
-    if (!_stopped)
-        gettimeofday(&_end_count, nullptr);
+    return _end_time - _start_time;
+}
 
-    _start_time_microsec = (_start_count.tv_sec * 1000000.0) + _start_count.tv_usec;
-    _end_time_microsec   = (_end_count.tv_sec * 1000000.0) + _end_count.tv_usec;
-#endif
+Stopwatch::Stopwatch(const char* name) :
+    m_name(name)
+{
+    m_next = g_stopwatches.load(std::memory_order_relaxed);
+
+    while (!g_stopwatches.compare_exchange_weak(m_next, this, std::memory_order_release, std::memory_order_relaxed))
+        ;
+}
+
+void Stopwatch::add(uint64_t duration)
+{
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(duration, std::memory_order_relaxed);
 
-    return _end_time_microsec - _start_time_microsec;
+    uint64_t min = m_min.load(std::memory_order_relaxed);
+
+    while (duration < min && !m_min.compare_exchange_weak(min, duration, std::memory_order_relaxed))
+        ;
+
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+
+    while (duration > max && !m_max.compare_exchange_weak(max, duration, std::memory_order_relaxed))
+        ;
+}
+
+void Stopwatch::reset()
+{
+    m_count.store(0, std::memory_order_relaxed);
+    m_total.store(0, std::memory_order_relaxed);
+    m_min.store(UINT64_MAX, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+Stopwatch::Statistics Stopwatch::statistics() const
+{
+    Statistics stats;
+
+    stats.name  = m_name;
+    stats.count = m_count.load(std::memory_order_relaxed);
+    stats.total = m_total.load(std::memory_order_relaxed);
+    stats.min   = stats.count > 0 ? m_min.load(std::memory_order_relaxed) : 0;
+    stats.max   = m_max.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+void Stopwatch::all(std::vector<Statistics>& statistics)
+{
+    statistics.clear();
+
+    for (Stopwatch* stopwatch = g_stopwatches.load(std::memory_order_acquire); stopwatch; stopwatch = stopwatch->m_next)
+        statistics.push_back(stopwatch->statistics());
+}
+
+void Stopwatch::reset_all()
+{
+    for (Stopwatch* stopwatch = g_stopwatches.load(std::memory_order_acquire); stopwatch; stopwatch = stopwatch->m_next)
+        stopwatch->reset();
 }
@@ -4,6 +4,9 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <cstring>
+#include <cmath>
+#include <stb_image.h>
 
 #ifdef WIN32
 #    include <Windows.h>
@@ -20,6 +23,11 @@
 #    include <mach-o/dyld.h>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define DW_SSE2
+#    include <emmintrin.h>
+#endif
+
 namespace dw
 {
 namespace utility
@@ -190,10 +198,21 @@ bool read_shader(const std::string& path, std::string& out, std::vector<std::str
 
     if (defines.size() > 0)
     {
+        std::string define_source;
+
         for (auto define : defines)
-            out += "#define " + define + "\n";
+            define_source += "#define " + define + "\n";
 
-        out += "\n";
+        // The #version directive has to stay the first line of the shader.
+        size_t version_pos = og_source.find("#version");
+        size_t insert_pos  = version_pos != std::string::npos ? og_source.find('\n', version_pos) : std::string::npos;
+
+        if (insert_pos != std::string::npos)
+            og_source.insert(insert_pos + 1, define_source + "\n");
+        else if (version_pos == std::string::npos)
+            og_source = define_source + "\n" + og_source;
+        else
+            og_source += "\n" + define_source;
     }
 
     return preprocess_shader(path, og_source, out);
@@ -240,11 +259,11 @@ bool preprocess_shader(const std::string& path, const std::string& src, std::str
 
             if (!preprocess_shader(path_to_shader + include_path, og_source, include_source))
             {
-                DW_LOG_ERROR("Included file <" + include_path + "> cannot be opened!");
+                DW_LOG_ERROR("Included file <{}> cannot be opened!", include_path);
                 return false;
             }
             if (contains(included_headers, include_path))
-                DW_LOG_WARNING("Header <" + include_path + "> has been included twice!");
+                DW_LOG_WARNING("Header <{}> has been included twice!", include_path);
             else
             {
                 included_headers.push_back(include_path);
@@ -269,6 +288,335 @@ bool preprocess_shader(const std::string& path, const std::string& src, std::str
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+static uint16_t float_to_half_scalar(float value)
+{
+    uint32_t f;
+    memcpy(&f, &value, sizeof(uint32_t));
+
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+
+    uint16_t h;
+
+    // Too large for half, becomes Inf (or stays NaN).
+    if (f >= 0x47800000u)
+        h = f > 0x7f800000u ? 0x7e00 : 0x7c00;
+    // Subnormal or zero. Adding 0.5f lets the FPU do the rounding of the shifted-out mantissa.
+    else if (f < 0x38800000u)
+    {
+        float denormal;
+        memcpy(&denormal, &f, sizeof(float));
+        denormal += 0.5f;
+
+        uint32_t bits;
+        memcpy(&bits, &denormal, sizeof(uint32_t));
+        h = uint16_t(bits - 0x3f000000u);
+    }
+    else
+    {
+        uint32_t mantissa_odd = (f >> 13) & 1;
+
+        // Rebias the exponent and round to nearest even.
+        f += 0xc8000fffu + mantissa_odd;
+        h = uint16_t(f >> 13);
+    }
+
+    return h | uint16_t(sign >> 16);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DW_SSE2)
+
+// Branchless SSE2 version of float_to_half_scalar(). Each 32-bit lane holds a sign extended half so that the results can be
+// narrowed with _mm_packs_epi32.
+static __m128i float_to_half_sse2(__m128 f)
+{
+    const __m128i sign_mask     = _mm_set1_epi32(0x80000000u);
+    const __m128i half_max      = _mm_set1_epi32(0x47800000u);
+    const __m128i min_normal    = _mm_set1_epi32(0x38800000u);
+    const __m128i denorm_magic  = _mm_set1_epi32(0x3f000000u);
+    const __m128i normal_bias   = _mm_set1_epi32(0xc8000fffu);
+    const __m128i nan_bit       = _mm_set1_epi32(0x200);
+    const __m128i infinity_bits = _mm_set1_epi32(0x7c00);
+
+    __m128  sign       = _mm_and_ps(_mm_castsi128_ps(sign_mask), f);
+    __m128  abs_f      = _mm_xor_ps(f, sign);
+    __m128i abs_bits   = _mm_castps_si128(abs_f);
+    __m128i is_nan     = _mm_castps_si128(_mm_cmpunord_ps(abs_f, abs_f));
+    __m128i is_regular = _mm_cmpgt_epi32(half_max, abs_bits);
+    __m128i is_denorm  = _mm_cmpgt_epi32(min_normal, abs_bits);
+    __m128i special    = _mm_or_si128(_mm_and_si128(is_nan, nan_bit), infinity_bits);
+
+    __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(abs_f, _mm_castsi128_ps(denorm_magic))), denorm_magic);
+
+    __m128i mantissa_odd = _mm_srai_epi32(_mm_slli_epi32(abs_bits, 18), 31);
+    __m128i normal       = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(abs_bits, normal_bias), mantissa_odd), 13);
+
+    __m128i result = _mm_or_si128(_mm_and_si128(is_denorm, denormal), _mm_andnot_si128(is_denorm, normal));
+    result         = _mm_or_si128(_mm_and_si128(is_regular, result), _mm_andnot_si128(is_regular, special));
+
+    return _mm_or_si128(result, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void float_to_half(const float* src, uint16_t* dst, size_t count)
+{
+    size_t i = 0;
+
+#if defined(DW_SSE2)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i lo = float_to_half_sse2(_mm_loadu_ps(&src[i]));
+        __m128i hi = float_to_half_sse2(_mm_loadu_ps(&src[i + 4]));
+
+        _mm_storeu_si128((__m128i*)&dst[i], _mm_packs_epi32(lo, hi));
+    }
+#endif
+
+    for (; i < count; i++)
+        dst[i] = float_to_half_scalar(src[i]);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Converts a scanline of RGBE pixels to RGBA16F with alpha set to one.
+static void rgbe_to_half(const uint8_t* src, uint16_t* dst, int count)
+{
+    int i = 0;
+
+#if defined(DW_SSE2)
+    const __m128i zero     = _mm_setzero_si128();
+    const __m128i nine     = _mm_set1_epi32(9);
+    const __m128  rgb_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    const __m128  alpha    = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)&src[i * 4]);
+        __m128i lo    = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi    = _mm_unpackhi_epi8(bytes, zero);
+
+        __m128i pixels[4] = { _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero), _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero) };
+        __m128i halves[4];
+
+        for (int p = 0; p < 4; p++)
+        {
+            __m128i e = _mm_shuffle_epi32(pixels[p], _MM_SHUFFLE(3, 3, 3, 3));
+
+            // 2^(e - 136) built directly in the exponent field. Exponents below 10 would be denormal and are flushed to zero,
+            // which they become after the conversion to half anyway.
+            __m128 scale = _mm_and_ps(_mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(e, nine), 23)), _mm_castsi128_ps(_mm_cmpgt_epi32(e, nine)));
+            __m128 value = _mm_mul_ps(_mm_cvtepi32_ps(pixels[p]), scale);
+
+            halves[p] = float_to_half_sse2(_mm_or_ps(_mm_and_ps(value, rgb_mask), alpha));
+        }
+
+        _mm_storeu_si128((__m128i*)&dst[i * 4], _mm_packs_epi32(halves[0], halves[1]));
+        _mm_storeu_si128((__m128i*)&dst[i * 4 + 8], _mm_packs_epi32(halves[2], halves[3]));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        const uint8_t* rgbe  = &src[i * 4];
+        float          scale = rgbe[3] != 0 ? ldexpf(1.0f, int(rgbe[3]) - 136) : 0.0f;
+
+        dst[i * 4 + 0] = float_to_half_scalar(rgbe[0] * scale);
+        dst[i * 4 + 1] = float_to_half_scalar(rgbe[1] * scale);
+        dst[i * 4 + 2] = float_to_half_scalar(rgbe[2] * scale);
+        dst[i * 4 + 3] = 0x3c00;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool read_rgbe_scanline(const uint8_t*& ptr, const uint8_t* end, uint8_t* scanline, int width)
+{
+    if (end - ptr < 4)
+        return false;
+
+    // Adaptive RLE, each component is run length encoded separately.
+    if (width >= 8 && width < 32768 && ptr[0] == 2 && ptr[1] == 2 && !(ptr[2] & 0x80))
+    {
+        if (((ptr[2] << 8) | ptr[3]) != width)
+            return false;
+
+        ptr += 4;
+
+        for (int c = 0; c < 4; c++)
+        {
+            int x = 0;
+
+            while (x < width)
+            {
+                if (ptr >= end)
+                    return false;
+
+                int count = *ptr++;
+
+                if (count > 128)
+                {
+                    count -= 128;
+
+                    if (count > width - x || ptr >= end)
+                        return false;
+
+                    uint8_t value = *ptr++;
+
+                    for (int i = 0; i < count; i++)
+                        scanline[(x++) * 4 + c] = value;
+                }
+                else
+                {
+                    if (count == 0 || count > width - x || end - ptr < count)
+                        return false;
+
+                    for (int i = 0; i < count; i++)
+                        scanline[(x++) * 4 + c] = *ptr++;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // Flat pixels, possibly with old style run lengths (1, 1, 1, count) repeating the previous pixel.
+    int shift = 0;
+
+    for (int x = 0; x < width; ptr += 4)
+    {
+        if (end - ptr < 4)
+            return false;
+
+        if (ptr[0] == 1 && ptr[1] == 1 && ptr[2] == 1)
+        {
+            int count = ptr[3] << shift;
+
+            if (x == 0 || count > width - x)
+                return false;
+
+            for (int i = 0; i < count; i++, x++)
+                memcpy(&scanline[x * 4], &scanline[(x - 1) * 4], 4);
+
+            shift += 8;
+        }
+        else
+        {
+            memcpy(&scanline[x * 4], ptr, 4);
+            x++;
+            shift = 0;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool load_rgbe_half(const std::string& path, bool flip_vertical, int& width, int& height, std::vector<uint16_t>& out)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+    if (!file.is_open())
+        return false;
+
+    std::vector<uint8_t> buffer(size_t(file.tellg()));
+
+    file.seekg(0);
+    file.read((char*)buffer.data(), buffer.size());
+
+    const uint8_t* ptr = buffer.data();
+    const uint8_t* end = ptr + buffer.size();
+
+    auto read_line = [&ptr, end](std::string& line) {
+        line.clear();
+
+        while (ptr < end && *ptr != '\n')
+            line.push_back(*ptr++);
+
+        if (ptr == end)
+            return false;
+
+        ptr++;
+        return true;
+    };
+
+    std::string line;
+
+    if (!read_line(line) || line.compare(0, 2, "#?") != 0)
+        return false;
+
+    // The header ends with an empty line.
+    while (true)
+    {
+        if (!read_line(line))
+            return false;
+
+        if (line.empty())
+            break;
+
+        if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+            return false;
+    }
+
+    char y_axis[3], x_axis[3];
+
+    if (!read_line(line) || sscanf(line.c_str(), "%2s %d %2s %d", y_axis, &height, x_axis, &width) != 4)
+        return false;
+
+    if ((y_axis[1] != 'Y') || strcmp(x_axis, "+X") != 0 || width <= 0 || height <= 0)
+        return false;
+
+    // Scanlines are stored top to bottom for -Y and bottom to top for +Y.
+    if (y_axis[0] == '+')
+        flip_vertical = !flip_vertical;
+
+    out.resize(size_t(width) * size_t(height) * 4);
+
+    std::vector<uint8_t> scanline(size_t(width) * 4);
+
+    for (int y = 0; y < height; y++)
+    {
+        if (!read_rgbe_scanline(ptr, end, scanline.data(), width))
+            return false;
+
+        int row = flip_vertical ? height - 1 - y : y;
+
+        rgbe_to_half(scanline.data(), &out[size_t(row) * size_t(width) * 4], width);
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool load_hdr_half(const std::string& path, bool flip_vertical, int& width, int& height, std::vector<uint16_t>& out)
+{
+    if (load_rgbe_half(path, flip_vertical, width, height, out))
+        return true;
+
+    // Per thread, images can be decoded in parallel.
+    int n;
+    stbi_set_flip_vertically_on_load_thread(flip_vertical);
+    float* float_data = stbi_loadf(path.c_str(), &width, &height, &n, 4);
+
+    if (!float_data)
+        return false;
+
+    out.resize(size_t(width) * size_t(height) * 4);
+    float_to_half(float_data, out.data(), out.size());
+
+    stbi_image_free(float_data);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 #if !defined(DWSF_VULKAN)
 
 bool create_compute_program(const std::string& path, gl::Shader::Ptr& shader, gl::Program::Ptr& program, std::vector<std::string> defines)
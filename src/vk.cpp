@@ -1,4 +1,5 @@
 #include <vk.h>
+#include <profiler.h>
 #include <logger.h>
 #include <macros.h>
 #include <fstream>
@@ -149,11 +150,11 @@ VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(VkDebugUtilsMessageSeverityFlagBit
         message_type_str = "Performance";
 
     if (messageSeverity == VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT || messageSeverity == VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT)
-        DW_LOG_INFO("Vulkan - " + message_type_str + " : " + std::string(pCallbackData->pMessage));
+        DW_LOG_INFO("Vulkan - {} : {}", message_type_str, pCallbackData->pMessage);
     if (messageSeverity == VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
-        DW_LOG_WARNING("Vulkan -" + message_type_str + " : " + std::string(pCallbackData->pMessage));
+        DW_LOG_WARNING("Vulkan - {} : {}", message_type_str, pCallbackData->pMessage);
     if (messageSeverity == VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
-        DW_LOG_ERROR("Vulkan - " + message_type_str + " : " + std::string(pCallbackData->pMessage));
+        DW_LOG_ERROR("Vulkan - {} : {}", message_type_str, pCallbackData->pMessage);
 
     return VK_FALSE;
 }
@@ -182,20 +183,18 @@ Object::Object(Backend::Ptr backend) :
 Image::Ptr Image::create_from_file(Backend::Ptr backend, std::string path, bool flip_vertical, bool srgb)
 {
     int x, y, n;
-    stbi_set_flip_vertically_on_load(flip_vertical);
+    stbi_set_flip_vertically_on_load_thread(flip_vertical);
 
     std::string ext = utility::file_extension(path);
 
     if (ext == "hdr")
     {
-        float* data = stbi_loadf(path.c_str(), &x, &y, &n, 4);
+        std::vector<uint16_t> data;
 
-        if (!data)
+        if (!utility::load_hdr_half(path, flip_vertical, x, y, data))
             return nullptr;
 
-        Image::Ptr image = std::shared_ptr<Image>(new Image(backend, VK_IMAGE_TYPE_2D, (uint32_t)x, (uint32_t)y, 1, 0, 1, VK_FORMAT_R32G32B32A32_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, x * y * sizeof(float) * 4, data));
-
-        stbi_image_free(data);
+        Image::Ptr image = std::shared_ptr<Image>(new Image(backend, VK_IMAGE_TYPE_2D, (uint32_t)x, (uint32_t)y, 1, 0, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, data.size() * sizeof(uint16_t), data.data()));
 
         return image;
     }
@@ -290,6 +289,10 @@ Image::Image(Backend::Ptr backend, VkImageType type, uint32_t width, uint32_t he
 
     m_vk_device_memory = alloc_info.deviceMemory;
     m_mapped_ptr       = alloc_info.pMappedData;
+    m_memory_size      = alloc_info.size;
+    m_memory_category  = profiler::memory_category((usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) ? profiler::MEMORY_CATEGORY_RENDER_TARGETS : profiler::MEMORY_CATEGORY_TEXTURES);
+
+    profiler::track_allocation(m_memory_category, m_memory_size);
 
     if (data)
     {
@@ -341,7 +344,10 @@ Image::~Image()
     }
 
     if (m_vma_allocator && m_vma_allocation)
+    {
         vmaDestroyImage(m_vma_allocator, m_vk_image, m_vma_allocation);
+        profiler::track_free(m_memory_category, m_memory_size);
+    }
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -784,6 +790,18 @@ Buffer::Buffer(Backend::Ptr backend, VkBufferUsageFlags usage, size_t size, size
     if (create_flags & VMA_ALLOCATION_CREATE_MAPPED_BIT)
         m_mapped_ptr = vma_alloc_info.pMappedData;
 
+    if (memory_usage == VMA_MEMORY_USAGE_CPU_ONLY)
+        m_memory_category = profiler::memory_category(profiler::MEMORY_CATEGORY_STAGING);
+    else if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+        m_memory_category = profiler::memory_category(profiler::MEMORY_CATEGORY_MESHES);
+    else
+        m_memory_category = profiler::memory_category(profiler::MEMORY_CATEGORY_OTHER);
+
+    m_memory_size = vma_alloc_info.size;
+
+    profiler::track_allocation(m_memory_category, m_memory_size);
+    profiler::increment(profiler::COUNTER_BUFFERS_CREATED);
+
     if (data)
         upload_data(data, size, 0);
 
@@ -802,6 +820,7 @@ Buffer::Buffer(Backend::Ptr backend, VkBufferUsageFlags usage, size_t size, size
 Buffer::~Buffer()
 {
     vmaDestroyBuffer(m_vma_allocator, m_vk_buffer, m_vma_allocation);
+    profiler::track_free(m_memory_category, m_memory_size);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -851,6 +870,9 @@ void Buffer::upload_data(void* data, size_t size, size_t offset)
 
         memcpy(m_mapped_ptr, data, size);
 
+        // GPU only buffers are counted through their staging buffer.
+        profiler::increment(profiler::COUNTER_UPLOAD_BYTES, size);
+
         // If host coherency hasn't been requested, do a manual flush to make writes visible
         if ((m_vk_memory_property & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
         {
@@ -2650,6 +2672,12 @@ DescriptorSetLayout::Desc& DescriptorSetLayout::Desc::set_next_ptr(void* pnext)
     return *this;
 }
 
+DescriptorSetLayout::Desc& DescriptorSetLayout::Desc::set_create_flags(VkDescriptorSetLayoutCreateFlags flags)
+{
+    create_flags = flags;
+    return *this;
+}
+
 DescriptorSetLayout::Desc& DescriptorSetLayout::Desc::add_binding(uint32_t binding, VkDescriptorType descriptor_type, uint32_t descriptor_count, VkShaderStageFlags stage_flags)
 {
     bindings.push_back({ binding, descriptor_type, descriptor_count, stage_flags, nullptr });
@@ -2684,6 +2712,7 @@ DescriptorSetLayout::DescriptorSetLayout(Backend::Ptr backend, Desc desc) :
 
     layout_info.pNext        = desc.pnext_ptr;
     layout_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.flags        = desc.create_flags;
     layout_info.bindingCount = desc.bindings.size();
     layout_info.pBindings    = desc.bindings.data();
 
@@ -3158,6 +3187,8 @@ void BatchUploader::upload_buffer_data(Buffer::Ptr buffer, void* data, const siz
 
         auto staging_buffer = insert_data(data, size);
 
+        profiler::increment(profiler::COUNTER_UPLOAD_BYTES, size);
+
         VkBufferCopy copy_region;
         DW_ZERO_MEMORY(copy_region);
 
@@ -3183,6 +3214,8 @@ void BatchUploader::upload_image_data(Image::Ptr image, void* data, const std::v
 
         auto buffer = insert_data(data, size);
 
+        profiler::increment(profiler::COUNTER_UPLOAD_BYTES, size);
+
         std::vector<VkBufferImageCopy> copy_regions;
         size_t                         offset     = 0;
         uint32_t                       region_idx = 0;
@@ -3461,6 +3494,12 @@ Backend::Backend(GLFWwindow* window, bool vsync, bool srgb_swapchain, bool enabl
         throw std::runtime_error("(Vulkan) Failed to find a suitable GPU.");
     }
 
+    // Lets VMA report the budget the driver grants the process instead of estimating it from the heap sizes.
+    bool memory_budget = check_device_extension_support(m_vk_physical_device, { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME });
+
+    if (memory_budget)
+        device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
     if (!create_logical_device(device_extensions, require_ray_tracing))
     {
         DW_LOG_FATAL("(Vulkan) Failed to create logical device.");
@@ -3472,6 +3511,10 @@ Backend::Backend(GLFWwindow* window, bool vsync, bool srgb_swapchain, bool enabl
     allocator_info.physicalDevice         = m_vk_physical_device;
     allocator_info.device                 = m_vk_device;
     allocator_info.instance               = m_vk_instance;
+    allocator_info.vulkanApiVersion       = VK_API_VERSION_1_2;
+
+    if (memory_budget)
+        allocator_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 
     if (vmaCreateAllocator(&allocator_info, &m_vma_allocator) != VK_SUCCESS)
     {
@@ -4183,7 +4226,7 @@ bool Backend::check_validation_layer_support(std::vector<const char*> layers)
 
         if (!layer_found)
         {
-            DW_LOG_FATAL("(Vulkan) Validation Layer not available: " + std::string(layer_name));
+            DW_LOG_FATAL("(Vulkan) Validation Layer not available: {}", layer_name);
             return false;
         }
     }
@@ -4300,10 +4343,10 @@ bool Backend::is_device_suitable(VkPhysicalDevice device, VkPhysicalDeviceType t
 
         if (details.format.size() > 0 && details.present_modes.size() > 0 && extensions_supported)
         {
-            DW_LOG_INFO("(Vulkan) Vendor : " + std::string(get_vendor_name(m_device_properties.vendorID)));
-            DW_LOG_INFO("(Vulkan) Name   : " + std::string(m_device_properties.deviceName));
-            DW_LOG_INFO("(Vulkan) Type   : " + std::string(kDeviceTypes[m_device_properties.deviceType]));
-            DW_LOG_INFO("(Vulkan) Driver : " + std::to_string(m_device_properties.driverVersion));
+            DW_LOG_INFO("(Vulkan) Vendor : {}", get_vendor_name(m_device_properties.vendorID));
+            DW_LOG_INFO("(Vulkan) Name   : {}", m_device_properties.deviceName);
+            DW_LOG_INFO("(Vulkan) Type   : {}", kDeviceTypes[m_device_properties.deviceType]);
+            DW_LOG_INFO("(Vulkan) Driver : {}", m_device_properties.driverVersion);
 
             if (require_ray_tracing)
             {
@@ -4340,7 +4383,7 @@ bool Backend::find_queues(VkPhysicalDevice device, QueueInfos& infos)
     uint32_t family_count = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, nullptr);
 
-    DW_LOG_INFO("(Vulkan) Number of Queue families: " + std::to_string(family_count));
+    DW_LOG_INFO("(Vulkan) Number of Queue families: {}", family_count);
 
     VkQueueFamilyProperties families[32];
     vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, &families[0]);
@@ -4349,12 +4392,12 @@ bool Backend::find_queues(VkPhysicalDevice device, QueueInfos& infos)
     {
         VkQueueFlags bits = families[i].queueFlags;
 
-        DW_LOG_INFO("(Vulkan) Family " + std::to_string(i));
+        DW_LOG_INFO("(Vulkan) Family {}", i);
         DW_LOG_INFO("(Vulkan) Supported Bits: ");
-        DW_LOG_INFO("(Vulkan) VK_QUEUE_GRAPHICS_BIT: " + std::to_string((families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) > 0));
-        DW_LOG_INFO("(Vulkan) VK_QUEUE_COMPUTE_BIT: " + std::to_string((families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) > 0));
-        DW_LOG_INFO("(Vulkan) VK_QUEUE_TRANSFER_BIT: " + std::to_string((families[i].queueFlags & VK_QUEUE_TRANSFER_BIT) > 0));
-        DW_LOG_INFO("(Vulkan) Number of Queues: " + std::to_string(families[i].queueCount));
+        DW_LOG_INFO("(Vulkan) VK_QUEUE_GRAPHICS_BIT: {}", (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) > 0);
+        DW_LOG_INFO("(Vulkan) VK_QUEUE_COMPUTE_BIT: {}", (families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) > 0);
+        DW_LOG_INFO("(Vulkan) VK_QUEUE_TRANSFER_BIT: {}", (families[i].queueFlags & VK_QUEUE_TRANSFER_BIT) > 0);
+        DW_LOG_INFO("(Vulkan) Number of Queues: {}", families[i].queueCount);
 
         VkBool32 present_support = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_vk_surface, &present_support);
@@ -4587,6 +4630,20 @@ bool Backend::create_logical_device(std::vector<const char*> extensions, bool re
 
     physical_device_features_2.features.robustBufferAccess = VK_FALSE;
 
+    m_device_features = physical_device_features_2.features;
+
+    // Every supported Vulkan 1.2 feature is enabled.
+    m_device_features12       = features12;
+    m_device_features12.pNext = nullptr;
+
+    DW_ZERO_MEMORY(m_descriptor_indexing_properties);
+    m_descriptor_indexing_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 device_properties2 {};
+    device_properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    device_properties2.pNext = &m_descriptor_indexing_properties;
+    vkGetPhysicalDeviceProperties2(m_vk_physical_device, &device_properties2);
+
     VkDeviceCreateInfo device_info;
     DW_ZERO_MEMORY(device_info);
 
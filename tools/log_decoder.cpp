@@ -0,0 +1,33 @@
+#include <logger.h>
+#include <fstream>
+#include <iostream>
+
+// Converts a binary log written through logger::open_binary_stream() back to text.
+//
+// Usage: dwlog_decode <path> [output]
+//
+// path is the one passed to open_binary_stream(), without the .N suffix of the individual files. The text is written to
+// stdout unless an output file is given.
+int main(int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: dwlog_decode <path> [output]\n";
+        return 1;
+    }
+
+    if (argc > 2)
+    {
+        std::ofstream output(argv[2]);
+
+        if (!output)
+        {
+            std::cerr << "Failed to open " << argv[2] << " for writing.\n";
+            return 1;
+        }
+
+        return dw::logger::decode_binary_log(argv[1], output) ? 0 : 1;
+    }
+
+    return dw::logger::decode_binary_log(argv[1], std::cout) ? 0 : 1;
+}